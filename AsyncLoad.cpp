@@ -0,0 +1,95 @@
+#include "AsyncLoad.h"
+
+#include <algorithm>
+#include <cstring>
+
+AsyncLoad::AsyncLoad()
+        : data(nullptr), size(0), indexedBytes(0), cancelled(false), truncated(false), active(false) {}
+
+AsyncLoad::~AsyncLoad() {
+    cancel();
+}
+
+size_t AsyncLoad::index(const char *data, size_t size, size_t from, size_t limit, Rope<Line> &lines) {
+    const char *cursor = data + from;
+    const char *end = data + size;
+    const char *stop = data + std::min(size, from + limit);
+    while (cursor < end && cursor < stop) {
+        const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+        const char *lineEnd = newline ? newline : end;
+        lines.push_back(Line::borrow(cursor, lineEnd - cursor));
+        cursor = newline ? newline + 1 : end;
+    }
+    return cursor - data;
+}
+
+void AsyncLoad::start(const std::shared_ptr<MappedFile> &mapped, size_t from) {
+    cancel();
+    file = mapped;
+    data = mapped->getData();
+    size = mapped->getSize();
+    indexedBytes = from;
+    cancelled = false;
+    truncated = false;
+    active = true;
+    worker = std::thread(&AsyncLoad::run, this, from);
+}
+
+void AsyncLoad::run(size_t from) {
+    while (from < size && !cancelled) {
+        if (file->isTruncated()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            truncated = true;
+            size = from;
+            break;
+        }
+        Rope<Line> chunk;
+        from = index(data, size, from, ASYNC_LOAD_CHUNK_BYTES, chunk);
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks.push_back(std::move(chunk));
+        indexedBytes = from;
+    }
+}
+
+bool AsyncLoad::drain(Rope<Line> &lines) {
+    if (!active) {
+        return false;
+    }
+    std::deque<Rope<Line>> ready;
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(chunks);
+        done = indexedBytes == size;
+    }
+    for (Rope<Line> &chunk : ready) {
+        lines.append(std::move(chunk));
+    }
+    if (done) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+        file.reset();
+        active = false;
+    }
+    return done;
+}
+
+void AsyncLoad::finish(Rope<Line> &lines) {
+    if (!active) {
+        return;
+    }
+    worker.join();
+    drain(lines);
+}
+
+void AsyncLoad::cancel() {
+    if (!active) {
+        return;
+    }
+    cancelled = true;
+    worker.join();
+    chunks.clear();
+    file.reset();
+    active = false;
+}
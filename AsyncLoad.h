@@ -0,0 +1,83 @@
+#ifndef TEXT_EDITOR_ASYNCLOAD_H
+#define TEXT_EDITOR_ASYNCLOAD_H
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Line.h"
+#include "MappedFile.h"
+#include "Rope.h"
+
+// Indexed before loadFromFileAsync returns, so the start of the file is
+// there at once.
+#define ASYNC_LOAD_FIRST_BYTES (256 << 10)
+#define ASYNC_LOAD_CHUNK_BYTES (16 << 20)
+
+// Indexes the lines of a mapped file on a background thread. Lines are
+// handed over in chunks of about ASYNC_LOAD_CHUNK_BYTES that the owner
+// appends to its document when it polls, so the document itself is only
+// ever touched by the owner's thread.
+class AsyncLoad {
+private:
+    std::shared_ptr<MappedFile> file;
+    const char *data;
+    std::atomic<size_t> size;
+    std::thread worker;
+    std::mutex mutex;
+    std::deque<Rope<Line>> chunks;
+    std::atomic<size_t> indexedBytes;
+    std::atomic<bool> cancelled;
+    std::atomic<bool> truncated;
+    bool active;
+
+    void run(size_t from);
+
+public:
+    AsyncLoad();
+    ~AsyncLoad();
+
+    AsyncLoad(const AsyncLoad &) = delete;
+    AsyncLoad &operator=(const AsyncLoad &) = delete;
+
+    // Appends the lines of [data + from, data + size) that start before
+    // data + from + limit to `lines`, borrowing their bytes. Returns the
+    // offset after the last line indexed.
+    static size_t index(const char *data, size_t size, size_t from, size_t limit, Rope<Line> &lines);
+
+    // Indexes the file from byte `from` on in the background. If another
+    // program truncates the file, indexing stops before the next chunk and
+    // the load ends with the lines indexed so far.
+    void start(const std::shared_ptr<MappedFile> &mapped, size_t from);
+
+    // Moves the chunks indexed so far to the end of `lines` in O(log n)
+    // each. Returns true once the last chunk has been handed over.
+    bool drain(Rope<Line> &lines);
+
+    // Waits for the whole file to be indexed and hands it over.
+    void finish(Rope<Line> &lines);
+
+    // Stops indexing and drops what has not been handed over.
+    void cancel();
+
+    bool isActive() const {
+        return active;
+    }
+
+    size_t getIndexedBytes() const {
+        return indexedBytes;
+    }
+
+    size_t getTotalBytes() const {
+        return size;
+    }
+
+    // True if the file was truncated before all of it was indexed.
+    bool wasTruncated() const {
+        return truncated;
+    }
+};
+
+#endif //TEXT_EDITOR_ASYNCLOAD_H
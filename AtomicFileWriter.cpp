@@ -0,0 +1,102 @@
+#include "AtomicFileWriter.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+AtomicFileWriter::AtomicFileWriter() : fd(-1), bytesCopied(0) {}
+
+AtomicFileWriter::~AtomicFileWriter() {
+    discard();
+}
+
+void AtomicFileWriter::discard() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+        unlink(tempPath.c_str());
+    }
+}
+
+bool AtomicFileWriter::open(const char *path) {
+    discard();
+    targetPath = path;
+    struct stat info;
+    bool exists = lstat(path, &info) == 0;
+    if (exists && S_ISLNK(info.st_mode)) {
+        char *resolved = realpath(path, nullptr);
+        if (resolved) {
+            targetPath = resolved;
+            std::free(resolved);
+        }
+        exists = stat(targetPath.c_str(), &info) == 0;
+    }
+
+    tempPath = targetPath + ".tmpXXXXXX";
+    fd = mkstemp(&tempPath[0]);
+    if (fd < 0) {
+        return false;
+    }
+    mode_t mode;
+    if (exists) {
+        mode = info.st_mode & 07777;
+    } else {
+        mode_t mask = umask(0);
+        umask(mask);
+        mode = 0666 & ~mask;
+    }
+    fchmod(fd, mode);
+    out.reset(fd);
+    bytesCopied = 0;
+    return true;
+}
+
+bool AtomicFileWriter::copyRange(int sourceFd, off_t offset, size_t len, const char *fallback) {
+    if (fd < 0 || !out.flush()) {
+        return false;
+    }
+    size_t copied = 0;
+    while (copied < len) {
+        loff_t from = offset + copied;
+        ssize_t n = copy_file_range(sourceFd, &from, fd, nullptr, len - copied, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        copied += n;
+    }
+    bytesCopied += copied;
+    if (copied < len) {
+        return append(fallback + copied, len - copied) && out.flush();
+    }
+    return true;
+}
+
+bool AtomicFileWriter::commit() {
+    if (fd < 0) {
+        return false;
+    }
+    if (!out.flush() || fsync(fd) != 0) {
+        discard();
+        return false;
+    }
+    close(fd);
+    fd = -1;
+    if (rename(tempPath.c_str(), targetPath.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        return false;
+    }
+    std::string directory = targetPath.substr(0, targetPath.find_last_of('/') + 1);
+    int dirFd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        close(dirFd);
+    }
+    return true;
+}
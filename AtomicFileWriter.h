@@ -0,0 +1,57 @@
+#ifndef TEXT_EDITOR_ATOMICFILEWRITER_H
+#define TEXT_EDITOR_ATOMICFILEWRITER_H
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+#include "GatherWriter.h"
+
+// Writes a file under a temporary name next to the target and renames it
+// over the target on commit(), so readers and crashes only ever see the old
+// or the new content. Appended buffers are gathered and written with
+// writev; they must stay valid until the next flush or commit(). Ranges of
+// another file can be copied in-kernel with copy_file_range.
+class AtomicFileWriter {
+private:
+    int fd;
+    std::string targetPath;
+    std::string tempPath;
+    GatherWriter out;
+    size_t bytesCopied;
+
+    void discard();
+
+public:
+    AtomicFileWriter();
+    ~AtomicFileWriter();
+
+    AtomicFileWriter(const AtomicFileWriter &) = delete;
+    AtomicFileWriter &operator=(const AtomicFileWriter &) = delete;
+
+    // Creates the temporary file; symlinks are followed so the link itself
+    // survives the rename.
+    bool open(const char *path);
+
+    bool append(const char *data, size_t len) {
+        return fd >= 0 && out.append(data, len);
+    }
+
+    // Copies `len` bytes at `offset` of `sourceFd`. `fallback` must hold
+    // the same bytes and is written instead when the kernel cannot copy
+    // between the two files.
+    bool copyRange(int sourceFd, off_t offset, size_t len, const char *fallback);
+
+    // Flushes, fsyncs and renames over the target. On failure the target is
+    // left untouched and the temporary file removed.
+    bool commit();
+
+    size_t getBytesWritten() const {
+        return out.getBytesWritten();
+    }
+
+    size_t getBytesCopied() const {
+        return bytesCopied;
+    }
+};
+
+#endif //TEXT_EDITOR_ATOMICFILEWRITER_H
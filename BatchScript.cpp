@@ -0,0 +1,246 @@
+#include "BatchScript.h"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <unistd.h>
+#include "CaesarLib.h"
+#include "MappedFile.h"
+
+size_t runBatch(TextStorage &storage, const char* scriptPath) {
+    std::ios::sync_with_stdio(false);
+    std::string script;
+    MappedFile mapped;
+    const char* data;
+    size_t size;
+    if (std::strcmp(scriptPath, "-") == 0) {
+        script.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+        data = script.data();
+        size = script.size();
+    } else if (mapped.open(scriptPath)) {
+        data = mapped.getData();
+        size = mapped.getSize();
+    } else {
+        std::cerr << "Error opening script: " << scriptPath << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<CaesarLib> caesarLib;
+    std::vector<TextEdit> pendingEdits;
+    std::string text;
+    size_t failures = 0;
+    size_t lineNumber = 0;
+    for (const char* cursor = data, *scriptEnd = data + size; cursor < scriptEnd;) {
+        storage.pollLoad();
+        const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', scriptEnd - cursor));
+        const char* lineEnd = newline ? newline : scriptEnd;
+        const char* next = lineEnd + 1;
+        if (lineEnd > cursor && lineEnd[-1] == '\r') {
+            --lineEnd;
+        }
+        ScriptLine line(cursor, lineEnd);
+        const char* lineStart = cursor;
+        cursor = next;
+        ++lineNumber;
+
+        std::string_view command = line.word();
+        size_t lineIndex, position, length;
+        long long shift;
+        bool parsed = true;
+        if (command.empty() || command[0] == '#') {
+            continue;
+        } else if (command == "append") {
+            storage.appendText(storage.getLineCount() - 1, line.text(text));
+        } else if (command == "newline") {
+            storage.addNewLine();
+        } else if (command == "insert" && line.index(lineIndex) && line.index(position)) {
+            storage.insertText(lineIndex, position, line.text(text));
+        } else if (command == "replace" && line.index(lineIndex) && line.index(position)) {
+            storage.insertWithReplace(lineIndex, position, line.text(text));
+        } else if (command == "delete" && line.index(lineIndex) && line.index(position) && line.index(length)) {
+            storage.deleteText(lineIndex, position, length);
+        } else if (command == "cut" && line.index(lineIndex) && line.index(position) && line.index(length)) {
+            storage.cutText(lineIndex, position, length);
+        } else if (command == "copy" && line.index(lineIndex) && line.index(position) && line.index(length)) {
+            storage.copyText(lineIndex, position, length);
+        } else if (command == "paste" && line.index(lineIndex) && line.index(position)) {
+            storage.pasteText(lineIndex, position);
+        } else if (command == "insert-at" && line.index(position)) {
+            storage.insertTextAt(position, line.text(text));
+        } else if (command == "delete-at" && line.index(position) && line.index(length)) {
+            storage.deleteTextAt(position, length);
+        } else if (command == "cut-at" && line.index(position) && line.index(length)) {
+            storage.cutTextAt(position, length);
+        } else if (command == "copy-at" && line.index(position) && line.index(length)) {
+            storage.copyTextAt(position, length);
+        } else if (command == "paste-at" && line.index(position)) {
+            storage.pasteTextAt(position);
+        } else if (command == "position" && line.index(position)) {
+            if (storage.offsetToPosition(position, lineIndex, length)) {
+                std::cout << "Position: " << lineIndex << " " << length << "\n";
+            } else {
+                std::cerr << "Offset out of bounds or inside a character\n";
+            }
+        } else if (command == "offset" && line.index(lineIndex) && line.index(position)) {
+            if (storage.positionToOffset(lineIndex, position, length)) {
+                std::cout << "Offset: " << length << "\n";
+            } else {
+                std::cerr << "Position out of bounds\n";
+            }
+        } else if (command == "undo") {
+            storage.undo();
+        } else if (command == "redo") {
+            storage.redo();
+        } else if (command == "search") {
+            storage.searchText(line.text(text));
+        } else if (command == "search-options") {
+            std::string_view flags = line.word();
+            SearchOptions options;
+            options.ignoreCase = flags.find('i') != std::string_view::npos;
+            options.wholeWord = flags.find('w') != std::string_view::npos;
+            options.threads = storage.getWorkerThreads();
+            storage.searchText(line.text(text), options);
+        } else if (command == "search-patterns") {
+            std::string_view flags = line.word();
+            SearchOptions options;
+            options.ignoreCase = flags.find('i') != std::string_view::npos;
+            options.wholeWord = flags.find('w') != std::string_view::npos;
+            options.threads = storage.getWorkerThreads();
+            storage.searchPatterns(splitPatterns(line.text(text)), options);
+        } else if (command == "replace-all") {
+            std::string_view flags = line.word();
+            SearchOptions options;
+            options.ignoreCase = flags.find('i') != std::string_view::npos;
+            options.wholeWord = flags.find('w') != std::string_view::npos;
+            options.threads = storage.getWorkerThreads();
+            std::string rest = line.text(text);
+            size_t separator = rest.find('|');
+            if (separator == std::string::npos) {
+                parsed = false;
+            } else {
+                rest[separator] = '\0';
+                size_t replaced = storage.replaceAll(rest.c_str(), rest.c_str() + separator + 1, options);
+                std::cout << "Replaced " << replaced << " matches\n";
+            }
+        } else if (command == "edit" && line.index(lineIndex) && line.index(position) && line.index(length)) {
+            pendingEdits.push_back({lineIndex, position, length, line.text(text)});
+        } else if (command == "apply-edits") {
+            storage.applyEdits(std::move(pendingEdits));
+            pendingEdits.clear();
+        } else if (command == "history-budget" && line.index(length)) {
+            storage.setHistoryBudget(length);
+        } else if (command == "history-stats") {
+            storage.printHistoryStats();
+        } else if (command == "journal") {
+            std::string_view mode = line.word();
+            if (mode == "on" || mode == "off") {
+                storage.setJournaling(mode == "on");
+            } else {
+                parsed = false;
+            }
+        } else if (command == "journal-group" && line.index(length) && line.index(position)) {
+            storage.setJournalGroup(length, position);
+        } else if (command == "journal-stats") {
+            storage.printJournalStats();
+        } else if (command == "interning") {
+            std::string_view mode = line.word();
+            if (mode == "on" || mode == "off") {
+                storage.setInterning(mode == "on");
+            } else {
+                parsed = false;
+            }
+        } else if (command == "interning-stats") {
+            storage.printInternStats();
+        } else if (command == "new-document" || command == "copy-document") {
+            storage.newDocument(command == "copy-document");
+        } else if (command == "switch-document" && line.index(lineIndex)) {
+            storage.switchDocument(lineIndex);
+        } else if (command == "close-document") {
+            storage.closeDocument();
+        } else if (command == "documents") {
+            storage.listDocuments();
+        } else if (command == "recover-key" || command == "recover-key-file") {
+            std::string_view mode = line.word();
+            KeyRecoveryResult result;
+            if (mode != "sample" && mode != "full") {
+                parsed = false;
+            } else if (command == "recover-key") {
+                TextStorage::printKeyRecovery(storage.recoverKey(mode == "sample"));
+            } else if (storage.recoverFileKey(line.text(text), mode == "sample", result)) {
+                TextStorage::printKeyRecovery(result);
+            }
+        } else if (command == "letter-model") {
+            const char* sample = line.text(text);
+            if (std::strcmp(sample, "english") == 0) {
+                storage.resetLetterModel();
+            } else {
+                storage.trainLetterModel(sample);
+            }
+        } else if (command == "print") {
+            storage.printText();
+        } else if (command == "print-fast") {
+            storage.writeText(STDOUT_FILENO);
+        } else if (command == "print-range" && line.index(lineIndex) && line.index(length)) {
+            storage.printRange(lineIndex, length);
+        } else if (command == "next-page") {
+            storage.printNextPage();
+        } else if (command == "previous-page") {
+            storage.printPreviousPage();
+        } else if (command == "memory-stats") {
+            storage.printMemoryStats();
+        } else if (command == "stats") {
+            std::string_view format = line.word();
+            if (format.empty() || format == "text" || format == "json") {
+                storage.printOperationStats(format == "json");
+            } else {
+                parsed = false;
+            }
+        } else if (command == "load") {
+            storage.loadFromFile(line.text(text));
+        } else if (command == "load-async") {
+            storage.loadFromFileAsync(line.text(text));
+        } else if (command == "load-progress") {
+            storage.printLoadProgress();
+        } else if (command == "load-wait") {
+            storage.waitForLoad();
+        } else if (command == "save") {
+            storage.saveToFile(line.text(text));
+        } else if (command == "diff") {
+            storage.diffWithFile(line.text(text));
+        } else if (command == "diff-undo" && line.index(length)) {
+            storage.diffHistory(length);
+        } else if (command == "reload") {
+            storage.reloadFromFile(line.text(text));
+        } else if ((command == "encrypt" || command == "decrypt" || command == "encrypt-file" ||
+                    command == "decrypt-file") && line.number(shift)) {
+            if (!caesarLib) {
+                caesarLib.reset(new CaesarLib(CAESAR_LIB_PATH));
+            }
+            if (command == "encrypt") {
+                storage.encryptText(shift, *caesarLib);
+            } else if (command == "decrypt") {
+                storage.decryptText(shift, *caesarLib);
+            } else {
+                std::string input(line.word());
+                std::string output(line.word());
+                if (input.empty() || output.empty()) {
+                    parsed = false;
+                } else if (command == "encrypt-file") {
+                    storage.encryptFile(input.c_str(), output.c_str(), shift, *caesarLib);
+                } else {
+                    storage.decryptFile(input.c_str(), output.c_str(), shift, *caesarLib);
+                }
+            }
+        } else {
+            parsed = false;
+        }
+        if (!parsed) {
+            std::cerr << "Invalid command at line " << lineNumber << ": "
+                      << std::string_view(lineStart, lineEnd - lineStart) << std::endl;
+            ++failures;
+        }
+    }
+    std::cout.flush();
+    return failures;
+}
@@ -0,0 +1,90 @@
+#ifndef TEXT_EDITOR_BATCHSCRIPT_H
+#define TEXT_EDITOR_BATCHSCRIPT_H
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "TextStorage.h"
+
+// Cursor over one line of a batch script: a command word, whitespace
+// separated numbers, then the rest of the line as the text argument.
+class ScriptLine {
+private:
+    const char* cursor;
+    const char* end;
+
+    void skipSpaces() {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+            ++cursor;
+        }
+    }
+
+public:
+    ScriptLine(const char* begin, const char* finish) : cursor(begin), end(finish) {}
+
+    std::string_view word() {
+        skipSpaces();
+        const char* start = cursor;
+        while (cursor < end && *cursor != ' ' && *cursor != '\t') {
+            ++cursor;
+        }
+        return std::string_view(start, cursor - start);
+    }
+
+    bool number(long long &value) {
+        skipSpaces();
+        std::from_chars_result result = std::from_chars(cursor, end, value);
+        if (result.ec != std::errc() || (result.ptr < end && *result.ptr != ' ' && *result.ptr != '\t')) {
+            return false;
+        }
+        cursor = result.ptr;
+        return true;
+    }
+
+    bool index(size_t &value) {
+        long long parsed;
+        if (!number(parsed) || parsed < 0) {
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+
+    // Everything after the single separator that follows the last argument.
+    const char* text(std::string &scratch) {
+        if (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+            ++cursor;
+        }
+        scratch.assign(cursor, end - cursor);
+        cursor = end;
+        return scratch.c_str();
+    }
+};
+
+// Runs a command script without prompts or help output; "-" reads stdin.
+// One command per line, positions are 0-based like in the menu:
+//   append TEXT | newline | insert L C TEXT | replace L C TEXT
+//   delete L C N | cut L C N | copy L C N | paste L C | undo | redo
+//   insert-at OFF TEXT | delete-at OFF N | cut-at OFF N | copy-at OFF N
+//   paste-at OFF | position OFF | offset L C
+//   search TEXT | search-options FLAGS TEXT | search-patterns FLAGS P1|P2|...
+//   replace-all FLAGS PATTERN|REPLACEMENT
+//   edit L C N TEXT (queued) | apply-edits (applies the queue as one change)
+//   history-budget BYTES | history-stats
+//   journal on|off | journal-group EDITS MS | journal-stats
+//   interning on|off | interning-stats
+//   new-document | copy-document | switch-document N | close-document
+//   documents
+//   recover-key sample|full | recover-key-file sample|full FILE
+//   letter-model FILE|english
+//   print | print-fast | print-range L N | next-page | previous-page
+//   memory-stats | stats [text|json]
+//   load FILE | save FILE | load-async FILE | load-progress | load-wait
+//   diff FILE | diff-undo N | reload [FILE]
+//   encrypt K | decrypt K | encrypt-file K IN OUT | decrypt-file K IN OUT
+// Blank lines and lines starting with '#' are skipped. Returns the number
+// of lines that could not be parsed.
+size_t runBatch(TextStorage &storage, const char* scriptPath);
+
+#endif //TEXT_EDITOR_BATCHSCRIPT_H
@@ -1,37 +1,116 @@
 #include <iostream>
+#include "CaesarCipher.h"
 #include <cstring>
 #include <cctype>
+#include <cstdint>
+#include <cstddef>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CAESAR_X86 1
+#endif
 
-extern "C" {
-char* encrypt(char *rawText, int key) {
-    int length = strlen(rawText);
-    char *encryptedText = new char[length + 1];
+namespace {
+
+typedef void (*Kernel)(const unsigned char *, unsigned char *, size_t, unsigned);
 
-    for (int i = 0; i < length; i++) {
-        if (isalpha(rawText[i])) {
-            char base = islower(rawText[i]) ? 'a' : 'A';
-            encryptedText[i] = (rawText[i] - base + key) % 26 + base;
+// Shifts ASCII letters by `key` (0..25) and copies every other byte as is.
+// Bytes outside A-Z/a-z, including UTF-8 sequences, are never touched.
+void scalarKernel(const unsigned char *in, unsigned char *out, size_t len, unsigned key) {
+    for (size_t i = 0; i < len; i++) {
+        unsigned c = in[i];
+        unsigned offset = (c | 0x20) - 'a';
+        if (offset < 26) {
+            out[i] = c + (offset + key >= 26 ? key - 26 : key);
         } else {
-            encryptedText[i] = rawText[i];
+            out[i] = c;
         }
     }
+}
+
+#ifdef CAESAR_X86
+// Same arithmetic as scalarKernel on 16 lanes: OR-ing 0x20 folds case,
+// an unsigned min detects letters and a max selects the lanes that wrap.
+void sse2Kernel(const unsigned char *in, unsigned char *out, size_t len, unsigned key) {
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i lowerA = _mm_set1_epi8('a');
+    const __m128i last = _mm_set1_epi8(25);
+    const __m128i wrapFrom = _mm_set1_epi8(26 - key);
+    const __m128i shift = _mm_set1_epi8(key);
+    const __m128i wrap = _mm_set1_epi8(26);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128i offset = _mm_sub_epi8(_mm_or_si128(v, caseBit), lowerA);
+        __m128i letter = _mm_cmpeq_epi8(_mm_min_epu8(offset, last), offset);
+        __m128i wraps = _mm_cmpeq_epi8(_mm_max_epu8(offset, wrapFrom), offset);
+        __m128i delta = _mm_sub_epi8(shift, _mm_and_si128(wraps, wrap));
+        v = _mm_add_epi8(v, _mm_and_si128(letter, delta));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), v);
+    }
+    scalarKernel(in + i, out + i, len - i, key);
+}
+
+__attribute__((target("avx2")))
+void avx2Kernel(const unsigned char *in, unsigned char *out, size_t len, unsigned key) {
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    const __m256i lowerA = _mm256_set1_epi8('a');
+    const __m256i last = _mm256_set1_epi8(25);
+    const __m256i wrapFrom = _mm256_set1_epi8(26 - key);
+    const __m256i shift = _mm256_set1_epi8(key);
+    const __m256i wrap = _mm256_set1_epi8(26);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        __m256i offset = _mm256_sub_epi8(_mm256_or_si256(v, caseBit), lowerA);
+        __m256i letter = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, last), offset);
+        __m256i wraps = _mm256_cmpeq_epi8(_mm256_max_epu8(offset, wrapFrom), offset);
+        __m256i delta = _mm256_sub_epi8(shift, _mm256_and_si256(wraps, wrap));
+        v = _mm256_add_epi8(v, _mm256_and_si256(letter, delta));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), v);
+    }
+    sse2Kernel(in + i, out + i, len - i, key);
+}
+#endif
+
+Kernel selectKernel() {
+#ifdef CAESAR_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2Kernel;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return sse2Kernel;
+    }
+#endif
+    return scalarKernel;
+}
+
+unsigned normalizeKey(int key) {
+    int shift = key % 26;
+    return shift < 0 ? shift + 26 : shift;
+}
+
+}
+
+extern "C" {
+void caesar_transform(const char *in, char *out, size_t len, int key) {
+    static const Kernel kernel = selectKernel();
+    kernel(reinterpret_cast<const unsigned char *>(in), reinterpret_cast<unsigned char *>(out), len,
+           normalizeKey(key));
+}
+
+char* encrypt(char *rawText, int key) {
+    size_t length = strlen(rawText);
+    char *encryptedText = new char[length + 1];
+    caesar_transform(rawText, encryptedText, length, key);
     encryptedText[length] = '\0';
     return encryptedText;
 }
 
 char* decrypt(char *encryptedText, int key) {
-    int length = strlen(encryptedText);
+    size_t length = strlen(encryptedText);
     char *decryptedText = new char[length + 1];
-
-    for (int i = 0; i < length; i++) {
-        if (isalpha(encryptedText[i])) {
-            char base = islower(encryptedText[i]) ? 'a' : 'A';
-            decryptedText[i] =
-                    (encryptedText[i] - base - key + 26) % 26 + base;
-        } else {
-            decryptedText[i] = encryptedText[i];
-        }
-    }
+    caesar_transform(encryptedText, decryptedText, length, -(key % 26));
     decryptedText[length] = '\0';
     return decryptedText;
 }
@@ -5,10 +5,20 @@
 #ifndef TEXT_EDITOR_CAESARCIPHER_H
 #define TEXT_EDITOR_CAESARCIPHER_H
 
+#include <cstddef>
 
 class CaesarCipher {
 
 };
 
+extern "C" {
+// v2 ABI: shifts the ASCII letters of `len` bytes of `in` by `key` (any
+// int, reduced modulo 26) into `out`. `in` and `out` may be the same buffer.
+void caesar_transform(const char *in, char *out, size_t len, int key);
+
+// v1 ABI: returns a new[]-allocated NUL-terminated copy of `text`.
+char* encrypt(char *rawText, int key);
+char* decrypt(char *encryptedText, int key);
+}
 
 #endif //TEXT_EDITOR_CAESARCIPHER_H
@@ -0,0 +1,88 @@
+#include "CaesarLib.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <dlfcn.h>
+
+CaesarLib::CaesarLib(const char* libPath) {
+    try {
+        handle = dlopen(libPath, RTLD_LAZY);
+        if (!handle) {
+            throw std::runtime_error(dlerror());
+        }
+
+        // Prefer the v2 buffer ABI; older libraries only export v1.
+        transform = (TransformFunc)dlsym(handle, "caesar_transform");
+        dlerror();
+        encrypt = (EncryptFunc)dlsym(handle, "encrypt");
+        decrypt = (DecryptFunc)dlsym(handle, "decrypt");
+
+        char* error;
+        if ((error = dlerror()) != NULL && !transform) {
+            throw std::runtime_error(error);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading library or symbols: " << e.what() << std::endl;
+        std::cerr << "Path attempted: " << libPath << std::endl;
+        exit(1);
+    }
+}
+
+CaesarLib::~CaesarLib() {
+    if (handle) {
+        dlclose(handle);
+    }
+}
+
+char* CaesarLib::encryptText(char* text, int shift) {
+    if (!transform) {
+        return encrypt(text, shift);
+    }
+    size_t length = std::strlen(text);
+    char* result = new char[length + 1];
+    transform(text, result, length, shift);
+    result[length] = '\0';
+    return result;
+}
+
+char* CaesarLib::decryptText(char* text, int shift) {
+    if (!transform) {
+        return decrypt(text, shift);
+    }
+    size_t length = std::strlen(text);
+    char* result = new char[length + 1];
+    transform(text, result, length, -(shift % 26));
+    result[length] = '\0';
+    return result;
+}
+
+void CaesarLib::encryptBuffer(char* data, size_t len, int shift) {
+    if (transform) {
+        transform(data, data, len, shift);
+        return;
+    }
+    transformBuffer(encrypt, data, len, shift);
+}
+
+void CaesarLib::decryptBuffer(char* data, size_t len, int shift) {
+    if (transform) {
+        transform(data, data, len, -(shift % 26));
+        return;
+    }
+    transformBuffer(decrypt, data, len, shift);
+}
+
+void CaesarLib::transformBuffer(char* (*transform)(char*, int), char* data, size_t len, int shift) {
+    data[len] = '\0';
+    for (size_t pos = 0; pos < len;) {
+        size_t run = std::strlen(data + pos);
+        if (run > 0) {
+            char* result = transform(data + pos, shift);
+            std::memcpy(data + pos, result, run);
+            delete[] result;
+        }
+        pos += run + 1;
+    }
+}
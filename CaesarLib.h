@@ -0,0 +1,46 @@
+#ifndef TEXT_EDITOR_CAESARLIB_H
+#define TEXT_EDITOR_CAESARLIB_H
+
+#include <cstddef>
+
+#ifndef CAESAR_LIB_PATH
+#define CAESAR_LIB_PATH "/Users/arturnanivskij/Documents/text_editor/CaesarCipher.so"
+#endif
+
+typedef char* (*EncryptFunc)(char*, int);
+typedef char* (*DecryptFunc)(char*, int);
+typedef void (*TransformFunc)(const char*, char*, size_t, int);
+
+// Runtime binding to CaesarCipher.so. The v2 caesar_transform symbol is used
+// when the library exports it, otherwise the v1 encrypt/decrypt pair.
+class CaesarLib {
+private:
+    void* handle;
+    EncryptFunc encrypt;
+    DecryptFunc decrypt;
+    TransformFunc transform;
+
+    static void transformBuffer(char* (*transform)(char*, int), char* data, size_t len, int shift);
+
+public:
+    CaesarLib(const char* libPath);
+    ~CaesarLib();
+
+    CaesarLib(const CaesarLib&) = delete;
+    CaesarLib& operator=(const CaesarLib&) = delete;
+
+    bool hasBufferApi() const {
+        return transform != nullptr;
+    }
+
+    char* encryptText(char* text, int shift);
+    char* decryptText(char* text, int shift);
+
+    // In-place variants for raw blocks; data[len] must be writable. Without
+    // the v2 ABI the exported functions stop at NUL, so NUL-separated runs
+    // are passed one at a time and the NUL bytes are left untouched.
+    void encryptBuffer(char* data, size_t len, int shift);
+    void decryptBuffer(char* data, size_t len, int shift);
+};
+
+#endif //TEXT_EDITOR_CAESARLIB_H
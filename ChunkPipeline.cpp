@@ -0,0 +1,189 @@
+#include "ChunkPipeline.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+enum SlotState {
+    SLOT_FREE,
+    SLOT_READ,
+    SLOT_DONE
+};
+
+struct Slot {
+    std::vector<char> data;
+    size_t length;
+    SlotState state;
+
+    Slot() : length(0), state(SLOT_FREE) {}
+};
+
+ssize_t readFully(int fd, char *buffer, size_t size) {
+    size_t total = 0;
+    while (total < size) {
+        ssize_t n = read(fd, buffer + total, size - total);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += n;
+    }
+    return total;
+}
+
+bool writeFully(int fd, const char *buffer, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, buffer, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buffer += n;
+        size -= n;
+    }
+    return true;
+}
+
+}
+
+ChunkPipeline::ChunkPipeline(size_t threads, size_t chunk)
+        : threadCount(threads), chunkSize(chunk), bytesProcessed(0), seconds(0) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+double ChunkPipeline::getThroughput() const {
+    return seconds > 0 ? bytesProcessed / (1024.0 * 1024.0) / seconds : 0;
+}
+
+bool ChunkPipeline::run(const char *inputFileName, const char *outputFileName, const Transform &transform) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bytesProcessed = 0;
+    seconds = 0;
+
+    int input = open(inputFileName, O_RDONLY | O_CLOEXEC);
+    if (input < 0) {
+        std::cerr << "Error opening input file: " << inputFileName << std::endl;
+        return false;
+    }
+    int output = open(outputFileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (output < 0) {
+        std::cerr << "Error opening output file: " << outputFileName << std::endl;
+        close(input);
+        return false;
+    }
+    posix_fadvise(input, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    std::vector<Slot> ring(threadCount * 2);
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t chunksRead = 0;
+    size_t chunksClaimed = 0;
+    bool endOfInput = false;
+    bool failed = false;
+
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threadCount; ++t) {
+        workers.emplace_back([&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                changed.wait(lock, [&]() {
+                    return chunksClaimed < chunksRead || endOfInput || failed;
+                });
+                if (chunksClaimed == chunksRead) {
+                    return;
+                }
+                Slot &slot = ring[chunksClaimed++ % ring.size()];
+                lock.unlock();
+                transform(slot.data.data(), slot.length);
+                lock.lock();
+                slot.state = SLOT_DONE;
+                changed.notify_all();
+            }
+        });
+    }
+
+    std::thread writer([&]() {
+        for (size_t i = 0;; ++i) {
+            Slot &slot = ring[i % ring.size()];
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() {
+                return slot.state == SLOT_DONE || (endOfInput && i == chunksRead) || failed;
+            });
+            if (slot.state != SLOT_DONE || failed) {
+                return;
+            }
+            lock.unlock();
+            bool written = writeFully(output, slot.data.data(), slot.length);
+            lock.lock();
+            if (!written) {
+                std::cerr << "Error writing output file: " << outputFileName << std::endl;
+                failed = true;
+            }
+            slot.state = SLOT_FREE;
+            changed.notify_all();
+        }
+    });
+
+    for (size_t i = 0;; ++i) {
+        Slot &slot = ring[i % ring.size()];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() {
+                return slot.state == SLOT_FREE || failed;
+            });
+            if (failed) {
+                break;
+            }
+        }
+        if (slot.data.empty()) {
+            slot.data.resize(chunkSize + 1);
+        }
+        ssize_t n = readFully(input, slot.data.data(), chunkSize);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (n <= 0) {
+            if (n < 0) {
+                std::cerr << "Error reading input file: " << inputFileName << std::endl;
+                failed = true;
+            }
+            endOfInput = true;
+            changed.notify_all();
+            break;
+        }
+        slot.length = n;
+        slot.state = SLOT_READ;
+        bytesProcessed += n;
+        chunksRead++;
+        changed.notify_all();
+    }
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    writer.join();
+    close(input);
+    if (close(output) != 0 && !failed) {
+        std::cerr << "Error writing output file: " << outputFileName << std::endl;
+        failed = true;
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return !failed;
+}
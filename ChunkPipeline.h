@@ -0,0 +1,45 @@
+#ifndef TEXT_EDITOR_CHUNKPIPELINE_H
+#define TEXT_EDITOR_CHUNKPIPELINE_H
+
+#include <cstddef>
+#include <functional>
+
+#define DEFAULT_CHUNK_SIZE (4 << 20)
+
+// Streams a file through a position-independent transform. Large blocks are
+// read in order, transformed in place by a pool of worker threads and
+// written back in order by a dedicated writer thread.
+class ChunkPipeline {
+public:
+    // Receives a block and its length; block[length] is writable scratch.
+    typedef std::function<void(char *, size_t)> Transform;
+
+private:
+    size_t threadCount;
+    size_t chunkSize;
+    size_t bytesProcessed;
+    double seconds;
+
+public:
+    explicit ChunkPipeline(size_t threads, size_t chunk = DEFAULT_CHUNK_SIZE);
+
+    // Reports the error and returns false if a file cannot be opened, read
+    // or written.
+    bool run(const char *inputFileName, const char *outputFileName, const Transform &transform);
+
+    size_t getThreadCount() const {
+        return threadCount;
+    }
+
+    size_t getBytesProcessed() const {
+        return bytesProcessed;
+    }
+
+    double getSeconds() const {
+        return seconds;
+    }
+
+    double getThroughput() const;
+};
+
+#endif //TEXT_EDITOR_CHUNKPIPELINE_H
@@ -0,0 +1,154 @@
+#include "Compression.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+void appendLength(std::string &out, size_t length) {
+    while (length >= 255) {
+        out += static_cast<char>(255);
+        length -= 255;
+    }
+    out += static_cast<char>(length);
+}
+
+bool readLength(const unsigned char *&in, const unsigned char *end, size_t &length) {
+    unsigned char byte;
+    do {
+        if (in == end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Appends literals followed by a match; a zero `matchLength` ends the block.
+void appendSequence(std::string &out, const char *literals, size_t literalLength, size_t offset,
+                    size_t matchLength) {
+    size_t matchCode = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+    out += static_cast<char>((literalLength < 15 ? literalLength : 15) << 4 | (matchCode < 15 ? matchCode : 15));
+    if (literalLength >= 15) {
+        appendLength(out, literalLength - 15);
+    }
+    out.append(literals, literalLength);
+    if (!matchLength) {
+        return;
+    }
+    out += static_cast<char>(offset & 0xff);
+    out += static_cast<char>(offset >> 8);
+    if (matchCode >= 15) {
+        appendLength(out, matchCode - 15);
+    }
+}
+
+uint32_t hashOf(const char *at, size_t bits) {
+    uint32_t sequence;
+    std::memcpy(&sequence, at, sizeof(sequence));
+    return (sequence * 2654435761u) >> (32 - bits);
+}
+
+// Length of the common prefix of a and b, at most `limit`, eight bytes at
+// a time.
+size_t commonPrefix(const char *a, const char *b, size_t limit) {
+    size_t length = 0;
+    while (length + sizeof(uint64_t) <= limit) {
+        uint64_t x, y;
+        std::memcpy(&x, a + length, sizeof(x));
+        std::memcpy(&y, b + length, sizeof(y));
+        if (x != y) {
+            return length + (__builtin_ctzll(x ^ y) >> 3);
+        }
+        length += sizeof(uint64_t);
+    }
+    while (length < limit && a[length] == b[length]) {
+        ++length;
+    }
+    return length;
+}
+
+}
+
+void compressLz(const char *data, size_t size, std::string &out) {
+    out.clear();
+    out.reserve(size / 2 + 16);
+    // Last position + 1 seen for each hash, 0 meaning none. Small inputs
+    // get a smaller table so that clearing it does not dominate.
+    size_t bits = 10;
+    while (bits < LZ_HASH_BITS && (size_t(1) << bits) < size) {
+        ++bits;
+    }
+    std::vector<size_t> table(size_t(1) << bits, 0);
+    size_t anchor = 0;
+    size_t i = 0;
+    size_t misses = 0;
+    while (i + LZ_MIN_MATCH <= size) {
+        uint32_t hash = hashOf(data + i, bits);
+        size_t candidate = table[hash];
+        table[hash] = i + 1;
+        if (!candidate || i - (candidate - 1) > LZ_MAX_OFFSET ||
+            std::memcmp(data + candidate - 1, data + i, LZ_MIN_MATCH) != 0) {
+            // Incompressible stretches are skipped faster the longer they get.
+            i += 1 + (misses++ >> 6);
+            continue;
+        }
+        size_t match = candidate - 1;
+        size_t length = LZ_MIN_MATCH + commonPrefix(data + match + LZ_MIN_MATCH, data + i + LZ_MIN_MATCH,
+                                                    size - i - LZ_MIN_MATCH);
+        appendSequence(out, data + anchor, i - anchor, i - match, length);
+        i += length;
+        anchor = i;
+        misses = 0;
+    }
+    appendSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+bool decompressLz(const char *data, size_t size, char *out, size_t outSize) {
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(data);
+    const unsigned char *end = in + size;
+    size_t written = 0;
+    while (in < end) {
+        unsigned char token = *in++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(in, end, literalLength)) {
+            return false;
+        }
+        if (literalLength > static_cast<size_t>(end - in) || literalLength > outSize - written) {
+            return false;
+        }
+        std::memcpy(out + written, in, literalLength);
+        in += literalLength;
+        written += literalLength;
+        if (in == end) {
+            break;
+        }
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = in[0] | static_cast<size_t>(in[1]) << 8;
+        in += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(in, end, matchLength)) {
+            return false;
+        }
+        matchLength += LZ_MIN_MATCH;
+        if (offset == 0 || offset > written || matchLength > outSize - written) {
+            return false;
+        }
+        char *target = out + written;
+        const char *source = target - offset;
+        if (offset >= matchLength) {
+            std::memcpy(target, source, matchLength);
+        } else {
+            // The match overlaps the bytes it produces.
+            for (size_t k = 0; k < matchLength; ++k) {
+                target[k] = source[k];
+            }
+        }
+        written += matchLength;
+    }
+    return written == outSize;
+}
@@ -0,0 +1,22 @@
+#ifndef TEXT_EDITOR_COMPRESSION_H
+#define TEXT_EDITOR_COMPRESSION_H
+
+#include <cstddef>
+#include <string>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 16
+
+// Byte-oriented LZ77 in the spirit of LZ4: a block is a sequence of
+// (token, literals, offset, match) groups where the token holds 4-bit
+// literal and match lengths extended by 255-runs, offsets are 16-bit and
+// the final group has literals only. Fast rather than tight; meant for
+// data that is written once and rarely read back, like spilled history.
+void compressLz(const char *data, size_t size, std::string &out);
+
+// Decodes a block produced by compressLz into exactly `outSize` bytes.
+// Returns false if the block is malformed or does not decode to that size.
+bool decompressLz(const char *data, size_t size, char *out, size_t outSize);
+
+#endif //TEXT_EDITOR_COMPRESSION_H
@@ -0,0 +1,559 @@
+#include "Daemon.h"
+#include "BatchScript.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// What the storage printed while this thread handled its current request.
+struct Capture {
+    bool active;
+    std::string out;
+    std::string err;
+};
+
+thread_local Capture capture;
+
+// Installed on std::cout and std::cerr while the daemon runs: a thread with
+// an active Capture writes into it, every other thread to the original
+// buffer, so one client's messages neither reach the server terminal nor
+// mix with another client's.
+class RoutedBuf : public std::streambuf {
+private:
+    std::ostream &stream;
+    std::streambuf *original;
+    std::string Capture::*target;
+
+protected:
+    int overflow(int c) override {
+        if (c == traits_type::eof()) {
+            return traits_type::not_eof(c);
+        }
+        if (capture.active) {
+            (capture.*target) += traits_type::to_char_type(c);
+            return c;
+        }
+        return original->sputc(traits_type::to_char_type(c));
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        if (capture.active) {
+            (capture.*target).append(s, n);
+            return n;
+        }
+        return original->sputn(s, n);
+    }
+
+    int sync() override {
+        return capture.active ? 0 : original->pubsync();
+    }
+
+public:
+    RoutedBuf(std::ostream &routed, std::string Capture::*into)
+            : stream(routed), original(routed.rdbuf()), target(into) {
+        stream.rdbuf(this);
+    }
+
+    ~RoutedBuf() override {
+        stream.rdbuf(original);
+    }
+};
+
+// Captures the output of one request on the calling thread.
+struct CaptureScope {
+    CaptureScope() {
+        capture.active = true;
+        capture.out.clear();
+        capture.err.clear();
+    }
+
+    ~CaptureScope() {
+        capture.active = false;
+    }
+};
+
+// The last error the storage reported during this request, or `fallback`.
+std::string diagnosis(const char *fallback) {
+    std::string_view err = capture.err;
+    while (!err.empty() && err.back() == '\n') {
+        err.remove_suffix(1);
+    }
+    size_t lineStart = err.rfind('\n');
+    err.remove_prefix(lineStart == std::string_view::npos ? 0 : lineStart + 1);
+    return err.empty() ? fallback : std::string(err);
+}
+
+void respond(std::string &out, const std::string &payload) {
+    out += "OK ";
+    out += std::to_string(payload.size());
+    out += '\n';
+    out += payload;
+}
+
+void fail(std::string &out, const std::string &message) {
+    out += "ERR ";
+    out += message;
+    out += '\n';
+}
+
+bool sendAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+bool socketAddress(const char *path, sockaddr_un &address) {
+    if (std::strlen(path) >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path is too long: " << path << "\n";
+        return false;
+    }
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path);
+    return true;
+}
+
+SearchOptions optionsOf(std::string_view flags, size_t threads) {
+    SearchOptions options;
+    options.ignoreCase = flags.find('i') != std::string_view::npos;
+    options.wholeWord = flags.find('w') != std::string_view::npos;
+    options.threads = threads;
+    return options;
+}
+
+}
+
+Daemon::Daemon(size_t threads, bool journal, size_t budget)
+        : workerThreads(threads), journaling(journal), historyBudget(budget), listenFd(-1), stopping(false) {}
+
+Daemon::~Daemon() {
+    reapClients(true);
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+}
+
+bool Daemon::listen(const char *path) {
+    sockaddr_un address;
+    if (!socketAddress(path, address)) {
+        return false;
+    }
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        std::cerr << "Error creating socket\n";
+        return false;
+    }
+    // A socket file nobody accepts on is left over from a daemon that died.
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0 && connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) {
+        std::cerr << "A daemon is already listening on " << path << "\n";
+        close(probe);
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    if (probe >= 0) {
+        close(probe);
+    }
+    unlink(path);
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Error listening on " << path << ": " << std::strerror(errno) << "\n";
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    socketPath = path;
+    return true;
+}
+
+void Daemon::run() {
+    RoutedBuf routedOut(std::cout, &Capture::out);
+    RoutedBuf routedErr(std::cerr, &Capture::err);
+    while (!stopping) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (!stopping && (errno == EINTR || errno == ECONNABORTED)) {
+                continue;
+            }
+            if (!stopping) {
+                std::cerr << "Error accepting connection: " << std::strerror(errno) << "\n";
+            }
+            break;
+        }
+        reapClients(false);
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        clients.emplace_back(new Client(fd));
+        Client &client = *clients.back();
+        client.thread = std::thread(&Daemon::serve, this, std::ref(client));
+    }
+    reapClients(true);
+}
+
+void Daemon::stop() {
+    stopping = true;
+    if (listenFd >= 0) {
+        shutdown(listenFd, SHUT_RDWR);
+    }
+}
+
+void Daemon::reapClients(bool all) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    size_t kept = 0;
+    for (std::unique_ptr<Client> &client : clients) {
+        if (!all && !client->done) {
+            clients[kept++] = std::move(client);
+            continue;
+        }
+        shutdown(client->fd, SHUT_RDWR);
+        client->thread.join();
+        close(client->fd);
+    }
+    clients.resize(kept);
+}
+
+void Daemon::serve(Client &client) {
+    std::shared_ptr<Resident> document;
+    std::string in;
+    std::string out;
+    std::vector<char> chunk(DAEMON_READ_BYTES);
+    bool connected = true;
+    while (connected) {
+        ssize_t got = recv(client.fd, chunk.data(), chunk.size(), 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        in.append(chunk.data(), got);
+        out.clear();
+        size_t start = 0;
+        while (connected) {
+            const char *newline = static_cast<const char *>(std::memchr(in.data() + start, '\n', in.size() - start));
+            if (!newline) {
+                break;
+            }
+            connected = handle(in.data() + start, newline, document, out);
+            start = newline - in.data() + 1;
+        }
+        in.erase(0, start);
+        if (in.size() > DAEMON_MAX_REQUEST_BYTES) {
+            fail(out, "request too long");
+            connected = false;
+        }
+        if (!out.empty() && !sendAll(client.fd, out.data(), out.size())) {
+            break;
+        }
+    }
+    shutdown(client.fd, SHUT_RDWR);
+    client.done = true;
+}
+
+std::shared_ptr<Daemon::Resident> Daemon::open(const std::string &path, std::string &error) {
+    char resolved[PATH_MAX];
+    if (!realpath(path.c_str(), resolved)) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    std::shared_ptr<Resident> resident;
+    std::unique_lock<std::shared_mutex> loading;
+    {
+        std::lock_guard<std::mutex> lock(documentsMutex);
+        std::shared_ptr<Resident> &slot = documents[resolved];
+        if (slot) {
+            return slot;
+        }
+        slot = std::make_shared<Resident>();
+        resident = slot;
+        // Held until the file is in, so other sessions opening it wait.
+        loading = std::unique_lock<std::shared_mutex>(resident->lock);
+    }
+    resident->path = resolved;
+    resident->storage.setWorkerThreads(workerThreads);
+    resident->storage.setHistoryBudget(historyBudget);
+    resident->storage.setJournaling(journaling);
+    resident->loaded = resident->storage.loadFromFile(resolved);
+    if (!resident->loaded) {
+        std::lock_guard<std::mutex> lock(documentsMutex);
+        documents.erase(resolved);
+        error = "cannot load " + path;
+        return nullptr;
+    }
+    return resident;
+}
+
+bool Daemon::handle(const char *begin, const char *end, std::shared_ptr<Resident> &document, std::string &out) {
+    if (end > begin && end[-1] == '\r') {
+        --end;
+    }
+    ScriptLine request(begin, end);
+    std::string_view command = request.word();
+    std::string text;
+    CaptureScope scope;
+    if (command == "quit") {
+        respond(out, "");
+        return false;
+    } else if (command == "shutdown") {
+        respond(out, "");
+        stop();
+        return false;
+    } else if (command == "open") {
+        std::string error;
+        std::shared_ptr<Resident> opened = open(request.text(text), error);
+        if (opened) {
+            document = std::move(opened);
+            respond(out, "");
+        } else {
+            fail(out, error);
+        }
+        return true;
+    } else if (command == "documents") {
+        std::lock_guard<std::mutex> lock(documentsMutex);
+        for (const auto &entry : documents) {
+            text += entry.first;
+            text += '\n';
+        }
+        respond(out, text);
+        return true;
+    }
+    if (!document) {
+        fail(out, command.empty() ? "empty request" : "no document open");
+        return true;
+    }
+    if (command == "close") {
+        // Other sessions may still hold the document; it is evicted only
+        // when the map and this session are the last to. New references
+        // are only handed out under this lock, so the count cannot grow.
+        std::lock_guard<std::mutex> lock(documentsMutex);
+        std::map<std::string, std::shared_ptr<Resident>>::iterator it = documents.find(document->path);
+        if (it != documents.end() && it->second == document && document.use_count() == 2) {
+            documents.erase(it);
+        }
+        document.reset();
+        respond(out, "");
+    } else if (isRead(command)) {
+        std::shared_lock<std::shared_mutex> lock(document->lock);
+        if (document->loaded) {
+            read(*document, request, command, out);
+        } else {
+            fail(out, "document could not be loaded");
+        }
+    } else {
+        std::unique_lock<std::shared_mutex> lock(document->lock);
+        if (!document->loaded) {
+            fail(out, "document could not be loaded");
+        } else if (!edit(*document, request, command, out)) {
+            fail(out, "unknown command");
+        }
+    }
+    return true;
+}
+
+bool Daemon::isRead(std::string_view command) {
+    return command == "print" || command == "line" || command == "copy" || command == "copy-at" ||
+           command == "search" || command == "search-options" || command == "info";
+}
+
+void Daemon::read(Resident &document, ScriptLine &request, std::string_view command, std::string &out) {
+    const TextStorage &storage = document.storage;
+    size_t lineIndex, position, length, offset;
+    std::string text;
+    if (command == "print") {
+        if (storage.getDocumentLength() == 0) {
+            respond(out, "");
+        } else if (storage.textAt(0, storage.getDocumentLength() - 1, text)) {
+            text += '\n';
+            respond(out, text);
+        } else {
+            fail(out, diagnosis("cannot read document"));
+        }
+    } else if (command == "line" && request.index(lineIndex)) {
+        if (lineIndex >= storage.getLineCount()) {
+            fail(out, "line out of bounds");
+            return;
+        }
+        storage.checkMappings();
+        const Line &line = storage.getLine(lineIndex);
+        respond(out, std::string(line.getText(), line.getTextLength()));
+    } else if (command == "copy" && request.index(lineIndex) && request.index(position) && request.index(length)) {
+        size_t end;
+        if (storage.positionToOffset(lineIndex, position, offset) &&
+            storage.positionToOffset(lineIndex, position + length, end) && storage.textAt(offset, end - offset, text)) {
+            respond(out, text);
+        } else {
+            fail(out, diagnosis("range out of bounds"));
+        }
+    } else if (command == "copy-at" && request.index(offset) && request.index(length)) {
+        if (storage.textAt(offset, length, text)) {
+            respond(out, text);
+        } else {
+            fail(out, diagnosis("range out of bounds"));
+        }
+    } else if (command == "search" || command == "search-options") {
+        SearchOptions options = optionsOf(command == "search" ? "" : request.word(), storage.getWorkerThreads());
+        std::vector<SearchMatch> matches = storage.findText(request.text(text), options);
+        std::string found;
+        for (const SearchMatch &match : matches) {
+            found += std::to_string(match.line);
+            found += ' ';
+            found += std::to_string(storage.getLine(match.line).columnOf(match.pos));
+            found += '\n';
+        }
+        respond(out, found);
+    } else if (command == "info") {
+        respond(out, std::to_string(storage.getLineCount()) + " " + std::to_string(storage.getDocumentLength()) +
+                     " " + std::to_string(storage.getEditCount()) + "\n");
+    } else {
+        fail(out, "invalid arguments");
+    }
+}
+
+bool Daemon::edit(Resident &document, ScriptLine &request, std::string_view command, std::string &out) {
+    TextStorage &storage = document.storage;
+    size_t lineIndex, position, length;
+    std::string text;
+    std::string result;
+    size_t edits = storage.getEditCount();
+    bool parsed = true;
+    // Most edits tell whether they applied only through the edit count.
+    bool counted = true;
+    bool applied = true;
+    if (command == "append") {
+        storage.appendText(storage.getLineCount() - 1, request.text(text));
+    } else if (command == "newline") {
+        storage.addNewLine();
+    } else if ((command == "insert" || command == "replace") && request.index(lineIndex) &&
+               request.index(position)) {
+        if (command == "insert") {
+            storage.insertText(lineIndex, position, request.text(text));
+        } else {
+            storage.insertWithReplace(lineIndex, position, request.text(text));
+        }
+    } else if (command == "delete" && request.index(lineIndex) && request.index(position) &&
+               request.index(length)) {
+        storage.deleteText(lineIndex, position, length);
+    } else if (command == "insert-at" && request.index(position)) {
+        storage.insertTextAt(position, request.text(text));
+    } else if (command == "delete-at" && request.index(position) && request.index(length)) {
+        storage.deleteTextAt(position, length);
+    } else if (command == "replace-all") {
+        SearchOptions options = optionsOf(request.word(), storage.getWorkerThreads());
+        std::string rest = request.text(text);
+        size_t separator = rest.find('|');
+        parsed = separator != std::string::npos;
+        if (parsed) {
+            rest[separator] = '\0';
+            result = std::to_string(storage.replaceAll(rest.c_str(), rest.c_str() + separator + 1, options)) + "\n";
+        }
+        counted = false;
+    } else if (command == "undo" || command == "redo" || command == "save") {
+        if (command == "save") {
+            applied = storage.saveToFile(document.path.c_str());
+        } else {
+            applied = command == "undo" ? storage.undo() : storage.redo();
+        }
+        counted = false;
+    } else if (command == "insert" || command == "replace" || command == "delete" || command == "insert-at" ||
+               command == "delete-at") {
+        parsed = false;
+    } else {
+        return false;
+    }
+    if (!parsed) {
+        fail(out, "invalid arguments");
+    } else if (counted ? storage.getEditCount() == edits : !applied) {
+        fail(out, diagnosis(command == "save" ? "cannot save" : "rejected"));
+    } else {
+        respond(out, result.empty() ? std::to_string(storage.getEditCount()) + "\n" : result);
+    }
+    return true;
+}
+
+DaemonClient::DaemonClient() : fd(-1), consumed(0) {}
+
+DaemonClient::~DaemonClient() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool DaemonClient::connect(const char *path) {
+    sockaddr_un address;
+    if (!socketAddress(path, address)) {
+        return false;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        std::cerr << "Error connecting to " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool DaemonClient::fill() {
+    if (consumed > 0 && consumed * 2 >= buffer.size()) {
+        buffer.erase(0, consumed);
+        consumed = 0;
+    }
+    char chunk[DAEMON_READ_BYTES];
+    while (true) {
+        ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        buffer.append(chunk, got);
+        return true;
+    }
+}
+
+bool DaemonClient::request(const std::string &line, bool &ok, std::string &payload) {
+    std::string message = line + "\n";
+    if (fd < 0 || !sendAll(fd, message.data(), message.size())) {
+        return false;
+    }
+    size_t newline;
+    while ((newline = buffer.find('\n', consumed)) == std::string::npos) {
+        if (!fill()) {
+            return false;
+        }
+    }
+    ok = buffer.compare(consumed, 3, "OK ") == 0;
+    if (!ok) {
+        size_t skip = std::min<size_t>(4, newline - consumed);
+        payload.assign(buffer, consumed + skip, newline - consumed - skip);
+        consumed = newline + 1;
+        return true;
+    }
+    size_t length = std::strtoull(buffer.c_str() + consumed + 3, nullptr, 10);
+    consumed = newline + 1;
+    while (buffer.size() - consumed < length) {
+        if (!fill()) {
+            return false;
+        }
+    }
+    payload.assign(buffer, consumed, length);
+    consumed += length;
+    return true;
+}
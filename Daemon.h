@@ -0,0 +1,125 @@
+#ifndef TEXT_EDITOR_DAEMON_H
+#define TEXT_EDITOR_DAEMON_H
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "TextStorage.h"
+
+#define DAEMON_MAX_REQUEST_BYTES (1 << 20)
+#define DAEMON_READ_BYTES (64 << 10)
+
+class ScriptLine;
+
+// Keeps documents loaded and serves them to clients of a Unix domain socket,
+// one thread per connection. Requests are lines in the batch script syntax
+// and may be pipelined; each gets one response, either
+//   OK <length>\n<length bytes of payload>
+// or
+//   ERR <message>\n
+// A connection first opens a document by path; every connection opening the
+// same file shares one resident copy, which stays loaded until the last
+// connection holding it closes it. Reads of a document (print, line,
+// copy, copy-at, search, search-options, info) run concurrently under a
+// shared lock, edits take it exclusively:
+//   open PATH | close | documents | quit | shutdown
+//   print | line L | copy L C N | copy-at OFF N | info
+//   search TEXT | search-options FLAGS TEXT
+//   append TEXT | newline | insert L C TEXT | replace L C TEXT
+//   delete L C N | insert-at OFF TEXT | delete-at OFF N
+//   replace-all FLAGS PATTERN|REPLACEMENT | undo | redo | save
+// Edits answer with the document's edit count, replace-all with the number
+// of replacements, search with one "L C" line per match and info with
+// "lines bytes edits". What the storage prints while handling a request is
+// kept from the server's terminal; a failed request answers with the last
+// error it printed.
+class Daemon {
+private:
+    struct Resident {
+        std::shared_mutex lock;
+        TextStorage storage;
+        std::string path;
+        bool loaded;
+
+        Resident() : loaded(false) {}
+    };
+
+    struct Client {
+        std::thread thread;
+        int fd;
+        std::atomic<bool> done;
+
+        explicit Client(int socket) : fd(socket), done(false) {}
+    };
+
+    size_t workerThreads;
+    bool journaling;
+    size_t historyBudget;
+    int listenFd;
+    std::string socketPath;
+    std::atomic<bool> stopping;
+    std::mutex documentsMutex;
+    std::map<std::string, std::shared_ptr<Resident>> documents;
+    std::mutex clientsMutex;
+    std::vector<std::unique_ptr<Client>> clients;
+
+    void serve(Client &client);
+    // Appends the response to `out`; returns false to close the connection.
+    bool handle(const char *begin, const char *end, std::shared_ptr<Resident> &document, std::string &out);
+    static bool isRead(std::string_view command);
+    static void read(Resident &document, ScriptLine &request, std::string_view command, std::string &out);
+    // Returns false if `command` is not an edit.
+    static bool edit(Resident &document, ScriptLine &request, std::string_view command, std::string &out);
+    std::shared_ptr<Resident> open(const std::string &path, std::string &error);
+    void reapClients(bool all);
+
+public:
+    Daemon(size_t threads, bool journal, size_t budget);
+    ~Daemon();
+
+    Daemon(const Daemon &) = delete;
+    Daemon &operator=(const Daemon &) = delete;
+
+    // Binds and listens on `path`, replacing a stale socket file there.
+    bool listen(const char *path);
+
+    // Accepts clients until stop() or a shutdown request, then closes every
+    // connection. The socket file is removed with the Daemon.
+    void run();
+
+    // Safe to call from a signal handler.
+    void stop();
+};
+
+// Blocking client of a Daemon, used by the load generator.
+class DaemonClient {
+private:
+    int fd;
+    std::string buffer;
+    size_t consumed;
+
+    bool fill();
+
+public:
+    DaemonClient();
+    ~DaemonClient();
+
+    DaemonClient(const DaemonClient &) = delete;
+    DaemonClient &operator=(const DaemonClient &) = delete;
+
+    bool connect(const char *path);
+
+    // Sends one request line (without the newline) and waits for its
+    // response. Returns false if the connection failed; `ok` tells an OK
+    // response from an ERR one, whose message goes to `payload`.
+    bool request(const std::string &line, bool &ok, std::string &payload);
+};
+
+#endif //TEXT_EDITOR_DAEMON_H
@@ -0,0 +1,225 @@
+#include "EditJournal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char JOURNAL_MAGIC[4] = {'T', 'E', 'J', '1'};
+const size_t JOURNAL_HEADER_BYTES = sizeof(JOURNAL_MAGIC) + sizeof(uint64_t) + sizeof(int64_t);
+
+uint32_t checksumOf(const char *data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+bool writeAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+}
+
+bool JournalBase::of(const char *path, JournalBase &base) {
+    struct stat info;
+    if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) {
+        return false;
+    }
+    base.size = info.st_size;
+    base.mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    return true;
+}
+
+EditJournal::EditJournal()
+        : fd(-1), groupEdits(JOURNAL_GROUP_EDITS), groupInterval(JOURNAL_GROUP_INTERVAL_MS), pendingRecords(0),
+          stopping(false), failed(false), records(0), syncs(0), bytes(0) {}
+
+EditJournal::~EditJournal() {
+    close(false);
+}
+
+bool EditJournal::openFile(const std::string &journalPath, int flags) {
+    close(false);
+    fd = ::open(journalPath.c_str(), O_WRONLY | O_CLOEXEC | flags, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    path = journalPath;
+    pendingRecords = 0;
+    stopping = false;
+    failed = false;
+    records = 0;
+    syncs = 0;
+    bytes = 0;
+    flusher = std::thread(&EditJournal::flushLoop, this);
+    return true;
+}
+
+bool EditJournal::create(const std::string &journalPath, const JournalBase &base) {
+    if (!openFile(journalPath, O_CREAT | O_TRUNC)) {
+        return false;
+    }
+    std::string header(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.append(reinterpret_cast<const char *>(&base.size), sizeof(base.size));
+    header.append(reinterpret_cast<const char *>(&base.mtime), sizeof(base.mtime));
+    if (!writeAll(fd, header.data(), header.size()) || fdatasync(fd) != 0) {
+        close(true);
+        return false;
+    }
+    return true;
+}
+
+bool EditJournal::resume(const std::string &journalPath, uint64_t validLength) {
+    if (!openFile(journalPath, 0)) {
+        return false;
+    }
+    if (ftruncate(fd, validLength) != 0 || lseek(fd, 0, SEEK_END) < 0) {
+        close(false);
+        return false;
+    }
+    return true;
+}
+
+void EditJournal::append(const char *data, size_t length) {
+    uint64_t frame[2] = {length, checksumOf(data, length)};
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.append(reinterpret_cast<const char *>(frame), sizeof(frame));
+        pending.append(data, length);
+        full = ++pendingRecords >= groupEdits;
+    }
+    records++;
+    bytes += sizeof(frame) + length;
+    if (groupEdits == 0) {
+        writePending();
+    } else if (full) {
+        wake.notify_one();
+    }
+}
+
+bool EditJournal::writePending() {
+    std::lock_guard<std::mutex> fileLock(fileMutex);
+    writing.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        writing.swap(pending);
+        pendingRecords = 0;
+    }
+    if (writing.empty()) {
+        return !failed;
+    }
+    if (!writeAll(fd, writing.data(), writing.size()) || fdatasync(fd) != 0) {
+        if (!failed) {
+            std::cerr << "Error writing edit journal " << path << "\n";
+        }
+        failed = true;
+        return false;
+    }
+    syncs++;
+    if (writing.capacity() > JOURNAL_KEEP_BYTES) {
+        std::string().swap(writing);
+    }
+    return !failed;
+}
+
+void EditJournal::flushLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(groupInterval), [this]() {
+            return stopping || (groupEdits && pendingRecords >= groupEdits);
+        });
+        if (pending.empty() || stopping) {
+            continue;
+        }
+        lock.unlock();
+        writePending();
+        lock.lock();
+    }
+}
+
+bool EditJournal::sync() {
+    return fd < 0 || writePending();
+}
+
+void EditJournal::close(bool remove) {
+    if (fd < 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    flusher.join();
+    if (remove) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.clear();
+        pendingRecords = 0;
+    } else {
+        writePending();
+    }
+    ::close(fd);
+    fd = -1;
+    if (remove) {
+        unlink(path.c_str());
+    }
+}
+
+void EditJournal::setGroup(size_t edits, unsigned intervalMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    groupEdits = edits;
+    groupInterval = std::max(intervalMs, 1u);
+}
+
+bool EditJournal::read(const std::string &journalPath, JournalBase &base,
+                       const std::function<bool(const char *, size_t)> &replay, uint64_t &validLength) {
+    std::ifstream in(journalPath, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    uint64_t fileSize = in.tellg();
+    in.seekg(0);
+    char magic[sizeof(JOURNAL_MAGIC)];
+    if (fileSize < JOURNAL_HEADER_BYTES || !in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char *>(&base.size), sizeof(base.size)) ||
+        !in.read(reinterpret_cast<char *>(&base.mtime), sizeof(base.mtime))) {
+        return false;
+    }
+    validLength = JOURNAL_HEADER_BYTES;
+    std::string record;
+    uint64_t frame[2];
+    while (in.read(reinterpret_cast<char *>(frame), sizeof(frame))) {
+        if (frame[0] > fileSize - validLength - sizeof(frame)) {
+            break;
+        }
+        record.resize(frame[0]);
+        if (!in.read(&record[0], record.size()) || checksumOf(record.data(), record.size()) != frame[1] ||
+            !replay(record.data(), record.size())) {
+            break;
+        }
+        validLength += sizeof(frame) + record.size();
+    }
+    return true;
+}
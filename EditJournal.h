@@ -0,0 +1,172 @@
+#ifndef TEXT_EDITOR_EDITJOURNAL_H
+#define TEXT_EDITOR_EDITJOURNAL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define JOURNAL_GROUP_EDITS 64
+#define JOURNAL_GROUP_INTERVAL_MS 100
+// Record buffers that grew past this are released after use.
+#define JOURNAL_KEEP_BYTES (1 << 20)
+
+// Size and modification time of the saved file a journal applies to.
+struct JournalBase {
+    uint64_t size;
+    int64_t mtime;
+
+    // False if `path` is not a regular file.
+    static bool of(const char *path, JournalBase &base);
+
+    bool operator==(const JournalBase &other) const {
+        return size == other.size && mtime == other.mtime;
+    }
+};
+
+// Append-only log of the edits made to a document since it was last saved.
+// The file starts with the JournalBase of the saved file and holds one
+// length- and checksum-framed record per edit. Records are buffered in
+// memory and written and fdatasync'ed by a background thread once
+// JOURNAL_GROUP_EDITS of them are pending or JOURNAL_GROUP_INTERVAL_MS have
+// passed, so an edit never waits for the disk and a crash loses at most one
+// group. A record torn by a crash fails its checksum and ends the replay.
+class EditJournal {
+private:
+    int fd;
+    std::string path;
+    size_t groupEdits;
+    unsigned groupInterval;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread flusher;
+    std::string pending;
+    size_t pendingRecords;
+    bool stopping;
+    // Only touched with fileMutex held.
+    std::mutex fileMutex;
+    std::string writing;
+    bool failed;
+    uint64_t records;
+    uint64_t syncs;
+    uint64_t bytes;
+
+    bool openFile(const std::string &journalPath, int flags);
+    void flushLoop();
+    bool writePending();
+
+public:
+    EditJournal();
+    ~EditJournal();
+
+    EditJournal(const EditJournal &) = delete;
+    EditJournal &operator=(const EditJournal &) = delete;
+
+    // Starts an empty journal at `journalPath`, replacing any file there.
+    bool create(const std::string &journalPath, const JournalBase &base);
+
+    // Reopens a replayed journal for appending; whatever follows the last
+    // valid record is cut off.
+    bool resume(const std::string &journalPath, uint64_t validLength);
+
+    void append(const char *data, size_t length);
+
+    // Writes and syncs everything appended so far.
+    bool sync();
+
+    // Stops the background thread; pending records are synced first unless
+    // the file is removed.
+    void close(bool remove);
+
+    bool isOpen() const {
+        return fd >= 0;
+    }
+
+    const std::string &getPath() const {
+        return path;
+    }
+
+    // Edits per group and the longest time a record stays unsynced. With 0
+    // edits per group every append syncs before it returns.
+    void setGroup(size_t edits, unsigned intervalMs);
+
+    uint64_t getRecords() const {
+        return records;
+    }
+
+    uint64_t getSyncs() const {
+        return syncs;
+    }
+
+    uint64_t getBytes() const {
+        return bytes;
+    }
+
+    // Reads the journal at `journalPath` and calls replay(data, length) for
+    // each intact record until it returns false. Returns false if there is
+    // no journal or its header is unreadable; validLength is the end of the
+    // last record replayed.
+    static bool read(const std::string &journalPath, JournalBase &base,
+                     const std::function<bool(const char *, size_t)> &replay, uint64_t &validLength);
+};
+
+// Serializes into a string with the interface of SpillWriter.
+class ByteWriter {
+private:
+    std::string &out;
+
+public:
+    explicit ByteWriter(std::string &target) : out(target) {}
+
+    void append(const void *data, size_t length) {
+        out.append(static_cast<const char *>(data), length);
+    }
+
+    template <typename T>
+    void value(T data) {
+        append(&data, sizeof(data));
+    }
+};
+
+// Reads a buffer written by ByteWriter with the interface of SpillReader.
+class ByteReader {
+private:
+    const char *cursor;
+    const char *end;
+
+public:
+    ByteReader(const char *data, size_t length) : cursor(data), end(data + length) {}
+
+    bool read(void *out, size_t length) {
+        const char *at;
+        if (!view(length, at)) {
+            return false;
+        }
+        std::memcpy(out, at, length);
+        return true;
+    }
+
+    template <typename T>
+    bool value(T &data) {
+        return read(&data, sizeof(data));
+    }
+
+    bool view(size_t length, const char *&at) {
+        if (length > static_cast<size_t>(end - cursor)) {
+            return false;
+        }
+        at = cursor;
+        cursor += length;
+        return true;
+    }
+
+    bool atEnd() const {
+        return cursor == end;
+    }
+};
+
+#endif //TEXT_EDITOR_EDITJOURNAL_H
@@ -0,0 +1,63 @@
+#include "GatherWriter.h"
+
+#include <cerrno>
+
+GatherWriter::GatherWriter(int descriptor) : fd(descriptor), pendingBytes(0), bytesWritten(0) {}
+
+void GatherWriter::reset(int descriptor) {
+    fd = descriptor;
+    pending.clear();
+    pendingBytes = 0;
+    bytesWritten = 0;
+}
+
+bool GatherWriter::flush() {
+    struct iovec *vec = pending.data();
+    size_t count = pending.size();
+    while (count > 0) {
+        ssize_t n = writev(fd, vec, static_cast<int>(count));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytesWritten += n;
+        size_t done = n;
+        while (count > 0 && done >= vec->iov_len) {
+            done -= vec->iov_len;
+            ++vec;
+            --count;
+        }
+        if (count > 0) {
+            vec->iov_base = static_cast<char *>(vec->iov_base) + done;
+            vec->iov_len -= done;
+        }
+    }
+    pending.clear();
+    pendingBytes = 0;
+    return true;
+}
+
+bool GatherWriter::append(const char *data, size_t len) {
+    if (fd < 0) {
+        return false;
+    }
+    if (len == 0) {
+        return true;
+    }
+    if (!pending.empty()) {
+        struct iovec &last = pending.back();
+        if (static_cast<char *>(last.iov_base) + last.iov_len == data) {
+            last.iov_len += len;
+            pendingBytes += len;
+            return pendingBytes < WRITE_BATCH_BYTES || flush();
+        }
+    }
+    pending.push_back({const_cast<char *>(data), len});
+    pendingBytes += len;
+    if (pending.size() >= WRITE_BATCH_BUFFERS || pendingBytes >= WRITE_BATCH_BYTES) {
+        return flush();
+    }
+    return true;
+}
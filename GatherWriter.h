@@ -0,0 +1,36 @@
+#ifndef TEXT_EDITOR_GATHERWRITER_H
+#define TEXT_EDITOR_GATHERWRITER_H
+
+#include <cstddef>
+#include <sys/uio.h>
+#include <vector>
+
+#define WRITE_BATCH_BYTES (1 << 20)
+#define WRITE_BATCH_BUFFERS 1024
+
+// Gathers buffers and writes them to a descriptor with writev, about
+// WRITE_BATCH_BYTES at a time. A buffer that starts where the previous one
+// ends extends it instead of taking another iovec. Appended buffers must
+// stay valid until the next flush. The descriptor is not owned.
+class GatherWriter {
+private:
+    int fd;
+    std::vector<struct iovec> pending;
+    size_t pendingBytes;
+    size_t bytesWritten;
+
+public:
+    explicit GatherWriter(int descriptor = -1);
+
+    // Drops pending buffers and starts over on `descriptor`.
+    void reset(int descriptor);
+
+    bool append(const char *data, size_t len);
+    bool flush();
+
+    size_t getBytesWritten() const {
+        return bytesWritten;
+    }
+};
+
+#endif //TEXT_EDITOR_GATHERWRITER_H
@@ -0,0 +1,115 @@
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+
+const char *operationNames[OPERATION_COUNT] = {
+        "appendText", "addNewLine", "saveToFile", "loadFromFile", "printText", "insertText", "findText",
+        "findPatterns", "replaceAll", "applyEdits", "deleteText", "undo", "redo", "cutText", "pasteText",
+        "copyText", "insertWithReplace", "encryptText", "decryptText", "encryptFile", "decryptFile",
+        "recoverKey", "printRange", "writeText", "diff", "reloadFromFile"};
+
+size_t bucketOf(uint64_t ns) {
+    size_t bucket = ns > 1 ? 63 - __builtin_clzll(ns) : 0;
+    return std::min<size_t>(bucket, LATENCY_BUCKETS - 1);
+}
+
+}
+
+Instrumentation::Counters Instrumentation::counters[OPERATION_COUNT];
+thread_local OperationTimer *OperationTimer::active = nullptr;
+
+const char *Instrumentation::getName(Operation operation) {
+    return operationNames[operation];
+}
+
+void Instrumentation::record(Operation operation, uint64_t ns, uint64_t bytes, uint64_t allocations,
+                             uint64_t allocatedBytes) {
+    Counters &counter = counters[operation];
+    counter.calls.fetch_add(1, std::memory_order_relaxed);
+    counter.totalNs.fetch_add(ns, std::memory_order_relaxed);
+    counter.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    counter.allocations.fetch_add(allocations, std::memory_order_relaxed);
+    counter.allocatedBytes.fetch_add(allocatedBytes, std::memory_order_relaxed);
+    counter.latency[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = counter.maxNs.load(std::memory_order_relaxed);
+    while (ns > max && !counter.maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void Instrumentation::reset() {
+    for (Counters &counter : counters) {
+        counter.calls = 0;
+        counter.totalNs = 0;
+        counter.maxNs = 0;
+        counter.bytes = 0;
+        counter.allocations = 0;
+        counter.allocatedBytes = 0;
+        for (std::atomic<uint64_t> &bucket : counter.latency) {
+            bucket = 0;
+        }
+    }
+}
+
+// Upper bound of the bucket holding the given fraction of the calls.
+uint64_t Instrumentation::percentile(const Counters &counter, double fraction) {
+    uint64_t calls = counter.calls.load(std::memory_order_relaxed);
+    uint64_t rank = static_cast<uint64_t>(calls * fraction + 0.999999);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKETS; ++bucket) {
+        seen += counter.latency[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return std::min(uint64_t(2) << bucket, counter.maxNs.load(std::memory_order_relaxed));
+        }
+    }
+    return counter.maxNs.load(std::memory_order_relaxed);
+}
+
+void Instrumentation::printText(std::ostream &out) {
+    out << std::left << std::setw(18) << "operation" << std::right << std::setw(10) << "calls"
+        << std::setw(12) << "mean ns" << std::setw(12) << "p50 ns" << std::setw(12) << "p99 ns"
+        << std::setw(14) << "max ns" << std::setw(14) << "bytes" << std::setw(12) << "alloc count"
+        << std::setw(14) << "alloc bytes" << "\n";
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+        const Counters &counter = counters[i];
+        uint64_t calls = counter.calls.load(std::memory_order_relaxed);
+        if (calls == 0) {
+            continue;
+        }
+        out << std::left << std::setw(18) << operationNames[i] << std::right << std::setw(10) << calls
+            << std::setw(12) << counter.totalNs.load(std::memory_order_relaxed) / calls
+            << std::setw(12) << percentile(counter, 0.50) << std::setw(12) << percentile(counter, 0.99)
+            << std::setw(14) << counter.maxNs.load(std::memory_order_relaxed)
+            << std::setw(14) << counter.bytes.load(std::memory_order_relaxed)
+            << std::setw(12) << counter.allocations.load(std::memory_order_relaxed)
+            << std::setw(14) << counter.allocatedBytes.load(std::memory_order_relaxed) << "\n";
+    }
+}
+
+void Instrumentation::printJson(std::ostream &out) {
+    out << "{";
+    bool first = true;
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+        const Counters &counter = counters[i];
+        uint64_t calls = counter.calls.load(std::memory_order_relaxed);
+        if (calls == 0) {
+            continue;
+        }
+        out << (first ? "" : ", ") << "\"" << operationNames[i] << "\": {\"calls\": " << calls
+            << ", \"total_ns\": " << counter.totalNs.load(std::memory_order_relaxed)
+            << ", \"p50_ns\": " << percentile(counter, 0.50) << ", \"p99_ns\": " << percentile(counter, 0.99)
+            << ", \"max_ns\": " << counter.maxNs.load(std::memory_order_relaxed)
+            << ", \"bytes\": " << counter.bytes.load(std::memory_order_relaxed)
+            << ", \"allocation_count\": " << counter.allocations.load(std::memory_order_relaxed)
+            << ", \"allocated_bytes\": " << counter.allocatedBytes.load(std::memory_order_relaxed)
+            << ", \"latency_log2_ns\": [";
+        for (size_t bucket = 0; bucket < LATENCY_BUCKETS; ++bucket) {
+            out << (bucket ? ", " : "") << counter.latency[bucket].load(std::memory_order_relaxed);
+        }
+        out << "]}";
+        first = false;
+    }
+    out << "}";
+}
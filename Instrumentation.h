@@ -0,0 +1,130 @@
+#ifndef TEXT_EDITOR_INSTRUMENTATION_H
+#define TEXT_EDITOR_INSTRUMENTATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include "LineArena.h"
+
+#define LATENCY_BUCKETS 40
+
+enum Operation {
+    OP_APPEND_TEXT,
+    OP_ADD_NEW_LINE,
+    OP_SAVE_TO_FILE,
+    OP_LOAD_FROM_FILE,
+    OP_PRINT_TEXT,
+    OP_INSERT_TEXT,
+    OP_FIND_TEXT,
+    OP_FIND_PATTERNS,
+    OP_REPLACE_ALL,
+    OP_APPLY_EDITS,
+    OP_DELETE_TEXT,
+    OP_UNDO,
+    OP_REDO,
+    OP_CUT_TEXT,
+    OP_PASTE_TEXT,
+    OP_COPY_TEXT,
+    OP_INSERT_WITH_REPLACE,
+    OP_ENCRYPT_TEXT,
+    OP_DECRYPT_TEXT,
+    OP_ENCRYPT_FILE,
+    OP_DECRYPT_FILE,
+    OP_RECOVER_KEY,
+    OP_PRINT_RANGE,
+    OP_WRITE_TEXT,
+    OP_DIFF,
+    OP_RELOAD_FROM_FILE,
+    OPERATION_COUNT
+};
+
+// Process-wide per-operation counters: calls, latency histogram with
+// power-of-two nanosecond buckets, payload bytes, and the number and bytes
+// of line buffer allocations. Updates are relaxed atomics, so operations running on
+// several threads can record concurrently.
+class Instrumentation {
+private:
+    struct Counters {
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> totalNs;
+        std::atomic<uint64_t> maxNs;
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> allocations;
+        std::atomic<uint64_t> allocatedBytes;
+        std::atomic<uint64_t> latency[LATENCY_BUCKETS];
+    };
+
+    static Counters counters[OPERATION_COUNT];
+
+    static uint64_t percentile(const Counters &counter, double fraction);
+
+public:
+    static const char *getName(Operation operation);
+
+    static void record(Operation operation, uint64_t ns, uint64_t bytes, uint64_t allocations,
+                       uint64_t allocatedBytes);
+    static void reset();
+
+    static void printText(std::ostream &out);
+    static void printJson(std::ostream &out);
+};
+
+// Records the enclosing scope as one call of an operation. Allocations are
+// the line buffers `arena` handed out while the scope was open, counted and
+// in bytes. Helpers
+// such as commit() add their bytes to the innermost timer of their thread
+// rather than reading the clock again.
+class OperationTimer {
+private:
+    static thread_local OperationTimer *active;
+
+    OperationTimer *outer;
+    Operation operation;
+    const LineArena &arena;
+    size_t allocationsBefore;
+    size_t allocatedBytesBefore;
+    uint64_t bytes;
+    std::chrono::steady_clock::time_point start;
+
+    static size_t allocationsOf(const LineArena &arena) {
+        return arena.getStats().blockAllocations + arena.getStats().largeAllocations;
+    }
+
+public:
+    OperationTimer(Operation op, const LineArena &lineArena)
+            : outer(active), operation(op), arena(lineArena), allocationsBefore(allocationsOf(lineArena)),
+              allocatedBytesBefore(lineArena.getStats().bytesAllocated), bytes(0),
+              start(std::chrono::steady_clock::now()) {
+        active = this;
+    }
+
+    ~OperationTimer() {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        Instrumentation::record(operation, ns, bytes, allocationsOf(arena) - allocationsBefore,
+                                arena.getStats().bytesAllocated - allocatedBytesBefore);
+        active = outer;
+    }
+
+    OperationTimer(const OperationTimer &) = delete;
+    OperationTimer &operator=(const OperationTimer &) = delete;
+
+    static void addBytes(uint64_t count) {
+        if (active) {
+            active->bytes += count;
+        }
+    }
+};
+
+// Building without TEXT_EDITOR_INSTRUMENTATION compiles the timers out.
+#ifdef TEXT_EDITOR_INSTRUMENTATION
+#define INSTRUMENT_OPERATION(operation) OperationTimer operationTimer(operation, arena)
+#define INSTRUMENT_BYTES(count) OperationTimer::addBytes(count)
+#else
+#define INSTRUMENT_OPERATION(operation) ((void) 0)
+#define INSTRUMENT_BYTES(count) ((void) 0)
+#endif
+
+#endif //TEXT_EDITOR_INSTRUMENTATION_H
@@ -0,0 +1,279 @@
+#include "KeyRecovery.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KEY_RECOVERY_X86 1
+#endif
+
+namespace {
+
+typedef void (*CountKernel)(const unsigned char *, size_t, uint64_t *);
+
+// Frequencies of a-z in English text, in percent.
+const double ENGLISH_FREQUENCIES[ALPHABET_SIZE] = {
+        8.167, 1.492, 2.782, 4.253, 12.702, 2.228, 2.015, 6.094, 6.966, 0.153, 0.772, 4.025, 2.406,
+        6.749, 7.507, 1.929, 0.095, 5.987, 6.327, 9.056, 2.758, 0.978, 2.360, 0.150, 1.974, 0.074};
+const double MIN_FREQUENCY = 0.01;
+
+// Four interleaved byte tables keep consecutive increments of the same
+// letter from waiting on each other.
+void scalarCount(const unsigned char *data, size_t len, uint64_t *counts) {
+    uint32_t tables[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        tables[0][data[i]]++;
+        tables[1][data[i + 1]]++;
+        tables[2][data[i + 2]]++;
+        tables[3][data[i + 3]]++;
+    }
+    for (; i < len; ++i) {
+        tables[0][data[i]]++;
+    }
+    for (size_t letter = 0; letter < ALPHABET_SIZE; ++letter) {
+        for (size_t t = 0; t < 4; ++t) {
+            counts[letter] += tables[t]['a' + letter] + tables[t]['A' + letter];
+        }
+    }
+}
+
+#ifdef KEY_RECOVERY_X86
+// Compares case-folded bytes against Count letters at once, accumulating in
+// per-lane byte counters that are summed with a SAD before they can wrap.
+// Letters are split over four passes so that counters and compare
+// results fit in the sixteen registers.
+template <unsigned First, unsigned Count>
+__attribute__((target("avx2")))
+void avx2CountLetters(const unsigned char *data, size_t vectors, uint64_t *counts) {
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    __m256i totals[Count];
+    for (unsigned k = 0; k < Count; ++k) {
+        totals[k] = _mm256_setzero_si256();
+    }
+    for (size_t v = 0; v < vectors; v += 255) {
+        size_t end = std::min(vectors, v + 255);
+        __m256i hits[Count];
+        for (unsigned k = 0; k < Count; ++k) {
+            hits[k] = _mm256_setzero_si256();
+        }
+        for (size_t i = v; i < end; ++i) {
+            __m256i folded = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data) + i),
+                                             caseBit);
+#pragma GCC unroll 16
+            for (unsigned k = 0; k < Count; ++k) {
+                hits[k] = _mm256_sub_epi8(hits[k], _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('a' + First + k)));
+            }
+        }
+        for (unsigned k = 0; k < Count; ++k) {
+            totals[k] = _mm256_add_epi64(totals[k], _mm256_sad_epu8(hits[k], _mm256_setzero_si256()));
+        }
+    }
+    for (unsigned k = 0; k < Count; ++k) {
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), totals[k]);
+        counts[First + k] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+}
+
+__attribute__((target("avx2")))
+void avx2Count(const unsigned char *data, size_t len, uint64_t *counts) {
+    // Blocks small enough to stay in L1 between the passes.
+    const size_t blockVectors = 256;
+    size_t vectors = len / 32;
+    for (size_t v = 0; v < vectors; v += blockVectors) {
+        size_t n = std::min(blockVectors, vectors - v);
+        avx2CountLetters<0, 7>(data + v * 32, n, counts);
+        avx2CountLetters<7, 7>(data + v * 32, n, counts);
+        avx2CountLetters<14, 6>(data + v * 32, n, counts);
+        avx2CountLetters<20, 6>(data + v * 32, n, counts);
+    }
+    scalarCount(data + vectors * 32, len - vectors * 32, counts);
+}
+#endif
+
+CountKernel selectKernel() {
+#ifdef KEY_RECOVERY_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2Count;
+    }
+#endif
+    return scalarCount;
+}
+
+size_t reverseBits(size_t value, unsigned bits) {
+    size_t reversed = 0;
+    for (unsigned b = 0; b < bits; ++b) {
+        reversed = (reversed << 1) | ((value >> b) & 1);
+    }
+    return reversed;
+}
+
+double confidenceOf(const std::vector<KeyScore> &ranking) {
+    return ranking[0].chiSquared > 0 ? ranking[1].chiSquared / ranking[0].chiSquared : ranking[1].chiSquared;
+}
+
+}
+
+LetterHistogram::LetterHistogram() {
+    std::fill(counts, counts + ALPHABET_SIZE, 0);
+}
+
+void LetterHistogram::add(const char *data, size_t len) {
+    static const CountKernel kernel = selectKernel();
+    kernel(reinterpret_cast<const unsigned char *>(data), len, counts);
+}
+
+void LetterHistogram::merge(const LetterHistogram &other) {
+    for (size_t letter = 0; letter < ALPHABET_SIZE; ++letter) {
+        counts[letter] += other.counts[letter];
+    }
+}
+
+uint64_t LetterHistogram::total() const {
+    uint64_t sum = 0;
+    for (uint64_t count : counts) {
+        sum += count;
+    }
+    return sum;
+}
+
+LetterModel::LetterModel() {
+    for (size_t letter = 0; letter < ALPHABET_SIZE; ++letter) {
+        frequencies[letter] = ENGLISH_FREQUENCIES[letter] / 100;
+    }
+}
+
+bool LetterModel::train(const LetterHistogram &sample) {
+    uint64_t total = sample.total();
+    if (total == 0) {
+        return false;
+    }
+    double sum = 0;
+    for (size_t letter = 0; letter < ALPHABET_SIZE; ++letter) {
+        frequencies[letter] = std::max(static_cast<double>(sample.counts[letter]) / total, MIN_FREQUENCY / 100);
+        sum += frequencies[letter];
+    }
+    for (double &frequency : frequencies) {
+        frequency /= sum;
+    }
+    return true;
+}
+
+std::vector<KeyScore> LetterModel::rank(const LetterHistogram &cipher) const {
+    double total = static_cast<double>(cipher.total());
+    std::vector<KeyScore> ranking;
+    for (int key = 0; key < ALPHABET_SIZE; ++key) {
+        double score = 0;
+        for (int letter = 0; letter < ALPHABET_SIZE; ++letter) {
+            double expected = total * frequencies[(letter - key + ALPHABET_SIZE) % ALPHABET_SIZE];
+            double difference = cipher.counts[letter] - expected;
+            score += expected > 0 ? difference * difference / expected : 0;
+        }
+        ranking.push_back({key, score});
+    }
+    std::stable_sort(ranking.begin(), ranking.end(), [](const KeyScore &a, const KeyScore &b) {
+        return a.chiSquared < b.chiSquared;
+    });
+    return ranking;
+}
+
+KeyRecovery::KeyRecovery(const LetterModel &letterModel, size_t threads) : model(letterModel) {
+    threadCount = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+KeyRecoveryResult KeyRecovery::run(size_t blocks, uint64_t totalBytes, bool sample,
+                                   const BlockCounter &count) const {
+    unsigned bits = 0;
+    while ((size_t(1) << bits) < blocks) {
+        ++bits;
+    }
+    KeyRecoveryResult result;
+    LetterHistogram &histogram = result.histogram;
+    result.bytesScanned = 0;
+    result.bytesTotal = totalBytes;
+    std::mutex mutex;
+    std::atomic<size_t> next(0);
+    std::atomic<bool> done(false);
+    auto work = [&]() {
+        size_t slot;
+        while (!done && (slot = next++) < (size_t(1) << bits)) {
+            size_t block = sample ? reverseBits(slot, bits) : slot;
+            if (block >= blocks) {
+                continue;
+            }
+            LetterHistogram counted;
+            size_t bytes = count(block, counted);
+            std::lock_guard<std::mutex> lock(mutex);
+            histogram.merge(counted);
+            result.bytesScanned += bytes;
+            if (sample && histogram.total() >= KEY_MIN_LETTERS &&
+                confidenceOf(model.rank(histogram)) >= KEY_CONFIDENCE_RATIO) {
+                done = true;
+            }
+        }
+    };
+    size_t workers = std::min(threadCount, std::max<size_t>(blocks, 1));
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < workers; ++t) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (std::thread &worker : pool) {
+        worker.join();
+    }
+    result.ranking = model.rank(histogram);
+    result.confidence = confidenceOf(result.ranking);
+    return result;
+}
+
+bool KeyRecovery::runFile(const char *path, bool sample, KeyRecoveryResult &result) const {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        std::cerr << "Error opening file for reading\n";
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    uint64_t size = info.st_size;
+    std::atomic<bool> failed(false);
+    result = run((size + KEY_SAMPLE_BLOCK_BYTES - 1) / KEY_SAMPLE_BLOCK_BYTES, size, sample,
+                 [&](size_t block, LetterHistogram &histogram) {
+        thread_local std::string buffer;
+        buffer.resize(KEY_SAMPLE_BLOCK_BYTES);
+        uint64_t offset = static_cast<uint64_t>(block) * KEY_SAMPLE_BLOCK_BYTES;
+        size_t wanted = std::min<uint64_t>(KEY_SAMPLE_BLOCK_BYTES, size - offset);
+        size_t done = 0;
+        while (done < wanted) {
+            ssize_t got = pread(fd, &buffer[done], wanted - done, offset + done);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                failed = true;
+                break;
+            }
+            done += got;
+        }
+        histogram.add(buffer.data(), done);
+        return done;
+    });
+    close(fd);
+    if (failed) {
+        std::cerr << "Error reading file\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef TEXT_EDITOR_KEYRECOVERY_H
+#define TEXT_EDITOR_KEYRECOVERY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#define ALPHABET_SIZE 26
+#define KEY_SAMPLE_BLOCK_BYTES (64 << 10)
+// A sampled run stops once it has seen this many letters and the runner-up
+// key scores at least KEY_CONFIDENCE_RATIO times worse than the best one.
+#define KEY_MIN_LETTERS 4096
+#define KEY_CONFIDENCE_RATIO 4.0
+
+// Counts of the ASCII letters in a text, case folded.
+struct LetterHistogram {
+    uint64_t counts[ALPHABET_SIZE];
+
+    LetterHistogram();
+
+    // Counts with SIMD compare-and-accumulate when the CPU has it.
+    void add(const char *data, size_t len);
+    void merge(const LetterHistogram &other);
+    uint64_t total() const;
+};
+
+struct KeyScore {
+    int key;
+    double chiSquared;
+};
+
+// Letter frequencies expected in the plaintext; English by default.
+class LetterModel {
+private:
+    double frequencies[ALPHABET_SIZE];
+
+public:
+    LetterModel();
+
+    // Uses the letter frequencies of a sample plaintext. Letters missing
+    // from the sample keep a small floor so no key scores infinite. Returns
+    // false and keeps the model if the sample has no letters.
+    bool train(const LetterHistogram &sample);
+
+    // Chi-squared of every key for ciphertext with these counts, best
+    // (lowest) first. The key is the shift the text was encrypted with.
+    std::vector<KeyScore> rank(const LetterHistogram &cipher) const;
+};
+
+struct KeyRecoveryResult {
+    std::vector<KeyScore> ranking;
+    uint64_t bytesScanned;
+    uint64_t bytesTotal;
+    LetterHistogram histogram;
+    // Runner-up chi-squared over the best one.
+    double confidence;
+};
+
+// Ranks the keys of a text split into blocks that are counted on worker
+// threads. Sampling visits the blocks in an order that spreads every prefix
+// evenly over the text (bit-reversed block numbers) and stops as soon as
+// the best key is clear; otherwise every block is counted in order.
+class KeyRecovery {
+public:
+    // Adds block `block` to `histogram` and returns its size in bytes.
+    typedef std::function<size_t(size_t block, LetterHistogram &histogram)> BlockCounter;
+
+private:
+    const LetterModel &model;
+    size_t threadCount;
+
+public:
+    KeyRecovery(const LetterModel &letterModel, size_t threads);
+
+    KeyRecoveryResult run(size_t blocks, uint64_t totalBytes, bool sample, const BlockCounter &count) const;
+
+    // Reads the file in KEY_SAMPLE_BLOCK_BYTES blocks. Reports the error and
+    // returns false if it cannot be read.
+    bool runFile(const char *path, bool sample, KeyRecoveryResult &result) const;
+};
+
+#endif //TEXT_EDITOR_KEYRECOVERY_H
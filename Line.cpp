@@ -0,0 +1,314 @@
+#include "Line.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static_assert(sizeof(Line) == 3 * sizeof(void *), "the character cache must share the inline text's word");
+
+size_t Line::capacity() const {
+    switch (storage) {
+        case BORROWED:
+            return 0;
+        case INLINE:
+            return INLINE_CAPACITY;
+        default:
+            return LineArena::capacityOf(block(), storage == LARGE) - LINE_HEADER_BYTES;
+    }
+}
+
+void Line::release() {
+    if (storage != INLINE) {
+        resetChars(CHARS_UNKNOWN);
+    }
+    releaseBlock();
+}
+
+void Line::releaseBlock() {
+    if (isOwned() && --sharers() == 0) {
+        LineArena::release(block(), storage == LARGE);
+    }
+}
+
+// Takes over other's text and leaves it an empty inline line.
+void Line::moveFrom(Line &other) {
+    length = other.length;
+    storage = other.storage;
+    if (storage == INLINE) {
+        std::memcpy(inlineText, other.inlineText, length + 1);
+        text = inlineText;
+    } else {
+        text = other.text;
+        chars.store(other.chars.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    other.text = other.inlineText;
+    other.length = 0;
+    other.inlineText[0] = '\0';
+    other.storage = INLINE;
+}
+
+Line::Line() : text(inlineText), length(0), storage(INLINE) {
+    inlineText[0] = '\0';
+}
+
+Line::Line(const Line &other) : Line() {
+    *this = other;
+}
+
+Line &Line::operator=(const Line &other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (other.isOwned()) {
+        other.sharers()++;
+    }
+    release();
+    length = other.length;
+    storage = other.storage;
+    if (storage == INLINE) {
+        text = inlineText;
+        std::memcpy(text, other.text, length + 1);
+    } else {
+        text = other.text;
+        // An index is rebuilt by the copy when it needs one.
+        uintptr_t state = other.chars.load(std::memory_order_acquire);
+        chars.store(state < CHARS_INDEXED ? state : CHARS_UNKNOWN, std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+Line Line::borrow(const char *data, size_t len) {
+    Line line;
+    line.text = const_cast<char *>(data);
+    line.length = len;
+    line.storage = BORROWED;
+    line.chars.store(CHARS_UNKNOWN, std::memory_order_relaxed);
+    return line;
+}
+
+Line::Line(Line &&other) noexcept {
+    moveFrom(other);
+}
+
+Line &Line::operator=(Line &&other) noexcept {
+    if (this != &other) {
+        release();
+        moveFrom(other);
+    }
+    return *this;
+}
+
+Line::~Line() {
+    release();
+}
+
+void Line::appendText(const char *str) {
+    replaceText(length, 0, str, std::strlen(str));
+}
+
+void Line::insertText(size_t pos, const char *str) {
+    if (pos > length) {
+        std::cerr << "Position out of bounds\n";
+        return;
+    }
+    replaceText(pos, 0, str, std::strlen(str));
+}
+
+void Line::deleteText(size_t pos, size_t len) {
+    if (pos >= length || pos + len > length) {
+        std::cerr << "Position and length out of bounds\n";
+        return;
+    }
+    replaceText(pos, len, "", 0);
+}
+
+void Line::insertWithReplace(size_t pos, const char *str) {
+    if (pos > length) {
+        std::cerr << "Position out of bounds\n";
+        return;
+    }
+    size_t strLength = std::strlen(str);
+    replaceText(pos, std::min(strLength, length - pos), str, strLength);
+}
+
+void Line::replaceText(size_t pos, size_t len, const char *str, size_t strLength, LineArena &arena) {
+    // Keeps the character cache when the edit cannot change what it says.
+    // Until it is stored back, `state` owns the index: inline text may take
+    // its place.
+    uintptr_t state = cachedChars();
+    Utf8Scan inserted = {0, true, true};
+    size_t removedChars = 0;
+    if (state != CHARS_UNKNOWN) {
+        inserted = scanUtf8(str, strLength);
+        if (state == CHARS_BYTES || (state == CHARS_ASCII && !inserted.ascii) ||
+            (state != CHARS_ASCII && (!inserted.valid || !isCharBoundary(pos) || !isCharBoundary(pos + len)))) {
+            resetChars(CHARS_UNKNOWN);
+            state = CHARS_UNKNOWN;
+        } else if (state >= CHARS_INDEXED) {
+            removedChars = countUtf8(text + pos, len);
+        }
+    }
+    size_t newLength = length - len + strLength;
+    size_t oldCapacity = capacity();
+    if (newLength < oldCapacity && !isShared()) {
+        std::memmove(text + pos + strLength, text + pos + len, length - pos - len + 1);
+        std::memcpy(text + pos, str, strLength);
+        length = newLength;
+    } else {
+        // Borrowed and shared text is copied at its exact size; owned text
+        // at least doubles.
+        char *newText;
+        Storage newStorage;
+        if (newLength < INLINE_CAPACITY) {
+            newText = inlineText;
+            newStorage = INLINE;
+        } else {
+            LineArena &target = isOwned() ? LineArena::ownerOf(block(), storage == LARGE) : arena;
+            bool exact = storage == BORROWED || isShared();
+            size_t wanted = exact ? newLength + 1 : std::max(newLength + 1, oldCapacity * 2);
+            bool large;
+            char *newBlock = target.allocate(wanted + LINE_HEADER_BYTES, large);
+            *reinterpret_cast<uint32_t *>(newBlock) = 1;
+            newText = newBlock + LINE_HEADER_BYTES;
+            newStorage = large ? LARGE : SLAB;
+        }
+        std::memcpy(newText, text, pos);
+        std::memcpy(newText + pos, str, strLength);
+        std::memcpy(newText + pos + strLength, text + pos + len, length - pos - len);
+        newText[newLength] = '\0';
+        releaseBlock();
+        text = newText;
+        length = newLength;
+        storage = newStorage;
+    }
+    if (storage == INLINE) {
+        if (state >= CHARS_INDEXED) {
+            delete reinterpret_cast<CharIndex *>(state);
+        }
+        return;
+    }
+    if (state >= CHARS_INDEXED) {
+        reindex(*reinterpret_cast<CharIndex *>(state), pos, len, strLength, removedChars, inserted.chars);
+    } else if (state == CHARS_MULTIBYTE && length >= UTF8_INDEX_MIN_BYTES) {
+        state = CHARS_UNKNOWN;
+    }
+    chars.store(state, std::memory_order_relaxed);
+}
+
+void Line::resetChars(uintptr_t state) {
+    uintptr_t old = chars.exchange(state, std::memory_order_acq_rel);
+    if (old >= CHARS_INDEXED) {
+        delete reinterpret_cast<CharIndex *>(old);
+    }
+}
+
+uintptr_t Line::charState() const {
+    if (storage == INLINE) {
+        Utf8Scan scan = scanUtf8(text, length);
+        return scan.ascii ? CHARS_ASCII : scan.valid ? CHARS_MULTIBYTE : CHARS_BYTES;
+    }
+    uintptr_t state = chars.load(std::memory_order_acquire);
+    if (state != CHARS_UNKNOWN) {
+        return state;
+    }
+    Utf8Scan scan = scanUtf8(text, length);
+    state = scan.ascii ? CHARS_ASCII : scan.valid ? CHARS_MULTIBYTE : CHARS_BYTES;
+    CharIndex *index = nullptr;
+    if (state == CHARS_MULTIBYTE && length >= UTF8_INDEX_MIN_BYTES) {
+        std::vector<size_t> offsets;
+        offsets.reserve(scan.chars / UTF8_INDEX_STRIDE + 1);
+        scanUtf8(text, length, &offsets);
+        index = new CharIndex();
+        index->chars = scan.chars;
+        index->samples.reserve(offsets.size());
+        for (size_t k = 0; k < offsets.size(); ++k) {
+            index->samples.push_back({offsets[k], k * UTF8_INDEX_STRIDE});
+        }
+        state = reinterpret_cast<uintptr_t>(index);
+    }
+    // Another reader may have published its scan first; both describe the
+    // same text.
+    uintptr_t expected = CHARS_UNKNOWN;
+    if (!chars.compare_exchange_strong(expected, state, std::memory_order_acq_rel)) {
+        delete index;
+        return expected;
+    }
+    return state;
+}
+
+void Line::reindex(CharIndex &index, size_t pos, size_t removed, size_t inserted, size_t removedChars,
+                   size_t insertedChars) const {
+    std::vector<CharSample> &samples = index.samples;
+    // A sample at pos still starts the same column; those inside the
+    // replaced bytes go and those after them move.
+    auto first = std::upper_bound(samples.begin(), samples.end(), pos, [](size_t value, const CharSample &s) {
+        return value < s.byte;
+    });
+    auto last = first;
+    while (last != samples.end() && last->byte < pos + removed) {
+        ++last;
+    }
+    first = samples.erase(first, last);
+    for (auto it = first; it != samples.end(); ++it) {
+        it->byte += inserted - removed;
+        it->column += insertedChars - removedChars;
+    }
+    index.chars += insertedChars - removedChars;
+
+    size_t before = first - samples.begin() - 1;
+    size_t from = samples[before].byte;
+    size_t to = before + 1 < samples.size() ? samples[before + 1].byte : length;
+    std::vector<size_t> offsets;
+    scanUtf8(text + from, to - from, &offsets);
+    std::vector<CharSample> added;
+    for (size_t k = 1; k < offsets.size(); ++k) {
+        added.push_back({from + offsets[k], samples[before].column + k * UTF8_INDEX_STRIDE});
+    }
+    samples.insert(samples.begin() + before + 1, added.begin(), added.end());
+}
+
+size_t Line::getCharCount() const {
+    uintptr_t state = charState();
+    if (state == CHARS_ASCII || state == CHARS_BYTES) {
+        return length;
+    }
+    if (state == CHARS_MULTIBYTE) {
+        return countUtf8(text, length);
+    }
+    return reinterpret_cast<const CharIndex *>(state)->chars;
+}
+
+size_t Line::byteOffsetOf(size_t column) const {
+    uintptr_t state = charState();
+    if (state == CHARS_ASCII || state == CHARS_BYTES) {
+        return column;
+    }
+    if (state == CHARS_MULTIBYTE) {
+        return advanceUtf8(text, length, column);
+    }
+    const CharIndex *index = reinterpret_cast<const CharIndex *>(state);
+    if (column >= index->chars) {
+        return length;
+    }
+    const CharSample &sample = *(std::upper_bound(index->samples.begin(), index->samples.end(), column,
+                                                  [](size_t value, const CharSample &s) {
+                                                      return value < s.column;
+                                                  }) - 1);
+    return sample.byte + advanceUtf8(text + sample.byte, length - sample.byte, column - sample.column);
+}
+
+size_t Line::columnOf(size_t pos) const {
+    uintptr_t state = charState();
+    if (state == CHARS_ASCII || state == CHARS_BYTES) {
+        return pos;
+    }
+    if (state == CHARS_MULTIBYTE) {
+        return countUtf8(text, pos);
+    }
+    const CharIndex *index = reinterpret_cast<const CharIndex *>(state);
+    const CharSample &sample = *(std::upper_bound(index->samples.begin(), index->samples.end(), pos,
+                                                  [](size_t value, const CharSample &s) {
+                                                      return value < s.byte;
+                                                  }) - 1);
+    return sample.column + countUtf8(text + sample.byte, pos - sample.byte);
+}
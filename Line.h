@@ -0,0 +1,167 @@
+#ifndef TEXT_EDITOR_LINE_H
+#define TEXT_EDITOR_LINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "LineArena.h"
+#include "Rope.h"
+#include "Utf8.h"
+
+#define INITIAL_CAPACITY 100
+#define INLINE_CAPACITY 7
+#define LINE_HEADER_BYTES sizeof(uint32_t)
+
+// A line keeps short text inline, longer text in a LineArena block, or
+// borrows `length` bytes from a mapped file. Borrowed text is not
+// NUL-terminated, so readers must always pair getText() with
+// getTextLength(). The first edit copies borrowed bytes into owned storage,
+// and owned buffers grow geometrically.
+// Arena blocks start with a count of the lines sharing them: copying a line
+// only bumps the count, and a shared block is copied by the first edit made
+// through any of its lines. The count is not atomic, so lines sharing a
+// block must be copied and destroyed on one thread.
+// Columns count code points of valid UTF-8 and bytes otherwise. Lines that
+// are not inline cache what their text is in the word inline text uses;
+// long multi-byte lines keep a CharIndex there, which edits update as long
+// as they insert valid UTF-8 between characters.
+class Line {
+private:
+    enum Storage : unsigned char {
+        BORROWED,
+        INLINE,
+        SLAB,
+        LARGE
+    };
+
+    // Values of the character cache below CHARS_INDEXED; above it the cache
+    // points to a CharIndex.
+    enum : uintptr_t {
+        CHARS_UNKNOWN,
+        CHARS_ASCII,
+        CHARS_BYTES,
+        CHARS_MULTIBYTE,
+        CHARS_INDEXED
+    };
+
+    struct CharSample {
+        size_t byte;
+        size_t column;
+    };
+
+    // Samples start at byte 0 and lie about UTF8_INDEX_STRIDE characters
+    // apart, so a lookup is a binary search and a short scan.
+    struct CharIndex {
+        size_t chars;
+        std::vector<CharSample> samples;
+    };
+
+    char *text;
+    size_t length : 56;
+    Storage storage : 8;
+    union {
+        char inlineText[INLINE_CAPACITY];
+        mutable std::atomic<uintptr_t> chars;
+    };
+
+    bool isOwned() const {
+        return storage == SLAB || storage == LARGE;
+    }
+
+    char *block() const {
+        return text - LINE_HEADER_BYTES;
+    }
+
+    uint32_t &sharers() const {
+        return *reinterpret_cast<uint32_t *>(block());
+    }
+
+    size_t capacity() const;
+    void release();
+    // Drops the reference to the text's block but not the cache.
+    void releaseBlock();
+    void moveFrom(Line &other);
+
+    // The cached state, or CHARS_UNKNOWN for inline lines.
+    uintptr_t cachedChars() const {
+        return storage == INLINE ? CHARS_UNKNOWN : chars.load(std::memory_order_acquire);
+    }
+
+    // Replaces the cache of a line that is not inline, freeing its index.
+    void resetChars(uintptr_t state);
+
+    // The state of the line, scanning it first if it is not cached.
+    uintptr_t charState() const;
+
+    // Moves the samples after an edit that replaced `removed` bytes at `pos`
+    // with `inserted` bytes, and samples the stretch around it again.
+    void reindex(CharIndex &index, size_t pos, size_t removed, size_t inserted, size_t removedChars,
+                 size_t insertedChars) const;
+
+public:
+    Line();
+    Line(const Line &other);
+    Line &operator=(const Line &other);
+    Line(Line &&other) noexcept;
+    Line &operator=(Line &&other) noexcept;
+    ~Line();
+
+    static Line borrow(const char *data, size_t len);
+
+    void appendText(const char *str);
+    void insertText(size_t pos, const char *str);
+    void deleteText(size_t pos, size_t len);
+    void insertWithReplace(size_t pos, const char *str);
+
+    // Replaces `len` bytes at `pos` with `strLength` bytes of `str`. The
+    // caller is responsible for bounds checks. A line that has to move to a
+    // new block allocates it from `arena` unless it already lives in one.
+    void replaceText(size_t pos, size_t len, const char *str, size_t strLength,
+                     LineArena &arena = LineArena::defaultArena());
+
+    const char* getText() const {
+        return text;
+    }
+
+    size_t getTextLength() const {
+        return length;
+    }
+
+    bool isBorrowed() const {
+        return storage == BORROWED;
+    }
+
+    bool isInline() const {
+        return storage == INLINE;
+    }
+
+    // True if another line shares this line's buffer.
+    bool isShared() const {
+        return isOwned() && sharers() > 1;
+    }
+
+    size_t getCharCount() const;
+
+    // Byte offset of `column`, which must not exceed getCharCount().
+    size_t byteOffsetOf(size_t column) const;
+
+    // Column of the character that byte `pos` starts.
+    size_t columnOf(size_t pos) const;
+
+    // False if byte `pos` lies inside a multi-byte character.
+    bool isCharBoundary(size_t pos) const {
+        return pos >= length || !isUtf8Continuation(text[pos]) || charState() == CHARS_BYTES;
+    }
+};
+
+// Lines weigh what they take in a saved file, newline included, so prefix
+// sums over a Rope<Line> are byte offsets.
+template <>
+struct RopeWeight<Line> {
+    static size_t of(const Line &line) {
+        return line.getTextLength() + 1;
+    }
+};
+
+#endif //TEXT_EDITOR_LINE_H
@@ -0,0 +1,138 @@
+#include "LineArena.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+template <typename Header>
+Header *slabOf(const char *block) {
+    return reinterpret_cast<Header *>(reinterpret_cast<uintptr_t>(block) & ~uintptr_t(ARENA_SLAB_SIZE - 1));
+}
+
+template <typename Header>
+Header *largeOf(const char *block) {
+    return reinterpret_cast<Header *>(const_cast<char *>(block)) - 1;
+}
+
+}
+
+LineArena::LineArena() : stats() {
+    for (size_t i = 0; i < ARENA_CLASS_COUNT; ++i) {
+        freeLists[i] = nullptr;
+        cursor[i] = nullptr;
+        slabEnd[i] = nullptr;
+    }
+}
+
+LineArena::~LineArena() {
+    for (void *slab : slabs) {
+        std::free(slab);
+    }
+}
+
+size_t LineArena::classOf(size_t size) {
+    if (size <= 128) {
+        return size <= ARENA_MIN_BLOCK ? 0 : (size - 1) / 16;
+    }
+    size_t power = 7;
+    while ((size_t(2) << power) < size) {
+        ++power;
+    }
+    size_t step = size_t(1) << (power - 2);
+    return 8 + (power - 7) * 4 + (size - 1 - (size_t(1) << power)) / step;
+}
+
+size_t LineArena::blockSizeOf(size_t sizeClass) {
+    if (sizeClass < 8) {
+        return 16 * (sizeClass + 1);
+    }
+    size_t power = 7 + (sizeClass - 8) / 4;
+    return (size_t(1) << power) + ((sizeClass - 8) % 4 + 1) * (size_t(1) << (power - 2));
+}
+
+char *LineArena::allocateBlock(size_t sizeClass) {
+    size_t blockSize = blockSizeOf(sizeClass);
+    if (freeLists[sizeClass]) {
+        FreeBlock *block = freeLists[sizeClass];
+        freeLists[sizeClass] = block->next;
+        return reinterpret_cast<char *>(block);
+    }
+    if (cursor[sizeClass] == slabEnd[sizeClass]) {
+        void *slab = std::aligned_alloc(ARENA_SLAB_SIZE, ARENA_SLAB_SIZE);
+        if (!slab) {
+            throw std::bad_alloc();
+        }
+        slabs.push_back(slab);
+        SlabHeader *header = static_cast<SlabHeader *>(slab);
+        header->owner = this;
+        header->blockSize = blockSize;
+        char *first = static_cast<char *>(slab) + sizeof(SlabHeader);
+        cursor[sizeClass] = first;
+        slabEnd[sizeClass] = first + (ARENA_SLAB_SIZE - sizeof(SlabHeader)) / blockSize * blockSize;
+        stats.slabs++;
+        stats.bytesReserved += ARENA_SLAB_SIZE;
+    }
+    char *block = cursor[sizeClass];
+    cursor[sizeClass] += blockSize;
+    return block;
+}
+
+char *LineArena::allocate(size_t size, bool &large) {
+    large = size > ARENA_MAX_BLOCK;
+    if (large) {
+        LargeHeader *header = static_cast<LargeHeader *>(std::malloc(sizeof(LargeHeader) + size));
+        if (!header) {
+            throw std::bad_alloc();
+        }
+        header->owner = this;
+        header->capacity = size;
+        stats.largeAllocations++;
+        stats.bytesInUse += size;
+        stats.bytesReserved += sizeof(LargeHeader) + size;
+        stats.bytesAllocated += size;
+        return reinterpret_cast<char *>(header + 1);
+    }
+    size_t sizeClass = classOf(size);
+    stats.blockAllocations++;
+    stats.bytesInUse += blockSizeOf(sizeClass);
+    stats.bytesAllocated += blockSizeOf(sizeClass);
+    return allocateBlock(sizeClass);
+}
+
+void LineArena::releaseBlock(char *block, size_t blockSize) {
+    FreeBlock *freed = reinterpret_cast<FreeBlock *>(block);
+    size_t sizeClass = classOf(blockSize);
+    freed->next = freeLists[sizeClass];
+    freeLists[sizeClass] = freed;
+    stats.releases++;
+    stats.bytesInUse -= blockSize;
+}
+
+size_t LineArena::capacityOf(const char *block, bool large) {
+    return large ? largeOf<LargeHeader>(block)->capacity : slabOf<SlabHeader>(block)->blockSize;
+}
+
+LineArena &LineArena::ownerOf(const char *block, bool large) {
+    return large ? *largeOf<LargeHeader>(block)->owner : *slabOf<SlabHeader>(block)->owner;
+}
+
+void LineArena::release(char *block, bool large) {
+    if (large) {
+        LargeHeader *header = largeOf<LargeHeader>(block);
+        ArenaStats &stats = header->owner->stats;
+        stats.releases++;
+        stats.bytesInUse -= header->capacity;
+        stats.bytesReserved -= sizeof(LargeHeader) + header->capacity;
+        std::free(header);
+        return;
+    }
+    SlabHeader *header = slabOf<SlabHeader>(block);
+    header->owner->releaseBlock(block, header->blockSize);
+}
+
+LineArena &LineArena::defaultArena() {
+    static LineArena arena;
+    return arena;
+}
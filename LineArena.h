@@ -0,0 +1,80 @@
+#ifndef TEXT_EDITOR_LINEARENA_H
+#define TEXT_EDITOR_LINEARENA_H
+
+#include <cstddef>
+#include <vector>
+
+#define ARENA_SLAB_SIZE (64 << 10)
+#define ARENA_MIN_BLOCK 16
+#define ARENA_MAX_BLOCK 4096
+#define ARENA_CLASS_COUNT 28
+
+struct ArenaStats {
+    size_t blockAllocations;
+    size_t largeAllocations;
+    size_t releases;
+    size_t slabs;
+    size_t bytesInUse;
+    size_t bytesReserved;
+    // Every byte ever handed out, so differences measure allocation volume.
+    size_t bytesAllocated;
+};
+
+// Slab allocator for line buffers. Requests up to ARENA_MAX_BLOCK bytes are
+// rounded up to a size class (steps of 16 bytes up to 128, then four steps
+// per power of two) and carved from 64 KiB slabs dedicated to that class,
+// with a free list per class; larger buffers come from the heap.
+// Slabs are aligned to their size so a block finds its slab header, and
+// through it its arena and size, from its address alone. Not thread-safe.
+class LineArena {
+private:
+    struct SlabHeader {
+        LineArena *owner;
+        size_t blockSize;
+    };
+
+    struct LargeHeader {
+        LineArena *owner;
+        size_t capacity;
+    };
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    std::vector<void *> slabs;
+    FreeBlock *freeLists[ARENA_CLASS_COUNT];
+    char *cursor[ARENA_CLASS_COUNT];
+    char *slabEnd[ARENA_CLASS_COUNT];
+    ArenaStats stats;
+
+    static size_t classOf(size_t size);
+    static size_t blockSizeOf(size_t sizeClass);
+    char *allocateBlock(size_t sizeClass);
+    void releaseBlock(char *block, size_t blockSize);
+
+public:
+    LineArena();
+    ~LineArena();
+
+    LineArena(const LineArena &) = delete;
+    LineArena &operator=(const LineArena &) = delete;
+
+    // Returns a block of at least `size` bytes; `large` tells the caller how
+    // the block has to be released.
+    char *allocate(size_t size, bool &large);
+
+    // Capacity and owning arena of a block returned by allocate().
+    static size_t capacityOf(const char *block, bool large);
+    static LineArena &ownerOf(const char *block, bool large);
+    static void release(char *block, bool large);
+
+    const ArenaStats &getStats() const {
+        return stats;
+    }
+
+    // Used by lines that are edited outside of a TextStorage.
+    static LineArena &defaultArena();
+};
+
+#endif //TEXT_EDITOR_LINEARENA_H
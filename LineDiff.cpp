@@ -0,0 +1,467 @@
+#include "LineDiff.h"
+#include "LinePool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+bool sameText(const Line &a, const Line &b) {
+    size_t length = a.getTextLength();
+    return length == b.getTextLength() &&
+           (a.getText() == b.getText() || std::memcmp(a.getText(), b.getText(), length) == 0);
+}
+
+// Linear space Myers on line hashes: marks the entries of either side that
+// are not part of the common subsequence.
+class MyersDiff {
+private:
+    const std::vector<uint64_t> &a;
+    const std::vector<uint64_t> &b;
+    std::vector<char> &removed;
+    std::vector<char> &added;
+    // Furthest x reached on each diagonal x - y, searching forward and
+    // backward.
+    std::vector<ptrdiff_t> forwardReach;
+    std::vector<ptrdiff_t> backwardReach;
+    ptrdiff_t *forward;
+    ptrdiff_t *backward;
+    ptrdiff_t costLimit;
+    bool anchored;
+
+public:
+    struct Range {
+        ptrdiff_t aLo;
+        ptrdiff_t aHi;
+        ptrdiff_t bLo;
+        ptrdiff_t bHi;
+    };
+
+    // Ranges that hit the cost limit, left unmarked for anchoring.
+    std::vector<Range> unresolved;
+
+private:
+    bool split(const Range &range, ptrdiff_t &x, ptrdiff_t &y);
+
+public:
+    // With `anchor` set, ranges that hit the cost limit go to `unresolved`
+    // instead of being split by the furthest reaching path.
+    MyersDiff(const std::vector<uint64_t> &oldHashes, const std::vector<uint64_t> &newHashes,
+              std::vector<char> &oldRemoved, std::vector<char> &newAdded, bool anchor)
+            : a(oldHashes), b(newHashes), removed(oldRemoved), added(newAdded), anchored(anchor) {
+        size_t diagonals = a.size() + b.size() + 3;
+        forwardReach.resize(diagonals);
+        backwardReach.resize(diagonals);
+        forward = forwardReach.data() + b.size() + 1;
+        backward = backwardReach.data() + b.size() + 1;
+        costLimit = std::max<ptrdiff_t>(DIFF_MIN_COST_LIMIT, static_cast<ptrdiff_t>(std::sqrt(diagonals)));
+    }
+
+    void run(const Range &all);
+};
+
+// Finds where the forward and backward searches meet, or past the cost
+// limit the furthest point either of them reached and returns false.
+bool MyersDiff::split(const Range &range, ptrdiff_t &x, ptrdiff_t &y) {
+    ptrdiff_t minDiagonal = range.aLo - range.bHi;
+    ptrdiff_t maxDiagonal = range.aHi - range.bLo;
+    ptrdiff_t forwardMid = range.aLo - range.bLo;
+    ptrdiff_t backwardMid = range.aHi - range.bHi;
+    bool odd = (forwardMid - backwardMid) & 1;
+    ptrdiff_t forwardMin = forwardMid, forwardMax = forwardMid;
+    ptrdiff_t backwardMin = backwardMid, backwardMax = backwardMid;
+    forward[forwardMid] = range.aLo;
+    backward[backwardMid] = range.aHi;
+    for (ptrdiff_t cost = 1;; ++cost) {
+        if (forwardMin > minDiagonal) {
+            forward[--forwardMin - 1] = -1;
+        } else {
+            ++forwardMin;
+        }
+        if (forwardMax < maxDiagonal) {
+            forward[++forwardMax + 1] = -1;
+        } else {
+            --forwardMax;
+        }
+        for (ptrdiff_t d = forwardMax; d >= forwardMin; d -= 2) {
+            ptrdiff_t i = forward[d - 1] >= forward[d + 1] ? forward[d - 1] + 1 : forward[d + 1];
+            ptrdiff_t j = i - d;
+            while (i < range.aHi && j < range.bHi && a[i] == b[j]) {
+                ++i;
+                ++j;
+            }
+            forward[d] = i;
+            if (odd && backwardMin <= d && d <= backwardMax && backward[d] <= i) {
+                x = i;
+                y = j;
+                return true;
+            }
+        }
+
+        if (backwardMin > minDiagonal) {
+            backward[--backwardMin - 1] = PTRDIFF_MAX;
+        } else {
+            ++backwardMin;
+        }
+        if (backwardMax < maxDiagonal) {
+            backward[++backwardMax + 1] = PTRDIFF_MAX;
+        } else {
+            --backwardMax;
+        }
+        for (ptrdiff_t d = backwardMax; d >= backwardMin; d -= 2) {
+            ptrdiff_t i = backward[d - 1] < backward[d + 1] ? backward[d - 1] : backward[d + 1] - 1;
+            ptrdiff_t j = i - d;
+            while (i > range.aLo && j > range.bLo && a[i - 1] == b[j - 1]) {
+                --i;
+                --j;
+            }
+            backward[d] = i;
+            if (!odd && forwardMin <= d && d <= forwardMax && i <= forward[d]) {
+                x = i;
+                y = j;
+                return true;
+            }
+        }
+
+        if (cost < costLimit) {
+            continue;
+        }
+        ptrdiff_t forwardBest = -1, forwardX = 0;
+        for (ptrdiff_t d = forwardMax; d >= forwardMin; d -= 2) {
+            ptrdiff_t i = std::min(forward[d], range.aHi);
+            ptrdiff_t j = i - d;
+            if (range.bHi < j) {
+                i = range.bHi + d;
+                j = range.bHi;
+            }
+            if (forwardBest < i + j) {
+                forwardBest = i + j;
+                forwardX = i;
+            }
+        }
+        ptrdiff_t backwardBest = PTRDIFF_MAX, backwardX = 0;
+        for (ptrdiff_t d = backwardMax; d >= backwardMin; d -= 2) {
+            ptrdiff_t i = std::max(range.aLo, backward[d]);
+            ptrdiff_t j = i - d;
+            if (j < range.bLo) {
+                i = range.bLo + d;
+                j = range.bLo;
+            }
+            if (i + j < backwardBest) {
+                backwardBest = i + j;
+                backwardX = i;
+            }
+        }
+        if ((range.aHi + range.bHi) - backwardBest < forwardBest - (range.aLo + range.bLo)) {
+            x = forwardX;
+            y = forwardBest - forwardX;
+        } else {
+            x = backwardX;
+            y = backwardBest - backwardX;
+        }
+        return false;
+    }
+}
+
+void MyersDiff::run(const Range &all) {
+    std::vector<Range> pending;
+    pending.push_back(all);
+    while (!pending.empty()) {
+        Range range = pending.back();
+        pending.pop_back();
+        while (range.aLo < range.aHi && range.bLo < range.bHi && a[range.aLo] == b[range.bLo]) {
+            ++range.aLo;
+            ++range.bLo;
+        }
+        while (range.aLo < range.aHi && range.bLo < range.bHi && a[range.aHi - 1] == b[range.bHi - 1]) {
+            --range.aHi;
+            --range.bHi;
+        }
+        ptrdiff_t x = range.aLo, y = range.bLo;
+        if (range.aLo < range.aHi && range.bLo < range.bHi && !split(range, x, y) && anchored) {
+            unresolved.push_back(range);
+            continue;
+        }
+        bool progress = (x != range.aLo || y != range.bLo) && (x != range.aHi || y != range.bHi);
+        if (!progress) {
+            std::fill(removed.begin() + range.aLo, removed.begin() + range.aHi, 1);
+            std::fill(added.begin() + range.bLo, added.begin() + range.bHi, 1);
+            continue;
+        }
+        pending.push_back({x, range.aHi, y, range.bHi});
+        pending.push_back({range.aLo, x, range.bLo, y});
+    }
+}
+
+void diffRange(const std::vector<uint64_t> &oldHashes, const std::vector<uint64_t> &newHashes,
+               const std::vector<size_t> &oldAt, const std::vector<size_t> &newAt, std::vector<char> &removed,
+               std::vector<char> &added, bool anchored);
+
+// Matches the lines of `range` that occur once on each side, keeping the
+// longest run of them in order, and diffs the gaps between them on their
+// own. Patience diff, in short: it stays near linear where Myers would not,
+// as in a shuffled file, and the gaps mostly filter down to nothing.
+void anchorRange(const std::vector<uint64_t> &oldHashes, const std::vector<uint64_t> &newHashes,
+                 const std::vector<size_t> &oldAt, const std::vector<size_t> &newAt,
+                 const MyersDiff::Range &range, std::vector<char> &removed, std::vector<char> &added) {
+    std::vector<std::pair<uint64_t, size_t>> oldSorted, newSorted;
+    for (ptrdiff_t i = range.aLo; i < range.aHi; ++i) {
+        oldSorted.push_back({oldHashes[oldAt[i]], i});
+    }
+    for (ptrdiff_t i = range.bLo; i < range.bHi; ++i) {
+        newSorted.push_back({newHashes[newAt[i]], i});
+    }
+    std::sort(oldSorted.begin(), oldSorted.end());
+    std::sort(newSorted.begin(), newSorted.end());
+    std::vector<std::pair<size_t, size_t>> unique;
+    size_t i = 0, j = 0;
+    while (i < oldSorted.size() && j < newSorted.size()) {
+        uint64_t hash = oldSorted[i].first;
+        if (hash < newSorted[j].first) {
+            ++i;
+            continue;
+        }
+        if (hash > newSorted[j].first) {
+            ++j;
+            continue;
+        }
+        size_t oldRun = i, newRun = j;
+        while (i < oldSorted.size() && oldSorted[i].first == hash) {
+            ++i;
+        }
+        while (j < newSorted.size() && newSorted[j].first == hash) {
+            ++j;
+        }
+        if (i - oldRun == 1 && j - newRun == 1) {
+            unique.push_back({oldSorted[oldRun].second, newSorted[newRun].second});
+        }
+    }
+    std::sort(unique.begin(), unique.end());
+
+    // Longest increasing run of new positions, by patience sorting.
+    std::vector<size_t> tails, previous(unique.size());
+    for (size_t k = 0; k < unique.size(); ++k) {
+        size_t pile = std::lower_bound(tails.begin(), tails.end(), unique[k].second,
+                                       [&unique](size_t tail, size_t value) {
+                                           return unique[tail].second < value;
+                                       }) - tails.begin();
+        previous[k] = pile ? tails[pile - 1] : SIZE_MAX;
+        if (pile == tails.size()) {
+            tails.push_back(k);
+        } else {
+            tails[pile] = k;
+        }
+    }
+    std::vector<std::pair<size_t, size_t>> anchors;
+    for (size_t k = tails.empty() ? SIZE_MAX : tails.back(); k != SIZE_MAX; k = previous[k]) {
+        anchors.push_back(unique[k]);
+    }
+    std::reverse(anchors.begin(), anchors.end());
+    anchors.push_back({range.aHi, range.bHi});
+
+    bool anchoredGaps = anchors.size() > 1;
+    size_t oldFrom = range.aLo, newFrom = range.bLo;
+    for (const std::pair<size_t, size_t> &anchor : anchors) {
+        std::vector<size_t> oldGap(oldAt.begin() + oldFrom, oldAt.begin() + anchor.first);
+        std::vector<size_t> newGap(newAt.begin() + newFrom, newAt.begin() + anchor.second);
+        diffRange(oldHashes, newHashes, oldGap, newGap, removed, added, anchoredGaps);
+        oldFrom = anchor.first + 1;
+        newFrom = anchor.second + 1;
+    }
+}
+
+// Marks which of the lines at `oldAt` and `newAt` are removed and added.
+// A line missing from the other side can only be one of those, so the
+// search runs on the rest. Presence is kept per hash bucket: a shared
+// bucket only keeps a line in the search.
+void diffRange(const std::vector<uint64_t> &oldHashes, const std::vector<uint64_t> &newHashes,
+               const std::vector<size_t> &oldAt, const std::vector<size_t> &newAt, std::vector<char> &removed,
+               std::vector<char> &added, bool anchored) {
+    size_t buckets = 1 << 6;
+    while (buckets < (oldAt.size() + newAt.size()) * DIFF_BUCKETS_PER_LINE && buckets < DIFF_MAX_BUCKETS) {
+        buckets <<= 1;
+    }
+    std::vector<unsigned char> present(buckets, 0);
+    for (size_t at : oldAt) {
+        present[oldHashes[at] & (buckets - 1)] |= 1;
+    }
+    for (size_t at : newAt) {
+        present[newHashes[at] & (buckets - 1)] |= 2;
+    }
+    std::vector<uint64_t> oldKept, newKept;
+    std::vector<size_t> oldKeptAt, newKeptAt;
+    for (size_t at : oldAt) {
+        if (present[oldHashes[at] & (buckets - 1)] & 2) {
+            oldKept.push_back(oldHashes[at]);
+            oldKeptAt.push_back(at);
+        } else {
+            removed[at] = 1;
+        }
+    }
+    for (size_t at : newAt) {
+        if (present[newHashes[at] & (buckets - 1)] & 1) {
+            newKept.push_back(newHashes[at]);
+            newKeptAt.push_back(at);
+        } else {
+            added[at] = 1;
+        }
+    }
+
+    std::vector<char> keptRemoved(oldKept.size(), 0), keptAdded(newKept.size(), 0);
+    MyersDiff myers(oldKept, newKept, keptRemoved, keptAdded, anchored);
+    myers.run({0, static_cast<ptrdiff_t>(oldKept.size()), 0, static_cast<ptrdiff_t>(newKept.size())});
+    for (size_t k = 0; k < oldKept.size(); ++k) {
+        removed[oldKeptAt[k]] |= keptRemoved[k];
+    }
+    for (size_t k = 0; k < newKept.size(); ++k) {
+        added[newKeptAt[k]] |= keptAdded[k];
+    }
+    for (const MyersDiff::Range &range : myers.unresolved) {
+        anchorRange(oldHashes, newHashes, oldKeptAt, newKeptAt, range, removed, added);
+    }
+}
+
+void appendRange(std::string &out, size_t first, size_t count) {
+    out += std::to_string(count ? first + 1 : first);
+    if (count != 1) {
+        out += ',';
+        out += std::to_string(count);
+    }
+}
+
+void appendLines(std::string &out, char prefix, Rope<Line>::const_iterator &it, size_t count) {
+    for (size_t i = 0; i < count; ++i, ++it) {
+        out += prefix;
+        out.append(it->getText(), it->getTextLength());
+        out += '\n';
+    }
+}
+
+}
+
+std::vector<DiffChange> diffLines(const Rope<Line> &oldLines, const Rope<Line> &newLines) {
+    std::vector<const Line *> oldText, newText;
+    oldText.reserve(oldLines.size());
+    newText.reserve(newLines.size());
+    for (const Line &line : oldLines) {
+        oldText.push_back(&line);
+    }
+    for (const Line &line : newLines) {
+        newText.push_back(&line);
+    }
+    size_t prefix = 0;
+    while (prefix < oldText.size() && prefix < newText.size() && sameText(*oldText[prefix], *newText[prefix])) {
+        ++prefix;
+    }
+    size_t oldEnd = oldText.size(), newEnd = newText.size();
+    while (oldEnd > prefix && newEnd > prefix && sameText(*oldText[oldEnd - 1], *newText[newEnd - 1])) {
+        --oldEnd;
+        --newEnd;
+    }
+    size_t oldCount = oldEnd - prefix, newCount = newEnd - prefix;
+
+    std::vector<uint64_t> oldHashes(oldCount), newHashes(newCount);
+    for (size_t i = 0; i < oldCount; ++i) {
+        oldHashes[i] = hashLineText(oldText[prefix + i]->getText(), oldText[prefix + i]->getTextLength());
+    }
+    for (size_t i = 0; i < newCount; ++i) {
+        newHashes[i] = hashLineText(newText[prefix + i]->getText(), newText[prefix + i]->getTextLength());
+    }
+
+    std::vector<char> removed(oldCount, 0), added(newCount, 0);
+    std::vector<size_t> oldAt(oldCount), newAt(newCount);
+    for (size_t i = 0; i < oldCount; ++i) {
+        oldAt[i] = i;
+    }
+    for (size_t i = 0; i < newCount; ++i) {
+        newAt[i] = i;
+    }
+    diffRange(oldHashes, newHashes, oldAt, newAt, removed, added, true);
+    // Lines paired up by equal hashes but different text are replaced after
+    // all.
+    for (size_t i = 0, j = 0; i < oldCount && j < newCount;) {
+        if (removed[i]) {
+            ++i;
+        } else if (added[j]) {
+            ++j;
+        } else {
+            if (!sameText(*oldText[prefix + i], *newText[prefix + j])) {
+                removed[i] = 1;
+                added[j] = 1;
+            }
+            ++i;
+            ++j;
+        }
+    }
+
+    std::vector<DiffChange> changes;
+    size_t i = 0, j = 0;
+    while (i < oldCount || j < newCount) {
+        if (i < oldCount && j < newCount && !removed[i] && !added[j]) {
+            ++i;
+            ++j;
+            continue;
+        }
+        DiffChange change = {prefix + i, 0, prefix + j, 0};
+        for (; i < oldCount && removed[i]; ++i) {
+            change.oldCount++;
+        }
+        for (; j < newCount && added[j]; ++j) {
+            change.newCount++;
+        }
+        changes.push_back(change);
+    }
+    return changes;
+}
+
+void writeUnifiedDiff(const Rope<Line> &oldLines, const Rope<Line> &newLines,
+                      const std::vector<DiffChange> &changes, const std::string &oldLabel,
+                      const std::string &newLabel, std::ostream &out, size_t context) {
+    if (changes.empty()) {
+        return;
+    }
+    out << "--- " << oldLabel << "\n+++ " << newLabel << "\n";
+    std::string hunk;
+    size_t first = 0;
+    while (first < changes.size()) {
+        // Changes closer than twice the context share a hunk.
+        size_t last = first;
+        while (last + 1 < changes.size() &&
+               changes[last + 1].oldFirst - (changes[last].oldFirst + changes[last].oldCount) <= 2 * context) {
+            ++last;
+        }
+        const DiffChange &head = changes[first];
+        const DiffChange &tail = changes[last];
+        size_t before = std::min(context, head.oldFirst);
+        size_t oldStart = head.oldFirst - before;
+        size_t newStart = head.newFirst - before;
+        size_t after = std::min(context, oldLines.size() - (tail.oldFirst + tail.oldCount));
+        size_t oldEnd = tail.oldFirst + tail.oldCount + after;
+        size_t newEnd = tail.newFirst + tail.newCount + after;
+
+        hunk = "@@ -";
+        appendRange(hunk, oldStart, oldEnd - oldStart);
+        hunk += " +";
+        appendRange(hunk, newStart, newEnd - newStart);
+        hunk += " @@\n";
+        Rope<Line>::const_iterator oldIt = oldLines.iteratorAt(oldStart);
+        Rope<Line>::const_iterator newIt = newLines.iteratorAt(newStart);
+        size_t oldPos = oldStart;
+        for (size_t k = first; k <= last; ++k) {
+            const DiffChange &change = changes[k];
+            size_t common = change.oldFirst - oldPos;
+            appendLines(hunk, ' ', oldIt, common);
+            for (size_t i = 0; i < common; ++i) {
+                ++newIt;
+            }
+            appendLines(hunk, '-', oldIt, change.oldCount);
+            appendLines(hunk, '+', newIt, change.newCount);
+            oldPos = change.oldFirst + change.oldCount;
+        }
+        appendLines(hunk, ' ', oldIt, oldEnd - oldPos);
+        out.write(hunk.data(), hunk.size());
+        first = last + 1;
+    }
+}
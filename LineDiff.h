@@ -0,0 +1,42 @@
+#ifndef TEXT_EDITOR_LINEDIFF_H
+#define TEXT_EDITOR_LINEDIFF_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Line.h"
+#include "Rope.h"
+
+#define DIFF_CONTEXT_LINES 3
+// The middle snake search gives up on an optimal split after about the
+// square root of the compared lines' diagonals, but never before this many
+// steps, and settles for the furthest reaching path instead.
+#define DIFF_MIN_COST_LIMIT 256
+#define DIFF_BUCKETS_PER_LINE 4
+#define DIFF_MAX_BUCKETS (1 << 26)
+
+// A run of lines that differs: `oldCount` lines at oldFirst of the old
+// document became `newCount` lines at newFirst of the new one.
+struct DiffChange {
+    size_t oldFirst;
+    size_t oldCount;
+    size_t newFirst;
+    size_t newCount;
+};
+
+// Myers diff of two documents by line, in document order. Common leading
+// and trailing lines are skipped first, the rest is compared by 64-bit
+// hash and lines that occur on one side only are set aside before the
+// search, so a few changes in a large document cost about one pass over
+// it. Lines paired up are checked byte by byte. The result is minimal
+// unless the cost limit above was hit.
+std::vector<DiffChange> diffLines(const Rope<Line> &oldLines, const Rope<Line> &newLines);
+
+// Writes the changes as a unified diff with `context` lines around them,
+// one hunk at a time.
+void writeUnifiedDiff(const Rope<Line> &oldLines, const Rope<Line> &newLines,
+                      const std::vector<DiffChange> &changes, const std::string &oldLabel,
+                      const std::string &newLabel, std::ostream &out, size_t context = DIFF_CONTEXT_LINES);
+
+#endif //TEXT_EDITOR_LINEDIFF_H
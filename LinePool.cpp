@@ -0,0 +1,86 @@
+#include "LinePool.h"
+
+#include <cstring>
+
+uint64_t hashLineText(const char *text, size_t length) {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, text + i, 8);
+        hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 31;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, text + i, length - i);
+    hash = (hash ^ tail) * 0x94D049BB133111EBULL;
+    return hash ^ (hash >> 29);
+}
+
+LinePool::LinePool() : sweptSize(0), stats() {}
+
+const Line *LinePool::find(uint64_t hash, const char *text, size_t length) const {
+    auto range = entries.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const Line &entry = it->second;
+        if (entry.getTextLength() == length && std::memcmp(entry.getText(), text, length) == 0) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void LinePool::sweep() {
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.isShared()) {
+            ++it;
+        } else {
+            it = entries.erase(it);
+        }
+    }
+    sweptSize = entries.size();
+}
+
+void LinePool::intern(Line &line) {
+    if (line.isBorrowed() || line.isInline() || line.isShared()) {
+        return;
+    }
+    stats.lookups++;
+    uint64_t hash = hashLineText(line.getText(), line.getTextLength());
+    if (const Line *pooled = find(hash, line.getText(), line.getTextLength())) {
+        stats.hits++;
+        stats.bytesShared += line.getTextLength() + 1;
+        line = *pooled;
+        return;
+    }
+    entries.emplace(hash, line);
+    if (entries.size() >= LINE_POOL_MIN_SWEEP && entries.size() >= sweptSize * 2) {
+        sweep();
+    }
+}
+
+Line LinePool::make(const char *text, size_t length, LineArena &arena) {
+    Line line;
+    if (length >= INLINE_CAPACITY) {
+        stats.lookups++;
+        uint64_t hash = hashLineText(text, length);
+        if (const Line *pooled = find(hash, text, length)) {
+            stats.hits++;
+            stats.bytesShared += length + 1;
+            return *pooled;
+        }
+        line.replaceText(0, 0, text, length, arena);
+        entries.emplace(hash, line);
+        if (entries.size() >= LINE_POOL_MIN_SWEEP && entries.size() >= sweptSize * 2) {
+            sweep();
+        }
+        return line;
+    }
+    line.replaceText(0, 0, text, length, arena);
+    return line;
+}
+
+void LinePool::clear() {
+    entries.clear();
+    sweptSize = 0;
+}
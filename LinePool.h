@@ -0,0 +1,64 @@
+#ifndef TEXT_EDITOR_LINEPOOL_H
+#define TEXT_EDITOR_LINEPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include "Line.h"
+#include "LineArena.h"
+
+// Entries only the pool still refers to are dropped once the pool has
+// doubled since it was last swept, but not before it holds this many.
+#define LINE_POOL_MIN_SWEEP 4096
+
+// 64-bit hash of a line's bytes.
+uint64_t hashLineText(const char *text, size_t length);
+
+struct LinePoolStats {
+    size_t lookups;
+    size_t hits;
+    size_t bytesShared;
+};
+
+// Content-addressed store of arena line buffers. Interning a line makes it
+// share the block of an earlier line with the same text, so repeated lines
+// are stored once; the shared block is copied by the first edit made
+// through any of its lines. Borrowed and inline lines cost no buffer and are
+// left alone. The pool holds a reference to every block it hands out, and
+// must be used on the thread that copies and destroys the lines.
+class LinePool {
+private:
+    std::unordered_multimap<uint64_t, Line> entries;
+    size_t sweptSize;
+    LinePoolStats stats;
+
+    // The entry holding `length` bytes of `text`, or null.
+    const Line *find(uint64_t hash, const char *text, size_t length) const;
+    void sweep();
+
+public:
+    LinePool();
+
+    LinePool(const LinePool &) = delete;
+    LinePool &operator=(const LinePool &) = delete;
+
+    // Points an arena line at the pooled copy of its text, adding it to the
+    // pool if it is new. Lines already sharing their block are skipped.
+    void intern(Line &line);
+
+    // A line holding `length` bytes of `text`, sharing a pooled block when
+    // there is one instead of allocating from `arena`.
+    Line make(const char *text, size_t length, LineArena &arena);
+
+    void clear();
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    const LinePoolStats &getStats() const {
+        return stats;
+    }
+};
+
+#endif //TEXT_EDITOR_LINEPOOL_H
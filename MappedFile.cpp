@@ -0,0 +1,79 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : fd(-1), data(nullptr), size(0), device(0), inode(0), modified(), intactSize(0) {}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(data, size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool MappedFile::open(const char *path) {
+    fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    this->path = path;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        return false;
+    }
+    device = info.st_dev;
+    inode = info.st_ino;
+    modified = info.st_mtim;
+    size = info.st_size;
+    intactSize = size;
+    if (size == 0) {
+        return true;
+    }
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        size = 0;
+        intactSize = 0;
+        return false;
+    }
+    data = static_cast<char *>(mapping);
+    madvise(data, size, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool MappedFile::isTruncated() const {
+    struct stat info;
+    return fd >= 0 && (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < size);
+}
+
+size_t MappedFile::detachIfTruncated() {
+    std::lock_guard<std::mutex> lock(detachMutex);
+    struct stat info;
+    if (!data || intactSize < size || fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) >= size) {
+        return 0;
+    }
+    // The tail of the page holding the new end already reads as zeros;
+    // whole pages past it are replaced.
+    size_t intact = info.st_size;
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t kept = (intact + pageSize - 1) / pageSize * pageSize;
+    if (kept < size &&
+        mmap(data + kept, size - kept, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        return 0;
+    }
+    intactSize = intact;
+    return size - intact;
+}
+
+bool MappedFile::isSameFile(const char *path) const {
+    struct stat info;
+    if (fd < 0 || stat(path, &info) != 0) {
+        return false;
+    }
+    return info.st_dev == device && info.st_ino == inode && static_cast<size_t>(info.st_size) == size &&
+           info.st_mtim.tv_sec == modified.tv_sec && info.st_mtim.tv_nsec == modified.tv_nsec;
+}
@@ -0,0 +1,84 @@
+#ifndef TEXT_EDITOR_MAPPEDFILE_H
+#define TEXT_EDITOR_MAPPEDFILE_H
+
+#include <atomic>
+#include <cstddef>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+
+// Read-only private mapping of a whole file. Lines loaded from the file
+// borrow their bytes from the mapping until they are first edited.
+// The mapping follows the file, so if another program truncates it, any
+// read of a borrowed line past the new end raises SIGBUS. The editor's own
+// saves replace files by rename and never truncate a mapped one; other
+// writers should do the same. Before reading borrowed text, TextStorage
+// calls detachIfTruncated() on its mappings so that a truncation costs the
+// text past the new end instead of the process.
+class MappedFile {
+private:
+    int fd;
+    char *data;
+    size_t size;
+    std::string path;
+    dev_t device;
+    ino_t inode;
+    struct timespec modified;
+    std::mutex detachMutex;
+    std::atomic<size_t> intactSize;
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Returns false when the file cannot be mapped (missing, not a regular
+    // file, ...); the caller is expected to fall back to stream reading.
+    bool open(const char *path);
+
+    const char *getData() const {
+        return data;
+    }
+
+    size_t getSize() const {
+        return size;
+    }
+
+    const std::string &getPath() const {
+        return path;
+    }
+
+    // Bytes at the start of the mapping that still hold the file's text:
+    // all of them until a truncation is detected, then the file's size at
+    // that point.
+    size_t getIntactSize() const {
+        return intactSize;
+    }
+
+    int getFd() const {
+        return fd;
+    }
+
+    bool contains(const char *pointer) const {
+        return pointer >= data && pointer < data + size;
+    }
+
+    // True if `path` is this file and its size and modification time are
+    // what they were when it was mapped, so the mapping can be reused.
+    bool isSameFile(const char *path) const;
+
+    // True if the file is now shorter than the mapping.
+    bool isTruncated() const;
+
+    // If the file is now shorter than the mapping, replaces the pages past
+    // its end with zero pages, so borrowed text there reads as NUL bytes
+    // instead of raising SIGBUS, and returns the number of bytes lost. Returns
+    // 0 if the file is intact or was detached before. A read racing with the
+    // truncation itself can still fault; the editor only narrows that window.
+    size_t detachIfTruncated();
+};
+
+#endif //TEXT_EDITOR_MAPPEDFILE_H
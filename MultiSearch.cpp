@@ -0,0 +1,224 @@
+#include "MultiSearch.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+bool isWordByte(unsigned char c) {
+    return std::isalnum(c) || c == '_';
+}
+
+}
+
+MultiSearch::MultiSearch(const std::vector<std::string> &needles, const SearchOptions &options)
+        : patterns(needles), ignoreCase(options.ignoreCase), wholeWord(options.wholeWord), hasNewline(false),
+          classCount(1), rowShift(0), maxLength(0), firstMatching(0) {
+    if (ignoreCase) {
+        for (std::string &pattern : patterns) {
+            for (char &c : pattern) {
+                c = std::tolower(static_cast<unsigned char>(c));
+            }
+        }
+    }
+    build();
+}
+
+void MultiSearch::build() {
+    std::memset(byteClass, 0, sizeof(byteClass));
+    for (const std::string &pattern : patterns) {
+        maxLength = std::max(maxLength, pattern.size());
+        for (char c : pattern) {
+            unsigned char byte = c;
+            hasNewline = hasNewline || byte == '\n';
+            if (!byteClass[byte]) {
+                byteClass[byte] = classCount++;
+            }
+        }
+    }
+    if (ignoreCase) {
+        for (int c = 'A'; c <= 'Z'; ++c) {
+            byteClass[c] = byteClass[std::tolower(c)];
+        }
+    }
+
+    // Trie with child state numbers, 0 meaning no child (the root is never
+    // a child).
+    size_t stride = classCount;
+    std::vector<uint32_t> next(stride, 0);
+    std::vector<std::vector<uint32_t>> ends(1);
+    for (size_t p = 0; p < patterns.size(); ++p) {
+        if (patterns[p].empty()) {
+            continue;
+        }
+        size_t state = 0;
+        for (char c : patterns[p]) {
+            size_t slot = state * stride + byteClass[static_cast<unsigned char>(c)];
+            if (!next[slot]) {
+                next[slot] = ends.size();
+                ends.emplace_back();
+                next.resize(next.size() + stride, 0);
+            }
+            state = next[slot];
+        }
+        ends[state].push_back(p);
+    }
+
+    // Breadth-first over the trie: a missing edge is taken from the failure
+    // state, whose row is already complete because it is shallower.
+    size_t states = ends.size();
+    std::vector<uint32_t> fail(states, 0);
+    std::vector<uint32_t> order;
+    order.reserve(states);
+    for (size_t c = 0; c < stride; ++c) {
+        if (next[c]) {
+            order.push_back(next[c]);
+        }
+    }
+    for (size_t head = 0; head < order.size(); ++head) {
+        size_t state = order[head];
+        for (size_t c = 0; c < stride; ++c) {
+            size_t slot = state * stride + c;
+            if (next[slot]) {
+                fail[next[slot]] = next[fail[state] * stride + c];
+                order.push_back(next[slot]);
+            } else {
+                next[slot] = next[fail[state] * stride + c];
+            }
+        }
+    }
+    for (uint32_t state : order) {
+        const std::vector<uint32_t> &inherited = ends[fail[state]];
+        ends[state].insert(ends[state].end(), inherited.begin(), inherited.end());
+    }
+
+    // Renumber so that every matching state comes after every other one,
+    // and pad rows to a power of two so a row offset maps back to its state
+    // with a shift.
+    while ((size_t(1) << rowShift) < stride) {
+        ++rowShift;
+    }
+    std::vector<uint32_t> original;
+    original.reserve(states);
+    for (size_t state = 0; state < states; ++state) {
+        if (ends[state].empty()) {
+            original.push_back(state);
+        }
+    }
+    firstMatching = original.size() << rowShift;
+    for (size_t state = 0; state < states; ++state) {
+        if (!ends[state].empty()) {
+            original.push_back(state);
+        }
+    }
+    std::vector<uint32_t> renumbered(states);
+    for (size_t id = 0; id < states; ++id) {
+        renumbered[original[id]] = id;
+    }
+
+    outputStart.assign(states + 1, 0);
+    outputs.clear();
+    transitions.assign(states << rowShift, 0);
+    for (size_t id = 0; id < states; ++id) {
+        const std::vector<uint32_t> &ended = ends[original[id]];
+        outputStart[id] = outputs.size();
+        outputs.insert(outputs.end(), ended.begin(), ended.end());
+        for (size_t c = 0; c < stride; ++c) {
+            transitions[(id << rowShift) + c] = renumbered[next[original[id] * stride + c]] << rowShift;
+        }
+    }
+    outputStart[states] = outputs.size();
+}
+
+void MultiSearch::report(uint32_t state, const unsigned char *text, size_t len, size_t end,
+                         std::vector<PatternMatch> &matches) const {
+    size_t index = state >> rowShift;
+    for (size_t k = outputStart[index]; k < outputStart[index + 1]; ++k) {
+        size_t pattern = outputs[k];
+        size_t pos = end - patterns[pattern].size();
+        if (wholeWord && ((pos > 0 && isWordByte(text[pos - 1])) || (end < len && isWordByte(text[end])))) {
+            continue;
+        }
+        matches.push_back({pattern, pos});
+    }
+}
+
+void MultiSearch::scan(uint32_t state, const unsigned char *text, size_t len, size_t from, size_t to,
+                       size_t reportFrom, std::vector<PatternMatch> &matches) const {
+    const uint32_t *table = transitions.data();
+    for (size_t i = from; i < to; ++i) {
+        state = table[state + byteClass[text[i]]];
+        if (state >= firstMatching && i >= reportFrom) {
+            report(state, text, len, i + 1, matches);
+        }
+    }
+}
+
+void MultiSearch::findAll(const char *text, size_t len, std::vector<PatternMatch> &matches) const {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(text);
+    size_t segment = len / MULTI_SEARCH_LANES;
+    if (maxLength == 0) {
+        return;
+    }
+    if (segment < MIN_MULTI_SEARCH_LANE_BYTES || segment < maxLength) {
+        scan(0, bytes, len, 0, len, 0, matches);
+        return;
+    }
+    // Lane 0 reports straight into `matches`; the others are appended after
+    // it so the result stays ordered by end position.
+    std::vector<PatternMatch> laneMatches[MULTI_SEARCH_LANES];
+    size_t begin[MULTI_SEARCH_LANES];
+    size_t start[MULTI_SEARCH_LANES];
+    uint32_t state[MULTI_SEARCH_LANES];
+    for (size_t lane = 0; lane < MULTI_SEARCH_LANES; ++lane) {
+        begin[lane] = lane * segment;
+        start[lane] = lane ? begin[lane] - (maxLength - 1) : 0;
+        state[lane] = 0;
+    }
+    const uint32_t *table = transitions.data();
+    const uint32_t matching = firstMatching;
+    // Spelled out per lane so the states stay in registers.
+    uint32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    const unsigned char *p0 = bytes + start[0], *p1 = bytes + start[1], *p2 = bytes + start[2],
+            *p3 = bytes + start[3];
+    for (size_t i = 0; i < segment; ++i) {
+        s0 = table[s0 + byteClass[p0[i]]];
+        s1 = table[s1 + byteClass[p1[i]]];
+        s2 = table[s2 + byteClass[p2[i]]];
+        s3 = table[s3 + byteClass[p3[i]]];
+        if (__builtin_expect((s0 >= matching) | (s1 >= matching) | (s2 >= matching) | (s3 >= matching), 0)) {
+            uint32_t current[MULTI_SEARCH_LANES] = {s0, s1, s2, s3};
+            for (size_t lane = 0; lane < MULTI_SEARCH_LANES; ++lane) {
+                size_t at = start[lane] + i;
+                if (current[lane] >= matching && at >= begin[lane]) {
+                    report(current[lane], bytes, len, at + 1, lane ? laneMatches[lane] : matches);
+                }
+            }
+        }
+    }
+    state[0] = s0;
+    state[1] = s1;
+    state[2] = s2;
+    state[3] = s3;
+    for (size_t lane = 0; lane < MULTI_SEARCH_LANES; ++lane) {
+        size_t end = lane + 1 < MULTI_SEARCH_LANES ? begin[lane + 1] : len;
+        scan(state[lane], bytes, len, start[lane] + segment, end, begin[lane], lane ? laneMatches[lane] : matches);
+        if (lane) {
+            matches.insert(matches.end(), laneMatches[lane].begin(), laneMatches[lane].end());
+        }
+    }
+}
+
+std::vector<std::string> splitPatterns(const std::string &list) {
+    std::vector<std::string> patterns;
+    size_t start = 0;
+    while (true) {
+        size_t end = list.find('|', start);
+        patterns.push_back(list.substr(start, end - start));
+        if (end == std::string::npos) {
+            return patterns;
+        }
+        start = end + 1;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef TEXT_EDITOR_MULTISEARCH_H
+#define TEXT_EDITOR_MULTISEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TextSearch.h"
+
+// findAll() walks exactly four lanes.
+#define MULTI_SEARCH_LANES 4
+#define MIN_MULTI_SEARCH_LANE_BYTES 4096
+
+struct PatternMatch {
+    size_t pattern;
+    size_t pos;
+};
+
+// Aho-Corasick matcher for many patterns at once. The automaton is compiled
+// to a dense DFA over byte classes (bytes that occur in no pattern share one
+// class), stored as a single flat table whose entries are pre-multiplied row
+// offsets, so each input byte costs one class lookup and one table load no
+// matter how many patterns there are. States that end a pattern are numbered
+// last, so spotting a match is a single comparison.
+// Long texts are cut into MULTI_SEARCH_LANES segments walked in lockstep;
+// each lane starts maxLength - 1 bytes early so matches that straddle a cut
+// are found once, and the independent table loads overlap in the pipeline.
+class MultiSearch {
+private:
+    std::vector<std::string> patterns;
+    bool ignoreCase;
+    bool wholeWord;
+    bool hasNewline;
+    size_t classCount;
+    size_t rowShift;
+    size_t maxLength;
+    uint32_t firstMatching;
+    uint16_t byteClass[256];
+    std::vector<uint32_t> transitions;
+    // Patterns ending in state s are outputs[outputStart[s], outputStart[s + 1]).
+    std::vector<uint32_t> outputStart;
+    std::vector<uint32_t> outputs;
+
+    void build();
+
+    // Appends the matches ending at text[end - 1] in `state`, the row offset
+    // of a matching state.
+    void report(uint32_t state, const unsigned char *text, size_t len, size_t end,
+                std::vector<PatternMatch> &matches) const;
+
+    // Scans text[from, to) starting in `state` and reports matches ending
+    // after `reportFrom`.
+    void scan(uint32_t state, const unsigned char *text, size_t len, size_t from, size_t to, size_t reportFrom,
+              std::vector<PatternMatch> &matches) const;
+
+public:
+    MultiSearch(const std::vector<std::string> &needles, const SearchOptions &options);
+
+    size_t getPatternCount() const {
+        return patterns.size();
+    }
+
+    size_t getPatternLength(size_t pattern) const {
+        return patterns[pattern].size();
+    }
+
+    size_t getStateCount() const {
+        return outputStart.size() - 1;
+    }
+
+    // True if some pattern contains a newline, in which case matches can
+    // only be found inside single lines.
+    bool matchesNewline() const {
+        return hasNewline;
+    }
+
+    // Appends every match in text[0, len) to `matches`, ordered by the
+    // position where the match ends. Empty patterns never match.
+    void findAll(const char *text, size_t len, std::vector<PatternMatch> &matches) const;
+};
+
+// Splits a pattern list typed as "first|second|third".
+std::vector<std::string> splitPatterns(const std::string &list);
+
+#endif //TEXT_EDITOR_MULTISEARCH_H
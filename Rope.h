@@ -0,0 +1,537 @@
+#ifndef TEXT_EDITOR_ROPE_H
+#define TEXT_EDITOR_ROPE_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Weight of an element for Rope's prefix sums; specialize to enable them.
+template <typename T>
+struct RopeWeight {
+    static size_t of(const T &) {
+        return 0;
+    }
+};
+
+// Balanced B+-tree sequence used as the line backend of TextStorage.
+// Internal nodes keep subtree sizes, so indexing, insertion and removal are
+// O(log n) and growing the sequence never copies or moves existing elements
+// outside of a single leaf. Leaves are chained for O(1) sequential scans.
+// Nodes also keep the sum of RopeWeight<T> over their subtree, which gives
+// O(log n) prefix sums and weight-to-index lookups. Elements must therefore
+// only be modified through update().
+template <typename T>
+class Rope {
+private:
+    static const size_t MAX_FILL = 64;
+    static const size_t MIN_FILL = MAX_FILL / 4;
+    // Every internal node has at least two children, so 64 levels cover
+    // any sequence that fits in memory.
+    static const size_t MAX_DEPTH = 64;
+
+    struct Node {
+        bool leaf;
+        size_t size;
+        size_t weight;
+        std::vector<T> items;
+        std::vector<Node *> children;
+        Node *next;
+
+        explicit Node(bool isLeaf) : leaf(isLeaf), size(0), weight(0), next(nullptr) {
+            if (leaf) {
+                items.reserve(MAX_FILL + 1);
+            }
+        }
+    };
+
+    Node *root;
+
+    static size_t fill(const Node *node) {
+        return node->leaf ? node->items.size() : node->children.size();
+    }
+
+    static void destroy(Node *node) {
+        if (!node->leaf) {
+            for (Node *child : node->children) {
+                destroy(child);
+            }
+        }
+        delete node;
+    }
+
+    // Picks the child holding element `index` and rebases `index` into it.
+    // An index equal to the subtree size addresses the end of the last child.
+    static size_t locate(const Node *node, size_t &index) {
+        size_t n = node->children.size();
+        if (index >= node->size) {
+            index -= node->size - node->children[n - 1]->size;
+            return n - 1;
+        }
+        if (index < node->size / 2) {
+            for (size_t i = 0; i < n; ++i) {
+                if (index < node->children[i]->size) {
+                    return i;
+                }
+                index -= node->children[i]->size;
+            }
+        } else {
+            size_t start = node->size;
+            for (size_t i = n; i-- > 0;) {
+                start -= node->children[i]->size;
+                if (index >= start) {
+                    index -= start;
+                    return i;
+                }
+            }
+        }
+        return n - 1;
+    }
+
+    // Splits in half, or leaves the node full when the overflow came from an
+    // append so that sequences built front to back stay densely packed.
+    static Node *splitLeaf(Node *node, bool appended) {
+        Node *right = new Node(true);
+        size_t half = appended ? node->items.size() - 1 : node->items.size() / 2;
+        for (size_t i = half; i < node->items.size(); ++i) {
+            right->weight += RopeWeight<T>::of(node->items[i]);
+            right->items.push_back(std::move(node->items[i]));
+        }
+        node->weight -= right->weight;
+        node->items.erase(node->items.begin() + half, node->items.end());
+        node->size = node->items.size();
+        right->size = right->items.size();
+        right->next = node->next;
+        node->next = right;
+        return right;
+    }
+
+    static Node *splitInternal(Node *node, bool appended) {
+        Node *right = new Node(false);
+        size_t half = appended ? node->children.size() - 1 : node->children.size() / 2;
+        right->children.assign(node->children.begin() + half, node->children.end());
+        node->children.erase(node->children.begin() + half, node->children.end());
+        for (Node *child : right->children) {
+            right->size += child->size;
+            right->weight += child->weight;
+        }
+        node->size -= right->size;
+        node->weight -= right->weight;
+        return right;
+    }
+
+    static Node *insertInto(Node *node, size_t index, T &&value, size_t weight) {
+        node->weight += weight;
+        if (node->leaf) {
+            node->size++;
+            node->items.insert(node->items.begin() + index, std::move(value));
+            if (node->items.size() <= MAX_FILL) {
+                return nullptr;
+            }
+            return splitLeaf(node, index + 1 == node->items.size() && !node->next);
+        }
+        size_t slot = locate(node, index);
+        node->size++;
+        Node *sibling = insertInto(node->children[slot], index, std::move(value), weight);
+        if (!sibling) {
+            return nullptr;
+        }
+        node->children.insert(node->children.begin() + slot + 1, sibling);
+        if (node->children.size() <= MAX_FILL) {
+            return nullptr;
+        }
+        return splitInternal(node, slot + 2 == node->children.size() && sibling->size == 1);
+    }
+
+    // Merges an underfull child with a neighbour, re-splitting if the
+    // combined node overflows.
+    static void rebalance(Node *parent, size_t slot) {
+        if (fill(parent->children[slot]) >= MIN_FILL || parent->children.size() < 2) {
+            return;
+        }
+        if (slot + 1 == parent->children.size()) {
+            slot--;
+        }
+        Node *left = parent->children[slot];
+        Node *right = parent->children[slot + 1];
+        if (left->leaf) {
+            for (T &item : right->items) {
+                left->items.push_back(std::move(item));
+            }
+            left->next = right->next;
+        } else {
+            left->children.insert(left->children.end(), right->children.begin(), right->children.end());
+            right->children.clear();
+        }
+        left->size += right->size;
+        left->weight += right->weight;
+        delete right;
+        parent->children.erase(parent->children.begin() + slot + 1);
+        if (fill(left) > MAX_FILL) {
+            Node *split = left->leaf ? splitLeaf(left, false) : splitInternal(left, false);
+            parent->children.insert(parent->children.begin() + slot + 1, split);
+        }
+    }
+
+    static T takeFrom(Node *node, size_t index) {
+        if (node->leaf) {
+            node->size--;
+            node->weight -= RopeWeight<T>::of(node->items[index]);
+            T value = std::move(node->items[index]);
+            node->items.erase(node->items.begin() + index);
+            return value;
+        }
+        size_t slot = locate(node, index);
+        node->size--;
+        T value = takeFrom(node->children[slot], index);
+        node->weight -= RopeWeight<T>::of(value);
+        rebalance(node, slot);
+        return value;
+    }
+
+    // Copies the subtree node by node, chaining the copied leaves after
+    // `lastLeaf`.
+    static Node *clone(const Node *node, Node *&lastLeaf) {
+        Node *copy = new Node(node->leaf);
+        copy->size = node->size;
+        copy->weight = node->weight;
+        if (node->leaf) {
+            copy->items = node->items;
+            if (lastLeaf) {
+                lastLeaf->next = copy;
+            }
+            lastLeaf = copy;
+            return copy;
+        }
+        copy->children.reserve(node->children.size());
+        for (const Node *child : node->children) {
+            copy->children.push_back(clone(child, lastLeaf));
+        }
+        return copy;
+    }
+
+    static size_t height(const Node *node) {
+        size_t levels = 0;
+        for (; !node->leaf; node = node->children.front()) {
+            ++levels;
+        }
+        return levels;
+    }
+
+    // Hangs `small` off the last (or first) node `levels` levels down the
+    // edge of `tall`, where the subtrees are of equal height, and splits the
+    // nodes above that overflow. Returns the new root.
+    static Node *join(Node *tall, Node *small, size_t levels, bool atEnd) {
+        if (levels == 0) {
+            Node *joined = new Node(false);
+            joined->children.push_back(atEnd ? tall : small);
+            joined->children.push_back(atEnd ? small : tall);
+            joined->size = tall->size + small->size;
+            joined->weight = tall->weight + small->weight;
+            rebalance(joined, 1);
+            rebalance(joined, 0);
+            if (joined->children.size() == 1) {
+                Node *child = joined->children.front();
+                joined->children.clear();
+                delete joined;
+                return child;
+            }
+            return joined;
+        }
+        Node *path[MAX_DEPTH];
+        Node *node = tall;
+        for (size_t depth = 0; depth < levels; ++depth) {
+            path[depth] = node;
+            node->size += small->size;
+            node->weight += small->weight;
+            if (depth + 1 < levels) {
+                node = atEnd ? node->children.back() : node->children.front();
+            }
+        }
+        node->children.insert(atEnd ? node->children.end() : node->children.begin(), small);
+        rebalance(node, atEnd ? node->children.size() - 1 : 0);
+        for (size_t depth = levels; depth-- > 0;) {
+            node = path[depth];
+            if (node->children.size() <= MAX_FILL) {
+                break;
+            }
+            Node *split = splitInternal(node, false);
+            if (depth == 0) {
+                Node *grown = new Node(false);
+                grown->children.push_back(node);
+                grown->children.push_back(split);
+                grown->size = node->size + split->size;
+                grown->weight = node->weight + split->weight;
+                return grown;
+            }
+            Node *parent = path[depth - 1];
+            size_t slot = atEnd ? parent->children.size() - 1 : 0;
+            parent->children.insert(parent->children.begin() + slot + 1, split);
+        }
+        return tall;
+    }
+
+    Node *leafAt(size_t &index) const {
+        Node *node = root;
+        while (!node->leaf) {
+            node = node->children[locate(node, index)];
+        }
+        return node;
+    }
+
+    Node *firstLeaf() const {
+        Node *node = root;
+        while (!node->leaf) {
+            node = node->children.front();
+        }
+        return node;
+    }
+
+public:
+    template <typename Value, typename NodePtr>
+    class Iterator {
+    private:
+        NodePtr leaf;
+        size_t slot;
+
+        friend class Rope;
+
+        Iterator(NodePtr node, size_t position) : leaf(node), slot(position) {
+            skipExhausted();
+        }
+
+        void skipExhausted() {
+            while (leaf && slot >= leaf->items.size()) {
+                leaf = leaf->next;
+                slot = 0;
+            }
+        }
+
+    public:
+        Iterator() : leaf(nullptr), slot(0) {}
+
+        Value &operator*() const {
+            return leaf->items[slot];
+        }
+
+        Value *operator->() const {
+            return &leaf->items[slot];
+        }
+
+        Iterator &operator++() {
+            ++slot;
+            skipExhausted();
+            return *this;
+        }
+
+        bool operator==(const Iterator &other) const {
+            return leaf == other.leaf && slot == other.slot;
+        }
+
+        bool operator!=(const Iterator &other) const {
+            return !(*this == other);
+        }
+    };
+
+    // Iteration is read-only so that element weights stay in sync.
+    typedef Iterator<const T, const Node *> const_iterator;
+    typedef const_iterator iterator;
+
+    Rope() : root(new Node(true)) {}
+
+    Rope(const Rope &other) {
+        Node *lastLeaf = nullptr;
+        root = clone(other.root, lastLeaf);
+    }
+
+    Rope(Rope &&other) noexcept : root(other.root) {
+        other.root = new Node(true);
+    }
+
+    Rope &operator=(const Rope &other) {
+        if (this != &other) {
+            Rope copy(other);
+            std::swap(root, copy.root);
+        }
+        return *this;
+    }
+
+    Rope &operator=(Rope &&other) noexcept {
+        std::swap(root, other.root);
+        return *this;
+    }
+
+    ~Rope() {
+        destroy(root);
+    }
+
+    size_t size() const {
+        return root->size;
+    }
+
+    bool empty() const {
+        return root->size == 0;
+    }
+
+    const T &operator[](size_t index) const {
+        Node *leaf = leafAt(index);
+        return leaf->items[index];
+    }
+
+    void insert(size_t index, T value) {
+        size_t weight = RopeWeight<T>::of(value);
+        Node *sibling = insertInto(root, index, std::move(value), weight);
+        if (sibling) {
+            Node *newRoot = new Node(false);
+            newRoot->children.push_back(root);
+            newRoot->children.push_back(sibling);
+            newRoot->size = root->size + sibling->size;
+            newRoot->weight = root->weight + sibling->weight;
+            root = newRoot;
+        }
+    }
+
+    // Calls modify(element) and propagates the change in its weight.
+    template <typename Modify>
+    void update(size_t index, Modify &&modify) {
+        Node *path[MAX_DEPTH];
+        size_t depth = 0;
+        Node *node = root;
+        while (!node->leaf) {
+            path[depth++] = node;
+            node = node->children[locate(node, index)];
+        }
+        T &item = node->items[index];
+        size_t before = RopeWeight<T>::of(item);
+        modify(item);
+        size_t after = RopeWeight<T>::of(item);
+        node->weight = node->weight - before + after;
+        while (depth > 0) {
+            Node *parent = path[--depth];
+            parent->weight = parent->weight - before + after;
+        }
+    }
+
+    size_t weight() const {
+        return root->weight;
+    }
+
+    // Sum of the weights of the elements before `index`.
+    size_t weightBefore(size_t index) const {
+        size_t sum = 0;
+        const Node *node = root;
+        while (!node->leaf) {
+            size_t slot = 0;
+            while (slot + 1 < node->children.size() && index >= node->children[slot]->size) {
+                index -= node->children[slot]->size;
+                sum += node->children[slot]->weight;
+                ++slot;
+            }
+            node = node->children[slot];
+        }
+        for (size_t i = 0; i < index && i < node->items.size(); ++i) {
+            sum += RopeWeight<T>::of(node->items[i]);
+        }
+        return sum;
+    }
+
+    // Index of the element covering `offset` in the running weight, with
+    // `offset` rebased to that element; size() if offset >= weight().
+    size_t indexAtWeight(size_t &offset) const {
+        if (offset >= root->weight) {
+            return size();
+        }
+        size_t index = 0;
+        const Node *node = root;
+        while (!node->leaf) {
+            size_t slot = 0;
+            while (offset >= node->children[slot]->weight) {
+                offset -= node->children[slot]->weight;
+                index += node->children[slot]->size;
+                ++slot;
+            }
+            node = node->children[slot];
+        }
+        for (const T &item : node->items) {
+            size_t weight = RopeWeight<T>::of(item);
+            if (offset < weight) {
+                break;
+            }
+            offset -= weight;
+            ++index;
+        }
+        return index;
+    }
+
+    void push_back(T value) {
+        insert(size(), std::move(value));
+    }
+
+    // Moves every element of `other` to the end in O(log n) by joining the
+    // two trees; `other` is left empty.
+    void append(Rope &&other) {
+        if (other.empty()) {
+            return;
+        }
+        if (empty()) {
+            std::swap(root, other.root);
+            return;
+        }
+        Node *left = root;
+        Node *right = other.root;
+        other.root = new Node(true);
+        Node *lastLeaf = left;
+        while (!lastLeaf->leaf) {
+            lastLeaf = lastLeaf->children.back();
+        }
+        Node *firstRight = right;
+        while (!firstRight->leaf) {
+            firstRight = firstRight->children.front();
+        }
+        lastLeaf->next = firstRight;
+        size_t leftHeight = height(left);
+        size_t rightHeight = height(right);
+        if (leftHeight >= rightHeight) {
+            root = join(left, right, leftHeight - rightHeight, true);
+        } else {
+            root = join(right, left, rightHeight - leftHeight, false);
+        }
+    }
+
+    T take(size_t index) {
+        T value = takeFrom(root, index);
+        while (!root->leaf && root->children.size() == 1) {
+            Node *child = root->children.front();
+            root->children.clear();
+            delete root;
+            root = child;
+        }
+        return value;
+    }
+
+    void erase(size_t index) {
+        take(index);
+    }
+
+    void clear() {
+        destroy(root);
+        root = new Node(true);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(firstLeaf(), 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator();
+    }
+
+    const_iterator iteratorAt(size_t index) const {
+        if (index >= size()) {
+            return end();
+        }
+        Node *leaf = leafAt(index);
+        return const_iterator(leaf, index);
+    }
+};
+
+#endif //TEXT_EDITOR_ROPE_H
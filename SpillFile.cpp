@@ -0,0 +1,166 @@
+#include "SpillFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "Compression.h"
+
+SpillFile::SpillFile() : fd(-1), size(0), deadBytes(0) {}
+
+SpillFile::~SpillFile() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool SpillFile::create() {
+    const char *directory = std::getenv("TMPDIR");
+    std::string path = std::string(directory && *directory ? directory : "/tmp") + "/text_editor_spill_XXXXXX";
+    fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        return false;
+    }
+    unlink(path.c_str());
+    return true;
+}
+
+bool SpillFile::append(const char *data, size_t length, uint64_t &offset) {
+    if (fd < 0 && !create()) {
+        return false;
+    }
+    size_t done = 0;
+    while (done < length) {
+        ssize_t written = pwrite(fd, data + done, length - done, size + done);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        done += written;
+    }
+    offset = size;
+    size += length;
+    return true;
+}
+
+bool SpillFile::read(uint64_t offset, char *out, size_t length) const {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t got = pread(fd, out + done, length - done, offset + done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        done += got;
+    }
+    return true;
+}
+
+bool SpillFile::transfer(const SpillFile &source, uint64_t offset, size_t length, uint64_t &at) {
+    std::string buffer(std::min<size_t>(length, SPILL_CHUNK_BYTES), '\0');
+    at = size;
+    for (size_t done = 0; done < length;) {
+        size_t part = std::min(length - done, buffer.size());
+        uint64_t written;
+        if (!source.read(offset + done, &buffer[0], part) || !append(buffer.data(), part, written)) {
+            return false;
+        }
+        done += part;
+    }
+    return true;
+}
+
+void SpillFile::clear() {
+    if (fd >= 0 && size > 0 && ftruncate(fd, 0) == 0) {
+        size = 0;
+        deadBytes = 0;
+    }
+}
+
+SpillWriter::SpillWriter(SpillFile &target)
+        : file(target), offset(target.getSize()), size(0), rawSize(0), failed(false) {}
+
+void SpillWriter::flush() {
+    if (chunk.empty() || failed) {
+        return;
+    }
+    compressLz(chunk.data(), chunk.size(), packed);
+    uint32_t header[2] = {static_cast<uint32_t>(chunk.size()), static_cast<uint32_t>(packed.size())};
+    uint64_t at;
+    failed = !file.append(reinterpret_cast<const char *>(header), sizeof(header), at) ||
+             !file.append(packed.data(), packed.size(), at);
+    size += sizeof(header) + packed.size();
+    chunk.clear();
+}
+
+void SpillWriter::append(const void *data, size_t length) {
+    const char *bytes = static_cast<const char *>(data);
+    rawSize += length;
+    while (length > 0) {
+        size_t part = std::min(length, SPILL_CHUNK_BYTES - chunk.size());
+        chunk.append(bytes, part);
+        bytes += part;
+        length -= part;
+        if (chunk.size() == SPILL_CHUNK_BYTES) {
+            flush();
+        }
+    }
+}
+
+bool SpillWriter::finish(uint64_t &start, size_t &length) {
+    flush();
+    start = offset;
+    length = size;
+    return !failed;
+}
+
+SpillReader::SpillReader(const SpillFile &source, uint64_t start, size_t length)
+        : file(source), offset(start), end(start + length), cursor(0) {}
+
+bool SpillReader::refill() {
+    uint32_t header[2];
+    if (end - offset < sizeof(header) || !file.read(offset, reinterpret_cast<char *>(header), sizeof(header)) ||
+        end - offset - sizeof(header) < header[1]) {
+        return false;
+    }
+    packed.resize(header[1]);
+    chunk.resize(header[0]);
+    cursor = 0;
+    if (!file.read(offset + sizeof(header), &packed[0], packed.size()) ||
+        !decompressLz(packed.data(), packed.size(), &chunk[0], chunk.size())) {
+        return false;
+    }
+    offset += sizeof(header) + header[1];
+    return true;
+}
+
+bool SpillReader::read(void *out, size_t length) {
+    char *target = static_cast<char *>(out);
+    while (length > 0) {
+        if (cursor == chunk.size() && !refill()) {
+            return false;
+        }
+        size_t part = std::min(length, chunk.size() - cursor);
+        std::memcpy(target, chunk.data() + cursor, part);
+        cursor += part;
+        target += part;
+        length -= part;
+    }
+    return true;
+}
+
+bool SpillReader::view(size_t length, const char *&at) {
+    if (chunk.size() - cursor >= length) {
+        at = chunk.data() + cursor;
+        cursor += length;
+        return true;
+    }
+    scratch.resize(length);
+    at = scratch.data();
+    return read(&scratch[0], length);
+}
@@ -0,0 +1,127 @@
+#ifndef TEXT_EDITOR_SPILLFILE_H
+#define TEXT_EDITOR_SPILLFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#define SPILL_CHUNK_BYTES (1 << 20)
+
+// Append-only scratch file for data paged out of memory. It is created in
+// $TMPDIR (or /tmp) on first use and unlinked right away, so nothing is
+// left behind when the process exits. Objects that are no longer needed
+// are released; their bytes stay in the file until its owner copies the
+// live objects to a fresh file.
+class SpillFile {
+private:
+    int fd;
+    uint64_t size;
+    uint64_t deadBytes;
+
+    bool create();
+
+public:
+    SpillFile();
+    ~SpillFile();
+
+    SpillFile(const SpillFile &) = delete;
+    SpillFile &operator=(const SpillFile &) = delete;
+
+    // Writes `length` bytes at the end of the file and reports where.
+    bool append(const char *data, size_t length, uint64_t &offset);
+    bool read(uint64_t offset, char *out, size_t length) const;
+
+    // Copies `length` bytes at `offset` of `source` to the end of this file.
+    bool transfer(const SpillFile &source, uint64_t offset, size_t length, uint64_t &at);
+
+    void release(size_t length) {
+        deadBytes += length;
+    }
+
+    // Drops everything written so far and returns the space.
+    void clear();
+
+    void swap(SpillFile &other) {
+        std::swap(fd, other.fd);
+        std::swap(size, other.size);
+        std::swap(deadBytes, other.deadBytes);
+    }
+
+    uint64_t getSize() const {
+        return size;
+    }
+
+    uint64_t getDeadBytes() const {
+        return deadBytes;
+    }
+};
+
+// Streams a spilled object into a SpillFile, compressing it in chunks of
+// SPILL_CHUNK_BYTES so that spilling a large object never holds more than
+// one chunk of it twice. Each chunk is stored as its raw and compressed
+// sizes followed by the compressed bytes.
+class SpillWriter {
+private:
+    SpillFile &file;
+    std::string chunk;
+    std::string packed;
+    uint64_t offset;
+    size_t size;
+    size_t rawSize;
+    bool failed;
+
+    void flush();
+
+public:
+    explicit SpillWriter(SpillFile &target);
+
+    void append(const void *data, size_t length);
+
+    template <typename T>
+    void value(T data) {
+        append(&data, sizeof(data));
+    }
+
+    // Writes the last chunk and reports where the object starts and how
+    // many bytes it takes in the file; false if any write failed.
+    bool finish(uint64_t &start, size_t &length);
+
+    size_t getRawSize() const {
+        return rawSize;
+    }
+};
+
+// Reads an object written by SpillWriter back one chunk at a time.
+class SpillReader {
+private:
+    const SpillFile &file;
+    uint64_t offset;
+    uint64_t end;
+    std::string chunk;
+    std::string packed;
+    std::string scratch;
+    size_t cursor;
+
+    bool refill();
+
+public:
+    SpillReader(const SpillFile &source, uint64_t start, size_t length);
+
+    bool read(void *out, size_t length);
+
+    template <typename T>
+    bool value(T &data) {
+        return read(&data, sizeof(data));
+    }
+
+    // Points `at` to the next `length` bytes, which stay valid until the
+    // next call.
+    bool view(size_t length, const char *&at);
+
+    bool atEnd() const {
+        return cursor == chunk.size() && offset == end;
+    }
+};
+
+#endif //TEXT_EDITOR_SPILLFILE_H
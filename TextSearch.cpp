@@ -0,0 +1,241 @@
+#include "TextSearch.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TEXT_SEARCH_X86 1
+#endif
+
+namespace {
+
+bool isWordByte(unsigned char c) {
+    return std::isalnum(c) || c == '_';
+}
+
+unsigned char foldBit(unsigned char c) {
+    return std::isalpha(c) ? 0x20 : 0;
+}
+
+// Rough order of byte frequency in prose, source code and logs, most
+// frequent first. Bytes not listed are taken to be rarer than all of these,
+// except non-ASCII ones, which rank with the upper-case letters.
+const char frequencyOrder[] = " etaoinsrlhdcumpfgywb.v,k0-1_2=:3\n5)(4\"986/7x'qj;zTSIEARNCOLDMPBFUGHWKVYJXQZ[]{}<>*+#@$%&!?|\\^`~\t";
+
+size_t byteFrequency(unsigned char c) {
+    const char *at = c >= 0x80 ? std::strchr(frequencyOrder, 'T') : c ? std::strchr(frequencyOrder, c) : nullptr;
+    return at ? sizeof(frequencyOrder) - (at - frequencyOrder) : 0;
+}
+
+// Candidate filter shared by the vector scanners: a position is checked in
+// full only if the pattern bytes at offset1 and offset2 match. With
+// ignoreCase, letters are compared with the case bit forced on, which can
+// only add candidates, never drop one.
+struct Filter {
+    const TextSearch *search;
+    size_t m;
+    size_t offset1;
+    size_t offset2;
+    char byte1;
+    char byte2;
+    char fold1;
+    char fold2;
+    // The filter alone is exact for short case-sensitive patterns.
+    bool exact;
+};
+
+typedef size_t (*Scanner)(const Filter &, const char *, size_t, std::vector<size_t> &);
+
+size_t scalarScan(const Filter &, const char *, size_t, std::vector<size_t> &) {
+    return 0;
+}
+
+#ifdef TEXT_SEARCH_X86
+void verifyMask(const Filter &filter, const char *text, size_t len, size_t base, unsigned mask,
+                std::vector<size_t> &positions) {
+    while (mask) {
+        size_t pos = base + __builtin_ctz(mask);
+        if (filter.exact || filter.search->matchesAt(text, len, pos)) {
+            positions.push_back(pos);
+        }
+        mask &= mask - 1;
+    }
+}
+
+struct Sse2Filter {
+    __m128i byte1, byte2, fold1, fold2;
+
+    explicit Sse2Filter(const Filter &filter)
+            : byte1(_mm_set1_epi8(filter.byte1)), byte2(_mm_set1_epi8(filter.byte2)),
+              fold1(_mm_set1_epi8(filter.fold1)), fold2(_mm_set1_epi8(filter.fold2)) {}
+
+    // Lanes of the 16 positions from `at` that pass the filter; at1 and at2
+    // are `at` plus the filter's offsets.
+    __m128i candidates(const char *at1, const char *at2) const {
+        __m128i a = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(at1)), fold1);
+        __m128i b = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(at2)), fold2);
+        return _mm_and_si128(_mm_cmpeq_epi8(a, byte1), _mm_cmpeq_epi8(b, byte2));
+    }
+};
+
+struct Avx2Filter {
+    __m256i byte1, byte2, fold1, fold2;
+
+    __attribute__((target("avx2")))
+    explicit Avx2Filter(const Filter &filter)
+            : byte1(_mm256_set1_epi8(filter.byte1)), byte2(_mm256_set1_epi8(filter.byte2)),
+              fold1(_mm256_set1_epi8(filter.fold1)), fold2(_mm256_set1_epi8(filter.fold2)) {}
+
+    __attribute__((target("avx2")))
+    __m256i candidates(const char *at1, const char *at2) const {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(at1)), fold1);
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(at2)), fold2);
+        return _mm256_and_si256(_mm256_cmpeq_epi8(a, byte1), _mm256_cmpeq_epi8(b, byte2));
+    }
+};
+
+// Every scanner covers all candidate positions when there are at least as
+// many as its vector width. The main loop filters two vectors per round
+// and costs one branch when neither has a candidate; the last block is
+// re-aligned to end exactly at the final candidate and lanes already
+// scanned are masked off. Shorter inputs fall through to the next narrower
+// scanner.
+size_t sse2Scan(const Filter &filter, const char *text, size_t len, std::vector<size_t> &positions) {
+    const size_t end = len - filter.m + 1;
+    if (end < 16) {
+        return 0;
+    }
+    const Sse2Filter vector(filter);
+    const char *text1 = text + filter.offset1;
+    const char *text2 = text + filter.offset2;
+    size_t i = 0;
+    for (; i + 32 <= end; i += 32) {
+        __m128i low = vector.candidates(text1 + i, text2 + i);
+        __m128i high = vector.candidates(text1 + i + 16, text2 + i + 16);
+        if (_mm_movemask_epi8(_mm_or_si128(low, high))) {
+            verifyMask(filter, text, len, i, _mm_movemask_epi8(low), positions);
+            verifyMask(filter, text, len, i + 16, _mm_movemask_epi8(high), positions);
+        }
+    }
+    while (i < end) {
+        size_t base = std::min(i, end - 16);
+        unsigned mask = _mm_movemask_epi8(vector.candidates(text1 + base, text2 + base));
+        verifyMask(filter, text, len, base, mask & (~0u << (i - base)), positions);
+        i = base + 16;
+    }
+    return end;
+}
+
+__attribute__((target("avx2")))
+size_t avx2Scan(const Filter &filter, const char *text, size_t len, std::vector<size_t> &positions) {
+    const size_t end = len - filter.m + 1;
+    if (end < 32) {
+        return sse2Scan(filter, text, len, positions);
+    }
+    const Avx2Filter vector(filter);
+    const char *text1 = text + filter.offset1;
+    const char *text2 = text + filter.offset2;
+    size_t i = 0;
+    for (; i + 64 <= end; i += 64) {
+        __m256i low = vector.candidates(text1 + i, text2 + i);
+        __m256i high = vector.candidates(text1 + i + 32, text2 + i + 32);
+        __m256i any = _mm256_or_si256(low, high);
+        if (!_mm256_testz_si256(any, any)) {
+            verifyMask(filter, text, len, i, _mm256_movemask_epi8(low), positions);
+            verifyMask(filter, text, len, i + 32, _mm256_movemask_epi8(high), positions);
+        }
+    }
+    while (i < end) {
+        size_t base = std::min(i, end - 32);
+        unsigned mask = _mm256_movemask_epi8(vector.candidates(text1 + base, text2 + base));
+        verifyMask(filter, text, len, base, mask & (~0u << (i - base)), positions);
+        i = base + 32;
+    }
+    return end;
+}
+#endif
+
+Scanner selectScanner() {
+#ifdef TEXT_SEARCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2Scan;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return sse2Scan;
+    }
+#endif
+    return scalarScan;
+}
+
+}
+
+TextSearch::TextSearch(const char *needle, size_t needleLength, const SearchOptions &options)
+        : pattern(needle, needleLength), ignoreCase(options.ignoreCase), wholeWord(options.wholeWord),
+          rareOffset(0), otherOffset(0), rareFold(0), otherFold(0) {
+    if (ignoreCase) {
+        for (char &c : pattern) {
+            c = std::tolower(static_cast<unsigned char>(c));
+        }
+    }
+    if (pattern.empty()) {
+        return;
+    }
+    // The rarest byte, then the rarest of the other byte values; a pattern
+    // of one repeated byte pairs its first and last.
+    for (size_t i = 1; i < pattern.size(); ++i) {
+        if (byteFrequency(pattern[i]) < byteFrequency(pattern[rareOffset])) {
+            rareOffset = i;
+        }
+    }
+    otherOffset = rareOffset == 0 ? pattern.size() - 1 : 0;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != pattern[rareOffset] &&
+            (pattern[otherOffset] == pattern[rareOffset] ||
+             byteFrequency(pattern[i]) < byteFrequency(pattern[otherOffset]))) {
+            otherOffset = i;
+        }
+    }
+    if (ignoreCase) {
+        rareFold = foldBit(pattern[rareOffset]);
+        otherFold = foldBit(pattern[otherOffset]);
+    }
+}
+
+bool TextSearch::matchesAt(const char *text, size_t len, size_t pos) const {
+    size_t m = pattern.size();
+    if (ignoreCase) {
+        for (size_t i = 0; i < m; ++i) {
+            if (std::tolower(static_cast<unsigned char>(text[pos + i])) != static_cast<unsigned char>(pattern[i])) {
+                return false;
+            }
+        }
+    } else if (std::memcmp(text + pos, pattern.data(), m) != 0) {
+        return false;
+    }
+    if (wholeWord) {
+        if (pos > 0 && isWordByte(text[pos - 1])) {
+            return false;
+        }
+        if (pos + m < len && isWordByte(text[pos + m])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TextSearch::findAll(const char *text, size_t len, std::vector<size_t> &positions) const {
+    static const Scanner scanner = selectScanner();
+    size_t m = pattern.size();
+    if (m == 0 || len < m) {
+        return;
+    }
+    Filter filter = {this, m, rareOffset, otherOffset, pattern[rareOffset], pattern[otherOffset],
+                     static_cast<char>(rareFold), static_cast<char>(otherFold), m <= 2 && !ignoreCase && !wholeWord};
+    for (size_t i = scanner(filter, text, len, positions); i + m <= len; ++i) {
+        if (static_cast<char>(text[i + rareOffset] | filter.fold1) == filter.byte1 && matchesAt(text, len, i)) {
+            positions.push_back(i);
+        }
+    }
+}
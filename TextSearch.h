@@ -0,0 +1,55 @@
+#ifndef TEXT_EDITOR_TEXTSEARCH_H
+#define TEXT_EDITOR_TEXTSEARCH_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct SearchMatch {
+    size_t line;
+    size_t pos;
+};
+
+struct SearchOptions {
+    bool ignoreCase;
+    bool wholeWord;
+    // Worker threads for document-wide searches; 0 uses every core, 1
+    // searches on the calling thread.
+    size_t threads;
+
+    SearchOptions() : ignoreCase(false), wholeWord(false), threads(1) {}
+};
+
+// Substring matcher over length-delimited text. Candidate positions come
+// from a SIMD filter on two bytes of the pattern (AVX2 or SSE2, picked at
+// runtime) and are then verified in full. The two bytes are the ones
+// rarest in typical text, so common letters at the pattern's ends do not
+// flood the verifier. Matches may overlap, like a strstr loop restarted at
+// pos + 1.
+class TextSearch {
+private:
+    std::string pattern;
+    bool ignoreCase;
+    bool wholeWord;
+    // Offsets in the pattern of the filtered bytes, rarer first, and the
+    // case bit forced on each with ignoreCase.
+    size_t rareOffset;
+    size_t otherOffset;
+    unsigned char rareFold;
+    unsigned char otherFold;
+
+public:
+    TextSearch(const char *needle, size_t needleLength, const SearchOptions &options);
+
+    size_t getPatternLength() const {
+        return pattern.size();
+    }
+
+    // Full check of a candidate at text[pos], including word boundaries.
+    bool matchesAt(const char *text, size_t len, size_t pos) const;
+
+    // Appends every match position in text[0, len) to `positions`.
+    void findAll(const char *text, size_t len, std::vector<size_t> &positions) const;
+};
+
+#endif //TEXT_EDITOR_TEXTSEARCH_H
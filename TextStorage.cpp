@@ -0,0 +1,1908 @@
+#include "TextStorage.h"
+#include "AtomicFileWriter.h"
+#include "GatherWriter.h"
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <unistd.h>
+
+EditStep TextStorage::textStep(size_t lineIndex, size_t pos, size_t len, const char *text, size_t textLength) {
+    EditStep step;
+    step.kind = EditStep::TEXT;
+    step.line = lineIndex;
+    step.pos = pos;
+    step.span = len;
+    step.text.assign(text, textLength);
+    return step;
+}
+
+EditStep TextStorage::linesStep(size_t lineIndex, size_t count, LineBuffer &&content) {
+    EditStep step;
+    step.kind = EditStep::LINES;
+    step.line = lineIndex;
+    step.pos = 0;
+    step.span = count;
+    step.lines.reset(new LineBuffer(std::move(content)));
+    return step;
+}
+
+void TextStorage::applyStep(EditStep &step) {
+    if (step.kind == EditStep::TEXT) {
+        lines.update(step.line, [this, &step](Line &line) {
+            std::string current(line.getText() + step.pos, step.span);
+            line.replaceText(step.pos, step.span, step.text.data(), step.text.size(), arena);
+            step.span = step.text.size();
+            step.text.swap(current);
+        });
+        return;
+    }
+    LineBuffer &stash = *step.lines;
+    size_t stashed = stash.size();
+    if (step.line == 0 && step.span == lines.size()) {
+        std::swap(lines, stash);
+    } else {
+        LineBuffer current;
+        for (size_t i = 0; i < step.span; ++i) {
+            current.push_back(lines.take(step.line));
+        }
+        for (size_t i = 0; i < stashed; ++i) {
+            lines.insert(step.line + i, stash.take(0));
+        }
+        std::swap(current, stash);
+    }
+    step.span = stashed;
+}
+
+void TextStorage::commit(EditRecord &&record) {
+    if (journal->isOpen()) {
+        checkMappings();
+        journalSteps(record, false);
+    }
+    for (EditStep &step : record) {
+        INSTRUMENT_BYTES(step.kind == EditStep::TEXT ? step.text.size() : step.lines->weight());
+        applyStep(step);
+        internStep(step, record.size() > 1);
+    }
+    remember(std::move(record));
+}
+
+void TextStorage::internStep(const EditStep &step, bool bulk) {
+    if (!interning) {
+        return;
+    }
+    if (step.kind == EditStep::LINES) {
+        internLines(step.line, step.span);
+    } else if (bulk) {
+        internLines(step.line, 1);
+    }
+}
+
+void TextStorage::internLines(size_t first, size_t count) {
+    LineBuffer::const_iterator it = lines.iteratorAt(first);
+    for (size_t i = first; i < first + count; ++i, ++it) {
+        if (!it->isBorrowed() && !it->isInline() && !it->isShared()) {
+            lines.update(i, [this](Line &line) {
+                linePool.intern(line);
+            });
+        }
+    }
+}
+
+void TextStorage::remember(EditRecord &&record) {
+    while (!redoStack.empty()) {
+        dropHistory(redoStack, false);
+    }
+    editCount++;
+    if (historyLimit == 0) {
+        return;
+    }
+    pushHistory(undoStack, std::move(record));
+    while (undoStack.size() > historyLimit) {
+        dropHistory(undoStack, true);
+    }
+    enforceHistoryBudget();
+}
+
+bool TextStorage::stepFits(const EditStep &step) const {
+    if (step.kind == EditStep::LINES) {
+        return step.line <= lines.size() && step.span <= lines.size() - step.line;
+    }
+    if (step.line >= lines.size()) {
+        return false;
+    }
+    size_t length = lines[step.line].getTextLength();
+    return step.pos <= length && step.span <= length - step.pos;
+}
+
+size_t TextStorage::recordBytes(const EditRecord &record) {
+    size_t bytes = sizeof(HistoryEntry) + record.capacity() * sizeof(EditStep);
+    for (const EditStep &step : record) {
+        bytes += step.text.capacity();
+        if (step.lines) {
+            bytes += sizeof(LineBuffer) + step.lines->size() * sizeof(Line);
+            for (const Line &line : *step.lines) {
+                bytes += line.isBorrowed() || line.isInline() ? 0 : line.getTextLength() + 1;
+            }
+        }
+    }
+    return bytes;
+}
+
+template <typename Writer>
+void TextStorage::serializeStep(const EditStep &step, Writer &out, bool byAddress) {
+    out.template value<uint8_t>(step.kind);
+    out.template value<uint64_t>(step.line);
+    out.template value<uint64_t>(step.pos);
+    out.template value<uint64_t>(step.span);
+    out.template value<uint64_t>(step.text.size());
+    out.append(step.text.data(), step.text.size());
+    if (step.kind != EditStep::LINES) {
+        return;
+    }
+    out.template value<uint64_t>(step.lines->size());
+    for (const Line &line : *step.lines) {
+        bool borrowed = byAddress && line.isBorrowed();
+        out.template value<uint8_t>(borrowed);
+        out.template value<uint64_t>(line.getTextLength());
+        if (borrowed) {
+            out.template value<uint64_t>(reinterpret_cast<uintptr_t>(line.getText()));
+        } else {
+            out.append(line.getText(), line.getTextLength());
+        }
+    }
+}
+
+void TextStorage::serializeRecord(const EditRecord &record, SpillWriter &out) {
+    out.value<uint64_t>(record.size());
+    for (const EditStep &step : record) {
+        serializeStep(step, out, true);
+    }
+}
+
+template <typename Reader>
+bool TextStorage::deserializeRecord(Reader &in, EditRecord &record) {
+    uint64_t steps;
+    if (!in.value(steps)) {
+        return false;
+    }
+    record.clear();
+    for (uint64_t i = 0; i < steps; ++i) {
+        uint8_t kind;
+        uint64_t line, pos, span, textLength;
+        const char *text;
+        if (!in.value(kind) || !in.value(line) || !in.value(pos) || !in.value(span) || !in.value(textLength) ||
+            !in.view(textLength, text)) {
+            return false;
+        }
+        EditStep step = textStep(line, pos, span, text, textLength);
+        if (kind == EditStep::LINES) {
+            step.kind = EditStep::LINES;
+            step.lines.reset(new LineBuffer());
+            uint64_t count;
+            if (!in.value(count)) {
+                return false;
+            }
+            for (uint64_t j = 0; j < count; ++j) {
+                uint8_t borrowed;
+                uint64_t length, address;
+                const char *bytes;
+                if (!in.value(borrowed) || !in.value(length)) {
+                    return false;
+                }
+                if (borrowed) {
+                    if (!in.value(address)) {
+                        return false;
+                    }
+                    step.lines->push_back(Line::borrow(reinterpret_cast<const char *>(address), length));
+                    continue;
+                }
+                if (!in.view(length, bytes)) {
+                    return false;
+                }
+                Line restored;
+                restored.replaceText(0, 0, bytes, length, arena);
+                step.lines->push_back(std::move(restored));
+            }
+        }
+        record.push_back(std::move(step));
+    }
+    return in.atEnd();
+}
+
+void TextStorage::pushHistory(std::deque<HistoryEntry> &stack, EditRecord &&record) {
+    size_t bytes = recordBytes(record);
+    stack.push_back({std::move(record), bytes, 0, 0, 0, {}});
+    residentHistoryBytes += bytes;
+}
+
+bool TextStorage::popHistory(std::deque<HistoryEntry> &stack, EditRecord &record) {
+    HistoryEntry &entry = stack.back();
+    if (entry.spilledSize) {
+        SpillReader reader(historySpill, entry.spillOffset, entry.spilledSize);
+        if (!deserializeRecord(reader, record)) {
+            std::cerr << "Error reading spilled history\n";
+            return false;
+        }
+    } else {
+        record = std::move(entry.record);
+    }
+    dropHistory(stack, false);
+    return true;
+}
+
+void TextStorage::dropHistory(std::deque<HistoryEntry> &stack, bool oldest) {
+    HistoryEntry &entry = oldest ? stack.front() : stack.back();
+    if (holdsLoad(entry)) {
+        loadStash = nullptr;
+    }
+    if (entry.spilledSize) {
+        spilledEntries--;
+        spilledBytes -= entry.spilledSize;
+        spilledRawBytes -= entry.rawSize;
+        historySpill.release(entry.spilledSize);
+    } else {
+        residentHistoryBytes -= entry.bytes;
+    }
+    if (oldest) {
+        stack.pop_front();
+    } else {
+        stack.pop_back();
+    }
+    if (spilledEntries == 0) {
+        historySpill.clear();
+    } else if (historySpill.getDeadBytes() > historySpill.getSize() - historySpill.getDeadBytes()) {
+        compactSpill();
+    }
+}
+
+void TextStorage::compactSpill() {
+    SpillFile compacted;
+    std::vector<uint64_t> offsets;
+    offsets.reserve(spilledEntries);
+    for (std::deque<HistoryEntry> *stack : {&undoStack, &redoStack}) {
+        for (const HistoryEntry &entry : *stack) {
+            uint64_t at;
+            if (!entry.spilledSize) {
+                continue;
+            }
+            if (!compacted.transfer(historySpill, entry.spillOffset, entry.spilledSize, at)) {
+                std::cerr << "Error compacting spilled history\n";
+                return;
+            }
+            offsets.push_back(at);
+        }
+    }
+    size_t i = 0;
+    for (std::deque<HistoryEntry> *stack : {&undoStack, &redoStack}) {
+        for (HistoryEntry &entry : *stack) {
+            if (entry.spilledSize) {
+                entry.spillOffset = offsets[i++];
+            }
+        }
+    }
+    historySpill.swap(compacted);
+}
+
+bool TextStorage::spill(HistoryEntry &entry) {
+    SpillWriter writer(historySpill);
+    serializeRecord(entry.record, writer);
+    uint64_t offset;
+    size_t size;
+    if (!writer.finish(offset, size)) {
+        return false;
+    }
+    size_t hint = 0;
+    for (const EditStep &step : entry.record) {
+        if (!step.lines) {
+            continue;
+        }
+        for (const Line &line : *step.lines) {
+            if (!line.isBorrowed()) {
+                continue;
+            }
+            hint = mappingOf(line.getText(), hint);
+            if (hint < mappedFiles.size() &&
+                std::find(entry.mappings.begin(), entry.mappings.end(), mappedFiles[hint]) == entry.mappings.end()) {
+                entry.mappings.push_back(mappedFiles[hint]);
+            }
+        }
+    }
+    EditRecord().swap(entry.record);
+    residentHistoryBytes -= entry.bytes;
+    entry.spillOffset = offset;
+    entry.spilledSize = size;
+    entry.rawSize = writer.getRawSize();
+    spilledEntries++;
+    spilledBytes += size;
+    spilledRawBytes += entry.rawSize;
+    return true;
+}
+
+void TextStorage::journalSteps(const EditRecord &record, bool reversed) {
+    journalRecord.clear();
+    ByteWriter out(journalRecord);
+    out.value<uint64_t>(record.size());
+    for (size_t i = 0; i < record.size(); ++i) {
+        serializeStep(record[reversed ? record.size() - 1 - i : i], out, false);
+    }
+    journal->append(journalRecord.data(), journalRecord.size());
+    if (journalRecord.capacity() > JOURNAL_KEEP_BYTES) {
+        std::string().swap(journalRecord);
+    }
+}
+
+bool TextStorage::replayJournal(const char *data, size_t length) {
+    ByteReader in(data, length);
+    EditRecord record;
+    if (!deserializeRecord(in, record)) {
+        return false;
+    }
+    size_t applied = 0;
+    while (applied < record.size() && stepFits(record[applied])) {
+        applyStep(record[applied++]);
+    }
+    if (applied < record.size()) {
+        while (applied-- > 0) {
+            applyStep(record[applied]);
+        }
+        return false;
+    }
+    remember(std::move(record));
+    return true;
+}
+
+void TextStorage::startJournal(const char *filename, bool recover) {
+    journal->close(true);
+    JournalBase base;
+    if (!JournalBase::of(filename, base)) {
+        return;
+    }
+    std::string path = std::string(filename) + ".journal";
+    for (const std::unique_ptr<Document> &document : documents) {
+        if (document->journal->isOpen() && document->journal->getPath() == path) {
+            std::cerr << "Another open document keeps the edit journal of " << filename << "\n";
+            return;
+        }
+    }
+    JournalBase logged;
+    uint64_t validLength;
+    size_t replayed = 0;
+    bool intact = true;
+    bool found = recover && EditJournal::read(path, logged, [&](const char *data, size_t length) {
+        intact = logged == base && replayJournal(data, length);
+        replayed += intact;
+        return intact;
+    }, validLength);
+    if (found && !(logged == base)) {
+        std::string stale = path + ".stale";
+        std::rename(path.c_str(), stale.c_str());
+        std::cerr << "Edit journal does not match " << filename << ", kept as " << stale << "\n";
+    } else if (found) {
+        if (!intact) {
+            std::cerr << "Edit journal is damaged after " << replayed << " edits, the rest is dropped\n";
+        }
+        if (replayed) {
+            std::cout << "Recovered " << replayed << " edits from " << path << "\n";
+        }
+        if (!journal->resume(path, validLength)) {
+            std::cerr << "Error opening edit journal " << path << "\n";
+        }
+        return;
+    }
+    if (!journal->create(path, base)) {
+        std::cerr << "Error creating edit journal " << path << "\n";
+    }
+}
+
+void TextStorage::enforceHistoryBudget() {
+    for (std::deque<HistoryEntry> *stack : {&undoStack, &redoStack}) {
+        for (HistoryEntry &entry : *stack) {
+            if (residentHistoryBytes <= historyBudget) {
+                return;
+            }
+            if (!entry.spilledSize && !holdsLoad(entry) && !spill(entry)) {
+                std::cerr << "Error spilling history, keeping it in memory\n";
+                return;
+            }
+        }
+    }
+}
+
+SearchMatch TextStorage::BlockLocator::locate(const char *at) {
+    while (at > line->getText() + line->getTextLength()) {
+        ++line;
+        ++lineIndex;
+    }
+    return {lineIndex, static_cast<size_t>(at - line->getText())};
+}
+
+template <typename Scan>
+void TextStorage::scanBlocks(size_t first, size_t last, bool joinRuns, Scan scan) const {
+    LineBuffer::const_iterator it = lines.iteratorAt(first);
+    size_t i = first;
+    while (i < last) {
+        const char *start = it->getText();
+        const char *end = start + it->getTextLength();
+        LineBuffer::const_iterator next = it;
+        size_t runEnd = i + 1;
+        ++next;
+        while (joinRuns && it->isBorrowed() && runEnd < last && next->isBorrowed() &&
+               next->getText() == end + 1 && end - start < SEARCH_BLOCK_BYTES) {
+            end = next->getText() + next->getTextLength();
+            ++next;
+            ++runEnd;
+        }
+        BlockLocator locator = {it, i};
+        scan(start, static_cast<size_t>(end - start), locator);
+        it = next;
+        i = runEnd;
+    }
+}
+
+size_t TextStorage::shardCount(size_t threads) const {
+    threads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    return std::max<size_t>(1, std::min(threads, lines.size() / MIN_SEARCH_SHARD_LINES));
+}
+
+template <typename Search>
+void TextStorage::searchShards(size_t shards, Search search) const {
+    if (shards <= 1) {
+        search(0, 0, lines.size());
+        return;
+    }
+    std::vector<std::thread> workers;
+    size_t shardSize = (lines.size() + shards - 1) / shards;
+    for (size_t t = 0; t < shards; ++t) {
+        size_t first = std::min(t * shardSize, lines.size());
+        size_t last = std::min(first + shardSize, lines.size());
+        workers.emplace_back([&search, t, first, last]() {
+            search(t, first, last);
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void TextStorage::findInRange(const TextSearch &search, size_t first, size_t last, bool joinRuns,
+                              std::vector<SearchMatch> &matches) const {
+    std::vector<size_t> positions;
+    scanBlocks(first, last, joinRuns, [&](const char *block, size_t length, BlockLocator &locator) {
+        positions.clear();
+        search.findAll(block, length, positions);
+        for (size_t pos : positions) {
+            matches.push_back(locator.locate(block + pos));
+        }
+    });
+}
+
+bool TextStorage::lineAt(size_t offset, size_t &lineIndex, size_t &pos) const {
+    size_t rest = offset;
+    size_t index = lines.indexAtWeight(rest);
+    if (index >= lines.size()) {
+        return false;
+    }
+    checkLine(index);
+    lineIndex = index;
+    pos = rest;
+    return true;
+}
+
+bool TextStorage::rangeAt(size_t offset, size_t len, size_t &firstLine, size_t &firstPos, size_t &lastLine,
+                          size_t &lastPos) const {
+    if (offset + len >= lines.weight() || !lineAt(offset, firstLine, firstPos) ||
+        !lineAt(offset + len, lastLine, lastPos)) {
+        std::cerr << "Offset and length out of bounds\n";
+        return false;
+    }
+    if (!lines[firstLine].isCharBoundary(firstPos) || !lines[lastLine].isCharBoundary(lastPos)) {
+        std::cerr << "Offset splits a character\n";
+        return false;
+    }
+    return true;
+}
+
+void TextStorage::commitText(size_t lineIndex, size_t pos, size_t len, const char *text, size_t textLength) {
+    EditRecord record;
+    record.push_back(textStep(lineIndex, pos, len, text, textLength));
+    commit(std::move(record));
+}
+
+TextStorage::TextStorage() {
+    lines.push_back(Line());
+    loadStash = nullptr;
+    clipboard = nullptr;
+    historyLimit = DEFAULT_HISTORY_LIMIT;
+    historyBudget = DEFAULT_HISTORY_BUDGET;
+    residentHistoryBytes = 0;
+    spilledEntries = 0;
+    spilledBytes = 0;
+    spilledRawBytes = 0;
+    workerThreads = 0;
+    editCount = 0;
+    journal.reset(new EditJournal());
+    journaling = false;
+    journalGroupEdits = JOURNAL_GROUP_EDITS;
+    journalGroupInterval = JOURNAL_GROUP_INTERVAL_MS;
+    pageFirst = 0;
+    pageLines = PRINT_PAGE_LINES;
+    interning = false;
+    documents.emplace_back(new Document());
+    currentDocument = 0;
+}
+
+TextStorage::Document::Document()
+        : residentHistoryBytes(0), spilledEntries(0), spilledBytes(0), spilledRawBytes(0), editCount(0),
+          journal(new EditJournal()) {
+    lines.push_back(Line());
+}
+
+TextStorage::~TextStorage() {
+    asyncLoad.cancel();
+    journal->close(true);
+    for (std::unique_ptr<Document> &document : documents) {
+        document->journal->close(true);
+    }
+    if (clipboard) delete[] clipboard;
+}
+
+void TextStorage::setHistoryLimit(size_t limit) {
+    historyLimit = limit;
+    while (undoStack.size() > historyLimit) {
+        dropHistory(undoStack, true);
+    }
+}
+
+void TextStorage::setHistoryBudget(size_t bytes) {
+    historyBudget = bytes;
+    enforceHistoryBudget();
+}
+
+void TextStorage::setJournaling(bool enabled) {
+    journaling = enabled;
+    if (!enabled) {
+        journal->close(true);
+    }
+}
+
+void TextStorage::setInterning(bool enabled) {
+    interning = enabled;
+    if (enabled) {
+        internLines(0, lines.size());
+    } else {
+        linePool.clear();
+    }
+}
+
+void TextStorage::setJournalGroup(size_t edits, unsigned intervalMs) {
+    journalGroupEdits = edits;
+    journalGroupInterval = intervalMs;
+    journal->setGroup(edits, intervalMs);
+    for (std::unique_ptr<Document> &document : documents) {
+        document->journal->setGroup(edits, intervalMs);
+    }
+}
+
+void TextStorage::exchangeDocument(Document &parked) {
+    std::swap(lines, parked.lines);
+    undoStack.swap(parked.undoStack);
+    redoStack.swap(parked.redoStack);
+    historySpill.swap(parked.historySpill);
+    std::swap(residentHistoryBytes, parked.residentHistoryBytes);
+    std::swap(spilledEntries, parked.spilledEntries);
+    std::swap(spilledBytes, parked.spilledBytes);
+    std::swap(spilledRawBytes, parked.spilledRawBytes);
+    std::swap(editCount, parked.editCount);
+    journal.swap(parked.journal);
+    documentPath.swap(parked.path);
+}
+
+size_t TextStorage::newDocument(bool copyCurrent) {
+    waitForLoad();
+    documents.emplace_back(new Document());
+    Document &created = *documents.back();
+    created.journal->setGroup(journalGroupEdits, journalGroupInterval);
+    if (copyCurrent) {
+        created.lines = lines;
+    }
+    switchDocument(documents.size() - 1);
+    return currentDocument;
+}
+
+bool TextStorage::switchDocument(size_t index) {
+    if (index >= documents.size()) {
+        std::cerr << "Document index out of bounds\n";
+        return false;
+    }
+    waitForLoad();
+    exchangeDocument(*documents[currentDocument]);
+    exchangeDocument(*documents[index]);
+    currentDocument = index;
+    return true;
+}
+
+bool TextStorage::closeDocument() {
+    if (documents.size() == 1) {
+        std::cerr << "Cannot close the only open document\n";
+        return false;
+    }
+    asyncLoad.cancel();
+    journal->close(true);
+    size_t next = currentDocument ? currentDocument - 1 : 1;
+    exchangeDocument(*documents[next]);
+    std::swap(documents[next], documents[currentDocument]);
+    documents.erase(documents.begin() + currentDocument);
+    currentDocument = next < currentDocument ? next : next - 1;
+    releaseMappings();
+    return true;
+}
+
+void TextStorage::listDocuments() const {
+    for (size_t i = 0; i < documents.size(); ++i) {
+        bool current = i == currentDocument;
+        const LineBuffer &content = current ? lines : documents[i]->lines;
+        const std::string &path = current ? documentPath : documents[i]->path;
+        std::cout << (current ? "* " : "  ") << i << ": " << (path.empty() ? "(no file)" : path) << ", "
+                  << content.size() << " lines, " << content.weight() << " bytes, "
+                  << (current ? editCount : documents[i]->editCount) << " edits\n";
+    }
+}
+
+void TextStorage::appendText(size_t lineIndex, const char *text) {
+    INSTRUMENT_OPERATION(OP_APPEND_TEXT);
+    if (lineIndex >= lines.size()) {
+        std::cerr << "Line index out of bounds\n";
+        return;
+    }
+    checkLine(lineIndex);
+    commitText(lineIndex, lines[lineIndex].getTextLength(), 0, text, std::strlen(text));
+}
+
+void TextStorage::addNewLine() {
+    INSTRUMENT_OPERATION(OP_ADD_NEW_LINE);
+    LineBuffer newLine;
+    newLine.push_back(Line());
+    EditRecord record;
+    record.push_back(linesStep(lines.size(), 0, std::move(newLine)));
+    commit(std::move(record));
+}
+
+bool TextStorage::saveToFile(const char *filename) {
+    INSTRUMENT_OPERATION(OP_SAVE_TO_FILE);
+    waitForLoad();
+    AtomicFileWriter writer;
+    if (!writer.open(filename)) {
+        std::cerr << "Error opening file for writing\n";
+        return false;
+    }
+    checkMappings();
+    bool written = true;
+    LineBuffer::const_iterator it = lines.begin();
+    while (written && it != lines.end()) {
+        const char *start = it->getText();
+        const char *end = start + it->getTextLength();
+        const MappedFile *mapped = nullptr;
+        if (it->isBorrowed()) {
+            for (const std::shared_ptr<MappedFile> &file : mappedFiles) {
+                if (file->contains(start)) {
+                    mapped = file.get();
+                    break;
+                }
+            }
+        }
+        ++it;
+        if (!mapped) {
+            written = writer.append(start, end - start) && writer.append("\n", 1);
+            continue;
+        }
+        const char *mapEnd = mapped->getData() + mapped->getSize();
+        while (it != lines.end() && it->isBorrowed() && end < mapEnd && it->getText() == end + 1) {
+            end = it->getText() + it->getTextLength();
+            ++it;
+        }
+        bool hasNewline = end < mapEnd;
+        size_t length = end - start + hasNewline;
+        if (static_cast<size_t>(start - mapped->getData()) + length > mapped->getIntactSize()) {
+            std::cerr << "The document holds text lost when " << mapped->getPath()
+                      << " was truncated, edit or reload it before saving\n";
+            return false;
+        }
+        if (length >= MIN_COPY_RANGE_BYTES) {
+            written = writer.copyRange(mapped->getFd(), start - mapped->getData(), length, start);
+        } else {
+            written = writer.append(start, length);
+        }
+        if (written && !hasNewline) {
+            written = writer.append("\n", 1);
+        }
+    }
+    if (!written || !writer.commit()) {
+        std::cerr << "Error writing file\n";
+        return false;
+    }
+    INSTRUMENT_BYTES(writer.getBytesWritten() + writer.getBytesCopied());
+    std::cout << "Text has been saved successfully\n";
+    documentPath = filename;
+    if (journaling) {
+        startJournal(filename, false);
+    }
+    return true;
+}
+
+bool TextStorage::readFile(const char *filename, LineBuffer &loaded) {
+    std::shared_ptr<MappedFile> mapped = mapFile(filename);
+    if (mapped) {
+        AsyncLoad::index(mapped->getData(), mapped->getSize(), 0, mapped->getSize(), loaded);
+        return true;
+    }
+    std::ifstream inFile(filename);
+    if (!inFile) {
+        std::cerr << "Error opening file for reading\n";
+        return false;
+    }
+    std::string buffer;
+    while (std::getline(inFile, buffer)) {
+        if (interning) {
+            loaded.push_back(linePool.make(buffer.data(), buffer.size(), arena));
+            continue;
+        }
+        Line line;
+        line.replaceText(0, 0, buffer.data(), buffer.size(), arena);
+        loaded.push_back(std::move(line));
+    }
+    return true;
+}
+
+bool TextStorage::loadFromFile(const char *filename) {
+    INSTRUMENT_OPERATION(OP_LOAD_FROM_FILE);
+    asyncLoad.cancel();
+    LineBuffer loaded;
+    if (!readFile(filename, loaded)) {
+        return false;
+    }
+    INSTRUMENT_BYTES(loaded.weight());
+    journal->close(true);
+    EditRecord record;
+    record.push_back(linesStep(0, lines.size(), std::move(loaded)));
+    commit(std::move(record));
+    std::cout << "Text has been loaded successfully\n";
+    documentPath = filename;
+    if (journaling) {
+        startJournal(filename, true);
+    }
+    return true;
+}
+
+std::shared_ptr<MappedFile> TextStorage::mapFile(const char *filename) {
+    for (const std::shared_ptr<MappedFile> &file : mappedFiles) {
+        if (file->isSameFile(filename)) {
+            return file;
+        }
+    }
+    releaseMappings();
+    std::shared_ptr<MappedFile> mapped = std::make_shared<MappedFile>();
+    if (!mapped->open(filename)) {
+        return nullptr;
+    }
+    mappedFiles.push_back(mapped);
+    return mapped;
+}
+
+size_t TextStorage::mappingOf(const char *text, size_t hint) const {
+    if (hint < mappedFiles.size() && mappedFiles[hint]->contains(text)) {
+        return hint;
+    }
+    for (size_t i = 0; i < mappedFiles.size(); ++i) {
+        if (mappedFiles[i]->contains(text)) {
+            return i;
+        }
+    }
+    return mappedFiles.size();
+}
+
+void TextStorage::releaseMappings() {
+    if (mappedFiles.empty() || asyncLoad.isActive()) {
+        return;
+    }
+    std::vector<bool> used(mappedFiles.size());
+    size_t unused = 0;
+    for (size_t i = 0; i < mappedFiles.size(); ++i) {
+        used[i] = mappedFiles[i].use_count() > 1;
+        unused += !used[i];
+    }
+    size_t hint = 0;
+    auto mark = [&](const LineBuffer &buffer) {
+        for (LineBuffer::const_iterator it = buffer.begin(); unused && it != buffer.end(); ++it) {
+            if (!it->isBorrowed()) {
+                continue;
+            }
+            hint = mappingOf(it->getText(), hint);
+            if (hint < used.size() && !used[hint]) {
+                used[hint] = true;
+                unused--;
+            }
+        }
+    };
+    auto markHistory = [&](const std::deque<HistoryEntry> &stack) {
+        for (const HistoryEntry &entry : stack) {
+            for (const EditStep &step : entry.record) {
+                if (step.lines) {
+                    mark(*step.lines);
+                }
+            }
+        }
+    };
+    mark(lines);
+    markHistory(undoStack);
+    markHistory(redoStack);
+    for (const std::unique_ptr<Document> &document : documents) {
+        mark(document->lines);
+        markHistory(document->undoStack);
+        markHistory(document->redoStack);
+    }
+    if (unused == 0) {
+        return;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < mappedFiles.size(); ++i) {
+        if (used[i]) {
+            mappedFiles[kept++] = std::move(mappedFiles[i]);
+        }
+    }
+    mappedFiles.resize(kept);
+}
+
+bool TextStorage::checkMappings() const {
+    bool intact = true;
+    for (const std::shared_ptr<MappedFile> &file : mappedFiles) {
+        size_t lost = file->detachIfTruncated();
+        if (lost) {
+            std::cerr << file->getPath() << " was truncated by another program, the " << lost
+                      << " bytes of text borrowed from its end are lost\n";
+            intact = false;
+        }
+    }
+    return intact;
+}
+
+void TextStorage::checkLine(size_t lineIndex) const {
+    if (!mappedFiles.empty() && lines[lineIndex].isBorrowed()) {
+        checkMappings();
+    }
+}
+
+bool TextStorage::loadFromFileAsync(const char *filename) {
+    INSTRUMENT_OPERATION(OP_LOAD_FROM_FILE);
+    asyncLoad.cancel();
+    std::string journalPath = std::string(filename) + ".journal";
+    std::shared_ptr<MappedFile> mapped;
+    if ((journaling && access(journalPath.c_str(), F_OK) == 0) || !(mapped = mapFile(filename))) {
+        return loadFromFile(filename);
+    }
+    LineBuffer loaded;
+    size_t indexed = AsyncLoad::index(mapped->getData(), mapped->getSize(), 0, ASYNC_LOAD_FIRST_BYTES, loaded);
+    INSTRUMENT_BYTES(indexed);
+    journal->close(true);
+    EditRecord record;
+    record.push_back(linesStep(0, lines.size(), std::move(loaded)));
+    loadStash = record[0].lines.get();
+    if (indexed < mapped->getSize()) {
+        asyncLoad.start(mapped, indexed);
+    }
+    commit(std::move(record));
+    if (undoStack.empty() || !holdsLoad(undoStack.back())) {
+        loadStash = nullptr;
+    }
+    documentPath = filename;
+    if (asyncLoad.isActive()) {
+        std::cout << "Loading text in the background, " << lines.size() << " lines available\n";
+    } else {
+        std::cout << "Text has been loaded successfully\n";
+    }
+    if (journaling) {
+        startJournal(filename, false);
+    }
+    return true;
+}
+
+bool TextStorage::holdsLoad(const HistoryEntry &entry) const {
+    return loadStash && asyncLoad.isActive() && entry.record.size() == 1 &&
+           entry.record[0].lines.get() == loadStash;
+}
+
+void TextStorage::drainLoad(bool wait) {
+    size_t before = lines.size();
+    bool done = true;
+    if (wait) {
+        asyncLoad.finish(lines);
+    } else {
+        done = asyncLoad.drain(lines);
+    }
+    if (loadStash && lines.size() > before) {
+        for (auto it = undoStack.rbegin(); it != undoStack.rend(); ++it) {
+            if (it->record.size() == 1 && it->record[0].lines.get() == loadStash) {
+                it->record[0].span += lines.size() - before;
+                break;
+            }
+        }
+    }
+    if (done) {
+        loadStash = nullptr;
+        if (asyncLoad.wasTruncated()) {
+            std::cerr << "The file was truncated by another program while loading, " << lines.size()
+                      << " lines loaded\n";
+        } else {
+            std::cout << "Text has been loaded successfully\n";
+        }
+        enforceHistoryBudget();
+    }
+}
+
+void TextStorage::pollLoad() {
+    if (asyncLoad.isActive()) {
+        drainLoad(false);
+    }
+}
+
+void TextStorage::waitForLoad() {
+    if (asyncLoad.isActive()) {
+        drainLoad(true);
+    }
+}
+
+void TextStorage::printLoadProgress() const {
+    if (!asyncLoad.isActive()) {
+        std::cout << "No load in progress\n";
+        return;
+    }
+    size_t total = asyncLoad.getTotalBytes();
+    size_t indexed = asyncLoad.getIndexedBytes();
+    std::cout << "Loaded " << indexed << " of " << total << " bytes (" << indexed * 100 / total << "%), "
+              << lines.size() << " lines available\n";
+}
+
+bool TextStorage::historyState(size_t steps, LineBuffer &state) {
+    if (steps == 0 || steps > undoStack.size()) {
+        std::cerr << "Not enough undo steps\n";
+        return false;
+    }
+    // Spilled records are read back first, so a failed read changes nothing.
+    std::vector<EditRecord> pagedIn(steps);
+    std::vector<EditRecord *> records(steps);
+    for (size_t k = 0; k < steps; ++k) {
+        HistoryEntry &entry = undoStack[undoStack.size() - 1 - k];
+        records[k] = &entry.record;
+        if (entry.spilledSize) {
+            SpillReader reader(historySpill, entry.spillOffset, entry.spilledSize);
+            if (!deserializeRecord(reader, pagedIn[k])) {
+                std::cerr << "Error reading spilled history\n";
+                return false;
+            }
+            records[k] = &pagedIn[k];
+        }
+    }
+    for (EditRecord *record : records) {
+        for (size_t i = record->size(); i-- > 0;) {
+            applyStep((*record)[i]);
+        }
+    }
+    state = lines;
+    for (size_t k = steps; k-- > 0;) {
+        for (EditStep &step : *records[k]) {
+            applyStep(step);
+        }
+    }
+    return true;
+}
+
+bool TextStorage::diffWithFile(const char *filename) {
+    INSTRUMENT_OPERATION(OP_DIFF);
+    waitForLoad();
+    checkMappings();
+    LineBuffer file;
+    if (!readFile(filename, file)) {
+        return false;
+    }
+    INSTRUMENT_BYTES(file.weight());
+    std::vector<DiffChange> changes = diffLines(file, lines);
+    if (changes.empty()) {
+        std::cout << "No differences\n";
+        return true;
+    }
+    writeUnifiedDiff(file, lines, changes, filename, "(buffer)", std::cout);
+    std::cout.flush();
+    return true;
+}
+
+bool TextStorage::diffHistory(size_t steps) {
+    INSTRUMENT_OPERATION(OP_DIFF);
+    waitForLoad();
+    checkMappings();
+    LineBuffer state;
+    if (!historyState(steps, state)) {
+        return false;
+    }
+    std::vector<DiffChange> changes = diffLines(state, lines);
+    if (changes.empty()) {
+        std::cout << "No differences\n";
+        return true;
+    }
+    writeUnifiedDiff(state, lines, changes, "(undo " + std::to_string(steps) + ")", "(buffer)", std::cout);
+    std::cout.flush();
+    return true;
+}
+
+bool TextStorage::reloadFromFile(const char *filename) {
+    INSTRUMENT_OPERATION(OP_RELOAD_FROM_FILE);
+    std::string path = *filename ? filename : documentPath;
+    if (path.empty()) {
+        std::cerr << "No file to reload\n";
+        return false;
+    }
+    waitForLoad();
+    checkMappings();
+    LineBuffer loaded;
+    if (!readFile(path.c_str(), loaded)) {
+        return false;
+    }
+    INSTRUMENT_BYTES(loaded.weight());
+    // Steps apply in document order, so each hunk already sits where the
+    // file has it.
+    std::vector<DiffChange> changes = diffLines(lines, loaded);
+    EditRecord record;
+    size_t removed = 0, added = 0;
+    for (const DiffChange &change : changes) {
+        LineBuffer content;
+        LineBuffer::const_iterator it = loaded.iteratorAt(change.newFirst);
+        for (size_t i = 0; i < change.newCount; ++i, ++it) {
+            content.push_back(*it);
+        }
+        record.push_back(linesStep(change.newFirst, change.oldCount, std::move(content)));
+        removed += change.oldCount;
+        added += change.newCount;
+    }
+    journal->close(true);
+    if (!record.empty()) {
+        commit(std::move(record));
+    }
+    std::cout << "Reloaded " << path << ": " << changes.size() << " changed hunks, " << removed
+              << " lines removed, " << added << " lines added\n";
+    documentPath = path;
+    if (journaling) {
+        startJournal(path.c_str(), false);
+    }
+    return true;
+}
+
+void TextStorage::printText() const {
+    INSTRUMENT_OPERATION(OP_PRINT_TEXT);
+    checkMappings();
+    INSTRUMENT_BYTES(lines.weight());
+    std::string out;
+    out.reserve(std::min<size_t>(lines.weight(), WRITE_BATCH_BYTES) + 1);
+    for (const Line &line : lines) {
+        out.append(line.getText(), line.getTextLength());
+        out += '\n';
+        if (out.size() >= WRITE_BATCH_BYTES) {
+            std::cout.write(out.data(), out.size());
+            out.clear();
+        }
+    }
+    std::cout.write(out.data(), out.size()).flush();
+}
+
+bool TextStorage::writeText(int fd) const {
+    INSTRUMENT_OPERATION(OP_WRITE_TEXT);
+    checkMappings();
+    INSTRUMENT_BYTES(lines.weight());
+    std::cout.flush();
+    GatherWriter writer(fd);
+    bool written = true;
+    LineBuffer::const_iterator it = lines.begin();
+    while (written && it != lines.end()) {
+        const char *start = it->getText();
+        const char *end = start + it->getTextLength();
+        bool borrowed = it->isBorrowed();
+        ++it;
+        while (borrowed && it != lines.end() && it->isBorrowed() && it->getText() == end + 1) {
+            end = it->getText() + it->getTextLength();
+            ++it;
+        }
+        written = writer.append(start, end - start) && writer.append("\n", 1);
+    }
+    if (!written || !writer.flush()) {
+        std::cerr << "Error writing text\n";
+        return false;
+    }
+    return true;
+}
+
+void TextStorage::printRange(size_t first, size_t count) {
+    INSTRUMENT_OPERATION(OP_PRINT_RANGE);
+    checkMappings();
+    if (first >= lines.size()) {
+        std::cerr << "Line index out of bounds\n";
+        return;
+    }
+    if (count == 0) {
+        std::cerr << "Page size must be positive\n";
+        return;
+    }
+    pageFirst = first;
+    pageLines = count;
+    size_t last = first + std::min(count, lines.size() - first);
+    std::string out;
+    out.reserve(lines.weightBefore(last) - lines.weightBefore(first));
+    LineBuffer::const_iterator it = lines.iteratorAt(first);
+    for (size_t i = first; i < last; ++i, ++it) {
+        out.append(it->getText(), it->getTextLength());
+        out += '\n';
+    }
+    INSTRUMENT_BYTES(out.size());
+    std::cout.write(out.data(), out.size()).flush();
+}
+
+void TextStorage::printNextPage() {
+    if (pageFirst + pageLines >= lines.size()) {
+        std::cerr << "Already at the last page\n";
+        return;
+    }
+    printRange(pageFirst + pageLines, pageLines);
+}
+
+void TextStorage::printPreviousPage() {
+    if (pageFirst == 0) {
+        std::cerr << "Already at the first page\n";
+        return;
+    }
+    printRange(pageFirst - std::min(pageFirst, pageLines), pageLines);
+}
+
+void TextStorage::insertText(size_t lineIndex, size_t pos, const char *text) {
+    INSTRUMENT_OPERATION(OP_INSERT_TEXT);
+    if (lineIndex >= lines.size()) {
+        std::cerr << "Line index out of bounds\n";
+        return;
+    }
+    checkLine(lineIndex);
+    const Line &line = lines[lineIndex];
+    if (pos > line.getCharCount()) {
+        std::cerr << "Position out of bounds\n";
+        return;
+    }
+    commitText(lineIndex, line.byteOffsetOf(pos), 0, text, std::strlen(text));
+}
+
+std::vector<SearchMatch> TextStorage::findText(const char *substring, const SearchOptions &options) const {
+    INSTRUMENT_OPERATION(OP_FIND_TEXT);
+    checkMappings();
+    INSTRUMENT_BYTES(lines.weight());
+    TextSearch search(substring, std::strlen(substring), options);
+    bool joinRuns = std::strchr(substring, '\n') == nullptr;
+    std::vector<std::vector<SearchMatch>> shards(shardCount(options.threads));
+    searchShards(shards.size(), [&](size_t shard, size_t first, size_t last) {
+        findInRange(search, first, last, joinRuns, shards[shard]);
+    });
+    if (shards.size() == 1) {
+        return std::move(shards.front());
+    }
+    std::vector<SearchMatch> matches;
+    for (std::vector<SearchMatch> &shard : shards) {
+        matches.insert(matches.end(), shard.begin(), shard.end());
+    }
+    return matches;
+}
+
+std::vector<std::vector<SearchMatch>> TextStorage::findPatterns(const std::vector<std::string> &patterns,
+                                                                const SearchOptions &options) const {
+    INSTRUMENT_OPERATION(OP_FIND_PATTERNS);
+    checkMappings();
+    INSTRUMENT_BYTES(lines.weight());
+    MultiSearch search(patterns, options);
+    bool joinRuns = !search.matchesNewline();
+    std::vector<std::vector<std::vector<SearchMatch>>> shards(shardCount(options.threads));
+    searchShards(shards.size(), [&](size_t shard, size_t first, size_t last) {
+        std::vector<std::vector<SearchMatch>> &hits = shards[shard];
+        hits.resize(patterns.size());
+        std::vector<PatternMatch> found;
+        scanBlocks(first, last, joinRuns, [&](const char *block, size_t length, BlockLocator &locator) {
+            found.clear();
+            search.findAll(block, length, found);
+            // Matches come ordered by their end, which never lies past the
+            // end of the line the match starts on.
+            for (const PatternMatch &match : found) {
+                size_t patternLength = search.getPatternLength(match.pattern);
+                SearchMatch end = locator.locate(block + match.pos + patternLength);
+                hits[match.pattern].push_back({end.line, end.pos - patternLength});
+            }
+        });
+    });
+    if (shards.size() == 1) {
+        return std::move(shards.front());
+    }
+    std::vector<std::vector<SearchMatch>> hits(patterns.size());
+    for (std::vector<std::vector<SearchMatch>> &shard : shards) {
+        for (size_t p = 0; p < patterns.size(); ++p) {
+            hits[p].insert(hits[p].end(), shard[p].begin(), shard[p].end());
+        }
+    }
+    return hits;
+}
+
+void TextStorage::searchPatterns(const std::vector<std::string> &patterns, const SearchOptions &options) const {
+    std::vector<std::vector<SearchMatch>> hits = findPatterns(patterns, options);
+    for (size_t p = 0; p < patterns.size(); ++p) {
+        std::cout << "Pattern \"" << patterns[p] << "\": " << hits[p].size() << " matches\n";
+        for (const SearchMatch &match : hits[p]) {
+            std::cout << "Text is present in this position: " << match.line << " "
+                      << lines[match.line].columnOf(match.pos) << "\n";
+        }
+    }
+    std::cout.flush();
+}
+
+void TextStorage::searchText(const char *substring) const {
+    SearchOptions options;
+    options.threads = workerThreads;
+    searchText(substring, options);
+}
+
+void TextStorage::searchText(const char *substring, const SearchOptions &options) const {
+    std::vector<SearchMatch> matches = findText(substring, options);
+    for (const SearchMatch &match : matches) {
+        std::cout << "Text is present in this position: " << match.line << " "
+                  << lines[match.line].columnOf(match.pos) << "\n";
+    }
+    if (matches.empty()) {
+        std::cout << "Substring not found\n";
+    }
+    std::cout.flush();
+}
+
+size_t TextStorage::replaceAll(const char *pattern, const char *replacement, const SearchOptions &options) {
+    INSTRUMENT_OPERATION(OP_REPLACE_ALL);
+    waitForLoad();
+    checkMappings();
+    size_t patternLength = std::strlen(pattern);
+    if (patternLength == 0) {
+        std::cerr << "Pattern must not be empty\n";
+        return 0;
+    }
+    size_t replacementLength = std::strlen(replacement);
+    TextSearch search(pattern, patternLength, options);
+    bool joinRuns = std::strchr(pattern, '\n') == nullptr;
+    std::vector<EditRecord> shards(shardCount(options.threads));
+    std::vector<size_t> counts(shards.size(), 0);
+    searchShards(shards.size(), [&](size_t shard, size_t first, size_t last) {
+        std::vector<SearchMatch> matches;
+        findInRange(search, first, last, joinRuns, matches);
+        // One step per line, spanning its first to its last replacement.
+        size_t i = 0;
+        while (i < matches.size()) {
+            size_t lineIndex = matches[i].line;
+            const char *text = lines[lineIndex].getText();
+            size_t start = matches[i].pos;
+            size_t copied = start;
+            EditStep step = textStep(lineIndex, start, 0, "", 0);
+            for (; i < matches.size() && matches[i].line == lineIndex; ++i) {
+                if (matches[i].pos < copied) {
+                    continue;
+                }
+                step.text.append(text + copied, matches[i].pos - copied);
+                step.text.append(replacement, replacementLength);
+                copied = matches[i].pos + patternLength;
+                counts[shard]++;
+            }
+            step.span = copied - start;
+            shards[shard].push_back(std::move(step));
+        }
+    });
+    EditRecord record = std::move(shards.front());
+    size_t replaced = counts.front();
+    for (size_t t = 1; t < shards.size(); ++t) {
+        std::move(shards[t].begin(), shards[t].end(), std::back_inserter(record));
+        replaced += counts[t];
+    }
+    if (!record.empty()) {
+        commit(std::move(record));
+    }
+    return replaced;
+}
+
+bool TextStorage::applyEdits(std::vector<TextEdit> edits) {
+    INSTRUMENT_OPERATION(OP_APPLY_EDITS);
+    checkMappings();
+    std::stable_sort(edits.begin(), edits.end(), [](const TextEdit &a, const TextEdit &b) {
+        if (a.line != b.line) {
+            return a.line < b.line;
+        }
+        if (a.pos != b.pos) {
+            return a.pos < b.pos;
+        }
+        return a.len == 0 && b.len != 0;
+    });
+    for (size_t i = 0; i < edits.size(); ++i) {
+        TextEdit &edit = edits[i];
+        if (edit.line >= lines.size()) {
+            std::cerr << "Line index out of bounds: " << edit.line << "\n";
+            return false;
+        }
+        const Line &line = lines[edit.line];
+        size_t length = line.getCharCount();
+        if (edit.pos > length || edit.len > length - edit.pos) {
+            std::cerr << "Position and length out of bounds: " << edit.line << " " << edit.pos << "\n";
+            return false;
+        }
+        // Columns map to bytes in order, so overlaps are checked on bytes.
+        size_t end = line.byteOffsetOf(edit.pos + edit.len);
+        edit.pos = line.byteOffsetOf(edit.pos);
+        edit.len = end - edit.pos;
+        if (i > 0 && edits[i - 1].line == edit.line && edits[i - 1].pos + edits[i - 1].len > edit.pos) {
+            std::cerr << "Overlapping edits at: " << edit.line << " " << edit.pos << "\n";
+            return false;
+        }
+    }
+    EditRecord record;
+    size_t i = 0;
+    while (i < edits.size()) {
+        size_t lineIndex = edits[i].line;
+        const char *text = lines[lineIndex].getText();
+        size_t start = edits[i].pos;
+        size_t copied = start;
+        EditStep step = textStep(lineIndex, start, 0, "", 0);
+        for (; i < edits.size() && edits[i].line == lineIndex; ++i) {
+            step.text.append(text + copied, edits[i].pos - copied);
+            step.text += edits[i].text;
+            copied = edits[i].pos + edits[i].len;
+        }
+        step.span = copied - start;
+        record.push_back(std::move(step));
+    }
+    if (!record.empty()) {
+        commit(std::move(record));
+    }
+    return true;
+}
+
+void TextStorage::deleteText(size_t lineIndex, size_t pos, size_t len) {
+    INSTRUMENT_OPERATION(OP_DELETE_TEXT);
+    if (lineIndex >= lines.size()) {
+        std::cerr << "Line index out of bounds\n";
+        return;
+    }
+    checkLine(lineIndex);
+    const Line &line = lines[lineIndex];
+    size_t length = line.getCharCount();
+    if (pos >= length || pos + len > length) {
+        std::cerr << "Position and length out of bounds\n";
+        return;
+    }
+    size_t from = line.byteOffsetOf(pos);
+    commitText(lineIndex, from, line.byteOffsetOf(pos + len) - from, "", 0);
+}
+
+bool TextStorage::offsetToPosition(size_t offset, size_t &lineIndex, size_t &pos) const {
+    size_t index, bytePos;
+    if (!lineAt(offset, index, bytePos) || !lines[index].isCharBoundary(bytePos)) {
+        return false;
+    }
+    lineIndex = index;
+    pos = lines[index].columnOf(bytePos);
+    return true;
+}
+
+bool TextStorage::positionToOffset(size_t lineIndex, size_t pos, size_t &offset) const {
+    if (lineIndex >= lines.size()) {
+        return false;
+    }
+    checkLine(lineIndex);
+    if (pos > lines[lineIndex].getCharCount()) {
+        return false;
+    }
+    offset = lines.weightBefore(lineIndex) + lines[lineIndex].byteOffsetOf(pos);
+    return true;
+}
+
+void TextStorage::insertTextAt(size_t offset, const char *text) {
+    INSTRUMENT_OPERATION(OP_INSERT_TEXT);
+    size_t lineIndex, pos;
+    if (!lineAt(offset, lineIndex, pos)) {
+        std::cerr << "Offset out of bounds\n";
+        return;
+    }
+    if (!lines[lineIndex].isCharBoundary(pos)) {
+        std::cerr << "Offset splits a character\n";
+        return;
+    }
+    commitText(lineIndex, pos, 0, text, std::strlen(text));
+}
+
+void TextStorage::deleteTextAt(size_t offset, size_t len) {
+    INSTRUMENT_OPERATION(OP_DELETE_TEXT);
+    size_t firstLine, firstPos, lastLine, lastPos;
+    if (!rangeAt(offset, len, firstLine, firstPos, lastLine, lastPos)) {
+        return;
+    }
+    if (firstLine == lastLine) {
+        commitText(firstLine, firstPos, lastPos - firstPos, "", 0);
+        return;
+    }
+    // Joins the head of the first line with the tail of the last one and
+    // drops the lines in between.
+    const Line &first = lines[firstLine];
+    const Line &last = lines[lastLine];
+    EditRecord record;
+    record.push_back(textStep(firstLine, firstPos, first.getTextLength() - firstPos, last.getText() + lastPos,
+                              last.getTextLength() - lastPos));
+    record.push_back(linesStep(firstLine + 1, lastLine - firstLine, LineBuffer()));
+    commit(std::move(record));
+}
+
+bool TextStorage::textAt(size_t offset, size_t len, std::string &text) const {
+    checkMappings();
+    size_t firstLine, firstPos, lastLine, lastPos;
+    if (!rangeAt(offset, len, firstLine, firstPos, lastLine, lastPos)) {
+        return false;
+    }
+    text.clear();
+    text.reserve(len);
+    LineBuffer::const_iterator it = lines.iteratorAt(firstLine);
+    for (size_t i = firstLine; i <= lastLine; ++i, ++it) {
+        size_t from = i == firstLine ? firstPos : 0;
+        size_t to = i == lastLine ? lastPos : it->getTextLength();
+        text.append(it->getText() + from, to - from);
+        if (i != lastLine) {
+            text += '\n';
+        }
+    }
+    return true;
+}
+
+void TextStorage::copyTextAt(size_t offset, size_t len) {
+    INSTRUMENT_OPERATION(OP_COPY_TEXT);
+    std::string copied;
+    if (!textAt(offset, len, copied)) {
+        return;
+    }
+    if (clipboard) {
+        delete[] clipboard;
+    }
+    clipboard = new char[copied.size() + 1];
+    std::memcpy(clipboard, copied.c_str(), copied.size() + 1);
+}
+
+void TextStorage::cutTextAt(size_t offset, size_t len) {
+    INSTRUMENT_OPERATION(OP_CUT_TEXT);
+    size_t firstLine, firstPos, lastLine, lastPos;
+    if (!rangeAt(offset, len, firstLine, firstPos, lastLine, lastPos)) {
+        return;
+    }
+    copyTextAt(offset, len);
+    deleteTextAt(offset, len);
+}
+
+void TextStorage::pasteTextAt(size_t offset) {
+    INSTRUMENT_OPERATION(OP_PASTE_TEXT);
+    if (!clipboard) {
+        std::cerr << "Clipboard is empty\n";
+        return;
+    }
+    insertTextAt(offset, clipboard);
+}
+
+bool TextStorage::undo() {
+    INSTRUMENT_OPERATION(OP_UNDO);
+    if (undoStack.empty()) {
+        std::cerr << "No more undo steps available\n";
+        return false;
+    }
+    if (holdsLoad(undoStack.back())) {
+        waitForLoad();
+    }
+    EditRecord record;
+    if (!popHistory(undoStack, record)) {
+        return false;
+    }
+    if (journal->isOpen()) {
+        checkMappings();
+        journalSteps(record, true);
+    }
+    for (size_t i = record.size(); i-- > 0;) {
+        applyStep(record[i]);
+        internStep(record[i], record.size() > 1);
+    }
+    pushHistory(redoStack, std::move(record));
+    enforceHistoryBudget();
+    return true;
+}
+
+bool TextStorage::redo() {
+    INSTRUMENT_OPERATION(OP_REDO);
+    if (redoStack.empty()) {
+        std::cerr << "No more redo steps available\n";
+        return false;
+    }
+    EditRecord record;
+    if (!popHistory(redoStack, record)) {
+        return false;
+    }
+    if (journal->isOpen()) {
+        checkMappings();
+        journalSteps(record, false);
+    }
+    for (EditStep &step : record) {
+        applyStep(step);
+        internStep(step, record.size() > 1);
+    }
+    pushHistory(undoStack, std::move(record));
+    enforceHistoryBudget();
+    return true;
+}
+
+void TextStorage::cutText(size_t lineIndex, size_t pos, size_t len) {
+    INSTRUMENT_OPERATION(OP_CUT_TEXT);
+    if (lineIndex >= lines.size()) {
+        std::cerr << "Line index out of bounds\n";
+        return;
+    }
+    checkLine(lineIndex);
+
+    const Line &line = lines[lineIndex];
+    size_t length = line.getCharCount();
+    if (pos + len > length) {
+        std::cerr << "Position and length out of bounds\n";
+        return;
+    }
+    copyText(lineIndex, pos, len);
+    if (pos >= length) {
+        std::cerr << "Position and length out of bounds\n";
+        return;
+    }
+    size_t from = line.byteOffsetOf(pos);
+    commitText(lineIndex, from, line.byteOffsetOf(pos + len) - from, "", 0);
+}
+
+void TextStorage::pasteText(size_t lineIndex, size_t pos) {
+    INSTRUMENT_OPERATION(OP_PASTE_TEXT);
+    if (lineIndex >= lines.size()) {
+        std::cerr << "Line index out of bounds\n";
+        return;
+    }
+    checkLine(lineIndex);
+    if (!clipboard) {
+        std::cerr << "Clipboard is empty\n";
+        return;
+    }
+    const Line &line = lines[lineIndex];
+    if (pos > line.getCharCount()) {
+        std::cerr << "Position out of bounds\n";
+        return;
+    }
+    commitText(lineIndex, line.byteOffsetOf(pos), 0, clipboard, std::strlen(clipboard));
+}
+
+void TextStorage::copyText(size_t lineIndex, size_t pos, size_t len) {
+    INSTRUMENT_OPERATION(OP_COPY_TEXT);
+    if (lineIndex >= lines.size()) {
+        std::cerr << "Line index out of bounds\n";
+        return;
+    }
+    checkLine(lineIndex);
+    const Line &line = lines[lineIndex];
+    if (pos + len > line.getCharCount()) {
+        std::cerr << "Position and length out of bounds\n";
+        return;
+    }
+    size_t from = line.byteOffsetOf(pos);
+    size_t bytes = line.byteOffsetOf(pos + len) - from;
+    if (clipboard) {
+        delete[] clipboard;
+    }
+    clipboard = new char[bytes + 1];
+    std::strncpy(clipboard, line.getText() + from, bytes);
+    clipboard[bytes] = '\0';
+}
+
+void TextStorage::insertWithReplace(size_t lineIndex, size_t pos, const char *text) {
+    INSTRUMENT_OPERATION(OP_INSERT_WITH_REPLACE);
+    if (lineIndex >= lines.size()) {
+        std::cerr << "Line index out of bounds\n";
+        return;
+    }
+    checkLine(lineIndex);
+    const Line &line = lines[lineIndex];
+    size_t length = line.getCharCount();
+    if (pos > length) {
+        std::cerr << "Position out of bounds\n";
+        return;
+    }
+    size_t textLength = std::strlen(text);
+    Utf8Scan scan = scanUtf8(text, textLength);
+    size_t from = line.byteOffsetOf(pos);
+    size_t to = line.byteOffsetOf(pos + std::min(scan.valid ? scan.chars : textLength, length - pos));
+    commitText(lineIndex, from, to - from, text, textLength);
+}
+
+void TextStorage::encryptText(int shift, CaesarLib& caesarLib) {
+    INSTRUMENT_OPERATION(OP_ENCRYPT_TEXT);
+    waitForLoad();
+    checkMappings();
+    INSTRUMENT_BYTES(lines.weight());
+    EditRecord record;
+    std::string buffer;
+    size_t i = 0;
+    for (const Line &line : lines) {
+        buffer.assign(line.getText(), line.getTextLength());
+        caesarLib.encryptBuffer(&buffer[0], buffer.size(), shift);
+        record.push_back(textStep(i++, 0, line.getTextLength(), buffer.data(), buffer.size()));
+    }
+    commit(std::move(record));
+}
+
+void TextStorage::decryptText(int shift, CaesarLib& caesarLib) {
+    INSTRUMENT_OPERATION(OP_DECRYPT_TEXT);
+    waitForLoad();
+    checkMappings();
+    INSTRUMENT_BYTES(lines.weight());
+    EditRecord record;
+    std::string buffer;
+    size_t i = 0;
+    for (const Line &line : lines) {
+        buffer.assign(line.getText(), line.getTextLength());
+        caesarLib.decryptBuffer(&buffer[0], buffer.size(), shift);
+        record.push_back(textStep(i++, 0, line.getTextLength(), buffer.data(), buffer.size()));
+    }
+    commit(std::move(record));
+}
+
+void TextStorage::encryptFile(const char* inputFileName, const char* outputFileName, int shift, CaesarLib& caesarLib) {
+    INSTRUMENT_OPERATION(OP_ENCRYPT_FILE);
+    ChunkPipeline pipeline(workerThreads);
+    bool done = pipeline.run(inputFileName, outputFileName, [&](char* block, size_t length) {
+        caesarLib.encryptBuffer(block, length, shift);
+    });
+    INSTRUMENT_BYTES(pipeline.getBytesProcessed());
+    if (done) {
+        std::cout << "Encryption completed successfully.\n";
+        printThroughput(pipeline);
+    }
+}
+
+void TextStorage::decryptFile(const char* inputFileName, const char* outputFileName, int shift, CaesarLib& caesarLib) {
+    INSTRUMENT_OPERATION(OP_DECRYPT_FILE);
+    ChunkPipeline pipeline(workerThreads);
+    bool done = pipeline.run(inputFileName, outputFileName, [&](char* block, size_t length) {
+        caesarLib.decryptBuffer(block, length, shift);
+    });
+    INSTRUMENT_BYTES(pipeline.getBytesProcessed());
+    if (done) {
+        std::cout << "Decryption completed successfully.\n";
+        printThroughput(pipeline);
+    }
+}
+
+KeyRecoveryResult TextStorage::recoverKey(bool sample) const {
+    INSTRUMENT_OPERATION(OP_RECOVER_KEY);
+    checkMappings();
+    // Block b runs from the line holding offset b * KEY_SAMPLE_BLOCK_BYTES
+    // to the one holding the next block's offset, so lines are never split.
+    size_t blocks = (lines.weight() + KEY_SAMPLE_BLOCK_BYTES - 1) / KEY_SAMPLE_BLOCK_BYTES;
+    std::vector<size_t> firstLines;
+    for (size_t b = 0; b < blocks; ++b) {
+        size_t offset = b * KEY_SAMPLE_BLOCK_BYTES;
+        firstLines.push_back(lines.indexAtWeight(offset));
+    }
+    firstLines.push_back(lines.size());
+    KeyRecovery recovery(letterModel, workerThreads);
+    KeyRecoveryResult result = recovery.run(blocks, lines.weight(), sample,
+                                            [&](size_t block, LetterHistogram &histogram) {
+        size_t first = firstLines[block];
+        size_t last = firstLines[block + 1];
+        scanBlocks(first, last, true, [&](const char *text, size_t length, BlockLocator &) {
+            histogram.add(text, length);
+        });
+        return lines.weightBefore(last) - lines.weightBefore(first);
+    });
+    INSTRUMENT_BYTES(result.bytesScanned);
+    return result;
+}
+
+bool TextStorage::recoverFileKey(const char *filename, bool sample, KeyRecoveryResult &result) const {
+    INSTRUMENT_OPERATION(OP_RECOVER_KEY);
+    KeyRecovery recovery(letterModel, workerThreads);
+    if (!recovery.runFile(filename, sample, result)) {
+        return false;
+    }
+    INSTRUMENT_BYTES(result.bytesScanned);
+    return true;
+}
+
+bool TextStorage::trainLetterModel(const char *filename) {
+    KeyRecoveryResult sample;
+    if (!recoverFileKey(filename, false, sample)) {
+        return false;
+    }
+    if (!letterModel.train(sample.histogram)) {
+        std::cerr << "The sample has no letters\n";
+        return false;
+    }
+    return true;
+}
+
+void TextStorage::printKeyRecovery(const KeyRecoveryResult &result) {
+    uint64_t letters = result.histogram.total();
+    if (letters == 0) {
+        std::cout << "No letters to recover the key from\n";
+        return;
+    }
+    std::cout << "Most likely keys:\n";
+    for (size_t i = 0; i < std::min<size_t>(5, result.ranking.size()); ++i) {
+        std::cout << "Key " << result.ranking[i].key << ": chi-squared " << result.ranking[i].chiSquared << "\n";
+    }
+    std::cout << "Scanned " << result.bytesScanned << " of " << result.bytesTotal << " bytes, " << letters
+              << " letters, confidence " << result.confidence << "\n";
+}
+
+void TextStorage::printThroughput(const ChunkPipeline &pipeline) {
+    std::cout << "Processed " << pipeline.getBytesProcessed() << " bytes in " << pipeline.getSeconds()
+              << " s (" << pipeline.getThroughput() << " MB/s, " << pipeline.getThreadCount()
+              << " threads)\n";
+}
+
+void TextStorage::printMemoryStats() const {
+    size_t inlineLines = 0;
+    size_t borrowedLines = 0;
+    size_t sharedLines = 0;
+    for (const Line &line : lines) {
+        inlineLines += line.isInline();
+        borrowedLines += line.isBorrowed();
+        sharedLines += line.isShared();
+    }
+    const ArenaStats &stats = arena.getStats();
+    size_t allocations = stats.blockAllocations + stats.largeAllocations;
+    std::cout << "Lines: " << lines.size() << " (" << inlineLines << " inline, " << borrowedLines
+              << " mapped, " << lines.size() - inlineLines - borrowedLines << " in the arena, " << sharedLines
+              << " of them shared)\n";
+    std::cout << "Documents: " << documents.size() << " open, " << mappedFiles.size() << " files mapped\n";
+    std::cout << "Line buffers: " << stats.bytesInUse << " bytes in use, " << stats.bytesReserved
+              << " bytes reserved in " << stats.slabs << " slabs\n";
+    std::cout << "Allocations: " << allocations << " (" << stats.largeAllocations << " large) of "
+              << stats.bytesAllocated << " bytes, " << stats.releases << " releases\n";
+    std::cout << "Edits: " << editCount << ", allocations per edit: "
+              << (editCount ? static_cast<double>(allocations) / editCount : 0.0) << "\n";
+    printHistoryStats();
+    printJournalStats();
+    printInternStats();
+}
+
+void TextStorage::printInternStats() const {
+    checkMappings();
+    // Lines are told apart by content, as LinePool::find does, so lines whose
+    // hashes collide still count as distinct.
+    std::unordered_multimap<uint64_t, const Line *> contents;
+    std::unordered_set<const char *> buffers;
+    size_t arenaLines = 0, lineBytes = 0, bufferBytes = 0;
+    contents.reserve(lines.size());
+    for (const Line &line : lines) {
+        uint64_t hash = hashLineText(line.getText(), line.getTextLength());
+        auto range = contents.equal_range(hash);
+        if (std::none_of(range.first, range.second, [&line](const std::pair<const uint64_t, const Line *> &entry) {
+                return entry.second->getTextLength() == line.getTextLength() &&
+                       std::memcmp(entry.second->getText(), line.getText(), line.getTextLength()) == 0;
+            })) {
+            contents.emplace(hash, &line);
+        }
+        if (line.isBorrowed() || line.isInline()) {
+            continue;
+        }
+        arenaLines++;
+        lineBytes += line.getTextLength() + 1;
+        if (buffers.insert(line.getText()).second) {
+            bufferBytes += line.getTextLength() + 1;
+        }
+    }
+    const LinePoolStats &stats = linePool.getStats();
+    std::cout << "Unique lines: " << contents.size() << " of " << lines.size() << " ("
+              << (lines.empty() ? 0.0 : contents.size() * 100.0 / lines.size()) << "%), " << arenaLines << " arena lines in "
+              << buffers.size() << " buffers, " << lineBytes - bufferBytes << " bytes saved by sharing\n";
+    std::cout << "Line interning: " << (interning ? "on" : "off") << ", " << linePool.size() << " pooled buffers, "
+              << stats.hits << " of " << stats.lookups << " lookups shared " << stats.bytesShared << " bytes\n";
+}
+
+void TextStorage::printHistoryStats() const {
+    std::cout << "Undo history: " << undoStack.size() << " undo and " << redoStack.size() << " redo steps, "
+              << residentHistoryBytes << " bytes resident (budget " << historyBudget << "), " << spilledEntries
+              << " spilled in " << spilledBytes << " bytes (" << spilledRawBytes << " uncompressed), spill file "
+              << historySpill.getSize() << " bytes (" << historySpill.getDeadBytes() << " dropped)\n";
+}
+
+void TextStorage::printJournalStats() const {
+    if (!journal->isOpen()) {
+        std::cout << "Edit journal: " << (journaling ? "on, no document file yet" : "off") << "\n";
+        return;
+    }
+    std::cout << "Edit journal: " << journal->getPath() << ", " << journal->getRecords() << " records ("
+              << journal->getBytes() << " bytes) in " << journal->getSyncs() << " syncs\n";
+}
+
+void TextStorage::printOperationStats(bool json) const {
+    const ArenaStats &stats = arena.getStats();
+    if (json) {
+        std::cout << "{\"operations\": ";
+#ifdef TEXT_EDITOR_INSTRUMENTATION
+        Instrumentation::printJson(std::cout);
+#else
+        std::cout << "null";
+#endif
+        std::cout << ", \"undo_steps\": " << undoStack.size() << ", \"redo_steps\": " << redoStack.size()
+                  << ", \"history_bytes\": " << residentHistoryBytes << ", \"history_budget\": " << historyBudget
+                  << ", \"spilled_steps\": " << spilledEntries << ", \"spilled_bytes\": " << spilledBytes
+                  << ", \"spilled_raw_bytes\": " << spilledRawBytes
+                  << ", \"spill_file_bytes\": " << historySpill.getSize() << ", \"journal_records\": "
+                  << journal->getRecords() << ", \"journal_bytes\": " << journal->getBytes()
+                  << ", \"journal_syncs\": " << journal->getSyncs() << ", \"line_buffer_bytes\": "
+                  << stats.bytesInUse << "}\n";
+        return;
+    }
+#ifdef TEXT_EDITOR_INSTRUMENTATION
+    Instrumentation::printText(std::cout);
+#else
+    std::cout << "Operation statistics are not compiled into this build\n";
+#endif
+    printHistoryStats();
+    printJournalStats();
+    std::cout << "Line buffers: " << stats.bytesInUse << " bytes in use\n";
+}
+
+void TextStorage::printHelpInfo() {
+    std::cout << "> Choose the command:\n";
+    std::cout << "1. Append text symbols to the end\n";
+    std::cout << "2. Start a new line\n";
+    std::cout << "3. Save text to file\n";
+    std::cout << "4. Load text from file\n";
+    std::cout << "5. Print the current text to console\n";
+    std::cout << "6. Insert text by line and symbol index\n";
+    std::cout << "7. Search text\n";
+    std::cout << "8. Delete text\n";
+    std::cout << "9. Undo\n";
+    std::cout << "10. Redo\n";
+    std::cout << "11. Cut text\n";
+    std::cout << "12. Paste text\n";
+    std::cout << "13. Copy text\n";
+    std::cout << "14. Insert text by line and symbol index with replacement\n";
+    std::cout << "15. Encryt text\n";
+    std::cout << "16. Decryt text\n";
+    std::cout << "17. Encryt file\n";
+    std::cout << "18. Decryt file\n";
+    std::cout << "19. Search text with options\n";
+    std::cout << "20. Print memory statistics\n";
+    std::cout << "21. Print operation statistics\n";
+    std::cout << "22. Search for multiple patterns\n";
+    std::cout << "23. Replace all matches\n";
+    std::cout << "24. Apply multiple edits\n";
+    std::cout << "25. Open a new document\n";
+    std::cout << "26. Open a copy of the current document\n";
+    std::cout << "27. Switch document\n";
+    std::cout << "28. Close the current document\n";
+    std::cout << "29. Recover the cipher key\n";
+    std::cout << "30. Load text from file in the background\n";
+    std::cout << "31. Show the load progress\n";
+    std::cout << "32. Print lines by index\n";
+    std::cout << "33. Print the next page\n";
+    std::cout << "34. Print the previous page\n";
+    std::cout << "35. Show the changes against a file\n";
+    std::cout << "36. Show the changes since an earlier undo step\n";
+    std::cout << "37. Reload the changes from a file\n";
+    std::cout << "38. Turn line interning on or off\n";
+    std::cout << "39. Print line interning statistics\n";
+    std::cout << "0. Exit\n";
+}
@@ -0,0 +1,580 @@
+#ifndef TEXT_EDITOR_TEXTSTORAGE_H
+#define TEXT_EDITOR_TEXTSTORAGE_H
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AsyncLoad.h"
+#include "CaesarLib.h"
+#include "ChunkPipeline.h"
+#include "EditJournal.h"
+#include "KeyRecovery.h"
+#include "Line.h"
+#include "LineDiff.h"
+#include "LinePool.h"
+#include "MappedFile.h"
+#include "MultiSearch.h"
+#include "Rope.h"
+#include "SpillFile.h"
+#include "TextSearch.h"
+
+#define DEFAULT_HISTORY_LIMIT 1000
+#define DEFAULT_HISTORY_BUDGET (256 << 20)
+#define MIN_SEARCH_SHARD_LINES 16384
+#define SEARCH_BLOCK_BYTES (1 << 20)
+#define MIN_COPY_RANGE_BYTES (64 << 10)
+#define PRINT_PAGE_LINES 40
+
+// One reversible change. Applying a step swaps the content of the affected
+// range with the content stashed in the step, so the same step is its own
+// inverse and undo/redo only ever hold the bytes an edit replaced.
+struct EditStep {
+    enum Kind {
+        TEXT,
+        LINES
+    } kind;
+    size_t line;
+    size_t pos;
+    size_t span;
+    std::string text;
+    std::unique_ptr<Rope<Line>> lines;
+};
+
+typedef std::vector<EditStep> EditRecord;
+
+// An undo or redo record. Past the history budget the oldest records are
+// serialized, compressed and moved to the spill file; spilledSize is 0
+// while the record is in memory. A spilled record keeps borrowed lines as
+// addresses, so it holds on to the mappings they point into.
+struct HistoryEntry {
+    EditRecord record;
+    size_t bytes;
+    uint64_t spillOffset;
+    size_t spilledSize;
+    size_t rawSize;
+    std::vector<std::shared_ptr<MappedFile>> mappings;
+};
+
+// One edit of a batch: replaces `len` characters at line:pos with `text`, so an
+// insert has len 0 and a delete an empty text. Positions refer to the
+// document as it was before the batch.
+struct TextEdit {
+    size_t line;
+    size_t pos;
+    size_t len;
+    std::string text;
+};
+
+class TextStorage {
+private:
+    typedef Rope<Line> LineBuffer;
+
+    // Declared first so it outlives every line in the document and history.
+    LineArena arena;
+    // Repeated lines share one buffer while interning is on; see LinePool.
+    LinePool linePool;
+    bool interning;
+    LineBuffer lines;
+    std::vector<std::shared_ptr<MappedFile>> mappedFiles;
+    // Declared after mappedFiles so it stops before the mappings go away.
+    AsyncLoad asyncLoad;
+    // The stash of the undo step that put the file being loaded in place;
+    // the step's span grows with every chunk that joins the document.
+    LineBuffer *loadStash;
+    char *clipboard;
+    std::deque<HistoryEntry> undoStack;
+    std::deque<HistoryEntry> redoStack;
+    SpillFile historySpill;
+    size_t historyLimit;
+    size_t historyBudget;
+    size_t residentHistoryBytes;
+    size_t spilledEntries;
+    size_t spilledBytes;
+    size_t spilledRawBytes;
+    size_t workerThreads;
+    size_t editCount;
+    // Journals edits to "<document>.journal" for the file last loaded or
+    // saved, once journaling is enabled.
+    std::unique_ptr<EditJournal> journal;
+    bool journaling;
+    size_t journalGroupEdits;
+    unsigned journalGroupInterval;
+    std::string journalRecord;
+    std::string documentPath;
+    LetterModel letterModel;
+    // The lines last shown by printRange, for paging.
+    size_t pageFirst;
+    size_t pageLines;
+
+    // An open document other than the current one. The current document
+    // lives in the members above; its own slot in `documents` holds an
+    // empty Document until switchDocument exchanges the two.
+    struct Document {
+        LineBuffer lines;
+        std::deque<HistoryEntry> undoStack;
+        std::deque<HistoryEntry> redoStack;
+        SpillFile historySpill;
+        size_t residentHistoryBytes;
+        size_t spilledEntries;
+        size_t spilledBytes;
+        size_t spilledRawBytes;
+        size_t editCount;
+        std::unique_ptr<EditJournal> journal;
+        std::string path;
+
+        Document();
+    };
+
+    std::vector<std::unique_ptr<Document>> documents;
+    size_t currentDocument;
+
+    void exchangeDocument(Document &parked);
+
+    static EditStep textStep(size_t lineIndex, size_t pos, size_t len, const char *text, size_t textLength);
+    static EditStep linesStep(size_t lineIndex, size_t count, LineBuffer &&content);
+
+    void applyStep(EditStep &step);
+
+    // Applies a freshly built record and makes it the newest undo step.
+    void commit(EditRecord &&record);
+    // With interning on, the lines an applied step wrote go through the
+    // pool if it replaced lines or belongs to a bulk record; single edits
+    // are not worth the hashing.
+    void internStep(const EditStep &step, bool bulk);
+    void internLines(size_t first, size_t count);
+    void remember(EditRecord &&record);
+
+    // Checks that a step read back from a journal applies to the document.
+    bool stepFits(const EditStep &step) const;
+
+    // Estimated memory held by a record in the history.
+    static size_t recordBytes(const EditRecord &record);
+
+    // Borrowed lines are written as their address and length when
+    // `byAddress` is set: the mappings they point into live as long as the
+    // TextStorage. Journals get the bytes.
+    template <typename Writer>
+    static void serializeStep(const EditStep &step, Writer &out, bool byAddress);
+    static void serializeRecord(const EditRecord &record, SpillWriter &out);
+    template <typename Reader>
+    bool deserializeRecord(Reader &in, EditRecord &record);
+
+    void pushHistory(std::deque<HistoryEntry> &stack, EditRecord &&record);
+    // Removes the newest entry of `stack`, paging it back in if it was
+    // spilled. Returns false if the spill file could not be read back.
+    bool popHistory(std::deque<HistoryEntry> &stack, EditRecord &record);
+    void dropHistory(std::deque<HistoryEntry> &stack, bool oldest);
+    // Moves the spilled records still in the history to a fresh spill
+    // file once the dropped ones take more of the old file than they do.
+    void compactSpill();
+    // True for the resident undo entry of the load still in progress, which
+    // is neither spilled nor undone before the load finishes.
+    bool holdsLoad(const HistoryEntry &entry) const;
+    // Joins the chunks indexed so far, or all of them with `wait`, to the
+    // document and to the span of the load's undo step.
+    void drainLoad(bool wait);
+    bool spill(HistoryEntry &entry);
+
+    // Logs the steps of `record` in the order they are about to be applied.
+    void journalSteps(const EditRecord &record, bool reversed);
+    // Closes the current journal and starts one for `filename`, first
+    // replaying a journal left there by a crash if it matches the file.
+    void startJournal(const char *filename, bool recover);
+    bool replayJournal(const char *data, size_t length);
+    // Spills the oldest resident records, undo before redo, until the
+    // resident estimate fits the budget.
+    void enforceHistoryBudget();
+
+    // Maps ascending addresses inside a block handed out by scanBlocks back
+    // to line positions.
+    struct BlockLocator {
+        LineBuffer::const_iterator line;
+        size_t lineIndex;
+
+        SearchMatch locate(const char *at);
+    };
+
+    // Borrowed lines that follow each other in a mapping are separated by a
+    // single newline, so unless the pattern contains one, a run of them is
+    // scanned as one block and the hits are mapped back to lines. Calls
+    // scan(block, length, locator) for each block of lines [first, last).
+    template <typename Scan>
+    void scanBlocks(size_t first, size_t last, bool joinRuns, Scan scan) const;
+
+    // Number of contiguous line ranges a search on `threads` workers uses;
+    // small documents are searched on the calling thread.
+    size_t shardCount(size_t threads) const;
+
+    // Runs search(shard, first, last) for each of `shards` ranges, each on
+    // its own thread when there is more than one.
+    template <typename Search>
+    void searchShards(size_t shards, Search search) const;
+
+    void findInRange(const TextSearch &search, size_t first, size_t last, bool joinRuns,
+                     std::vector<SearchMatch> &matches) const;
+
+    // The line holding byte `offset` and the byte position in it. Checks
+    // the mappings if the line borrows its text, as its caller reads it.
+    bool lineAt(size_t offset, size_t &lineIndex, size_t &pos) const;
+
+    // Resolves [offset, offset + len) to byte positions, reporting ranges
+    // that run past the last line or split a character.
+    bool rangeAt(size_t offset, size_t len, size_t &firstLine, size_t &firstPos, size_t &lastLine,
+                 size_t &lastPos) const;
+
+    void commitText(size_t lineIndex, size_t pos, size_t len, const char *text, size_t textLength);
+
+    // The mapping of `filename`, reusing one that is still current; null if
+    // the file cannot be mapped. Mappings nothing borrows from any more are
+    // unmapped before a new one is added.
+    std::shared_ptr<MappedFile> mapFile(const char *filename);
+    // The index in mappedFiles of the mapping `text` points into, trying
+    // `hint` first; mappedFiles.size() if there is none.
+    size_t mappingOf(const char *text, size_t hint) const;
+    // Unmaps the files that no line of any document or resident history
+    // record borrows from and no spilled record or caller holds.
+    void releaseMappings();
+    // checkMappings() when line `lineIndex` borrows its text; edits of lines
+    // already in the arena skip the fstat calls.
+    void checkLine(size_t lineIndex) const;
+
+    // The lines of `filename`, borrowed from its mapping when it can be
+    // mapped.
+    bool readFile(const char *filename, LineBuffer &loaded);
+
+    // The document as it was `steps` undo steps ago. The newest records
+    // are undone in place, the document is copied and they are redone; as
+    // each step is its own inverse, the history is left as it was.
+    bool historyState(size_t steps, LineBuffer &state);
+
+public:
+    TextStorage();
+    ~TextStorage();
+
+    TextStorage(const TextStorage &) = delete;
+    TextStorage &operator=(const TextStorage &) = delete;
+
+    size_t getLineCount() const {
+        return lines.size();
+    }
+
+    // Callers reading the text of a borrowed line call checkMappings()
+    // first, as every operation of the storage does.
+    const Line &getLine(size_t lineIndex) const {
+        return lines[lineIndex];
+    }
+
+    // Detaches the mappings whose file another program truncated (see
+    // MappedFile::detachIfTruncated), so that reading what lines borrow
+    // from them no longer faults, and reports the text lost. Returns false
+    // if a truncation was found by this call. Saving refuses documents that
+    // still hold lost text.
+    bool checkMappings() const;
+
+    // Size of the document as saveToFile writes it, newlines included.
+    size_t getDocumentLength() const {
+        return lines.weight();
+    }
+
+    const ArenaStats &getArenaStats() const {
+        return arena.getStats();
+    }
+
+    // Number of edits committed so far, including ones since undone.
+    size_t getEditCount() const {
+        return editCount;
+    }
+
+    // Worker threads used by encryptFile/decryptFile and searchText; 0 uses
+    // every core.
+    void setWorkerThreads(size_t threads) {
+        workerThreads = threads;
+    }
+
+    size_t getWorkerThreads() const {
+        return workerThreads;
+    }
+
+    // Caps the number of undo steps kept; the oldest steps are dropped first.
+    void setHistoryLimit(size_t limit);
+
+    // Memory the history may keep resident before older records are
+    // compressed and spilled to a temporary file.
+    void setHistoryBudget(size_t bytes);
+
+    size_t getHistoryBudget() const {
+        return historyBudget;
+    }
+
+    // Keeps an edit journal next to the document, taking effect on the next
+    // load or save. Loading a file whose journal survived a crash replays
+    // the journal on top of it; the journal is removed on a clean exit.
+    void setJournaling(bool enabled);
+
+    bool isJournaling() const {
+        return journaling;
+    }
+
+    // Deduplicates arena lines with identical text from now on, starting
+    // with the lines of the current document; turning it off empties the
+    // pool but leaves lines sharing what they share.
+    void setInterning(bool enabled);
+
+    bool isInterning() const {
+        return interning;
+    }
+
+    // Unique against total lines of the document and the bytes its arena
+    // lines save by sharing buffers, plus the pool's hit rate.
+    void printInternStats() const;
+
+    // Group commit thresholds of the journals; see EditJournal::setGroup.
+    void setJournalGroup(size_t edits, unsigned intervalMs);
+
+    const EditJournal &getJournal() const {
+        return *journal;
+    }
+
+    // Opens another document and makes it current. A copy shares every line
+    // buffer with the current document, so it costs one pointer copy per
+    // line; either side copies a line only when it edits it. The copy has
+    // no history and no file until it is saved. Returns its index.
+    size_t newDocument(bool copyCurrent);
+    bool switchDocument(size_t index);
+    // Closes the current document, discarding unsaved changes, and switches
+    // to the one before it. The last open document cannot be closed.
+    bool closeDocument();
+    void listDocuments() const;
+
+    size_t getDocumentCount() const {
+        return documents.size();
+    }
+
+    size_t getCurrentDocument() const {
+        return currentDocument;
+    }
+
+    void appendText(size_t lineIndex, const char *text);
+    void addNewLine();
+
+    // Writes to a temporary file and renames it over `filename`. Runs of
+    // lines still borrowed from a mapped file are unchanged by construction
+    // and large runs are copied from that file in-kernel instead of being
+    // written out again. Returns false if the file could not be written.
+    bool saveToFile(const char *filename);
+
+    // Maps the file and indexes its lines in one newline scan; the lines
+    // borrow the mapped bytes until edited. Files that cannot be mapped are
+    // read through a stream instead. Returns false if the file could not be
+    // read; the document is left as it was.
+    bool loadFromFile(const char *filename);
+
+    // Loads like loadFromFile but returns once the first
+    // ASYNC_LOAD_FIRST_BYTES are in; the rest is indexed on a background
+    // thread and joins the document at each pollLoad(). Until then the
+    // document is the part of the file loaded so far: it can be printed,
+    // searched, copied from and edited. Lines added at its end stay in
+    // front of the lines still to come. Saving, replaceAll, encrypting and
+    // switching documents wait for the load to finish first. The load is
+    // one undo step, as with loadFromFile; undoing it waits for the rest of
+    // the file. A file with a crash journal is loaded in full so that the
+    // journal can be replayed.
+    bool loadFromFileAsync(const char *filename);
+    void pollLoad();
+    void waitForLoad();
+
+    bool isLoading() const {
+        return asyncLoad.isActive();
+    }
+
+    void printLoadProgress() const;
+
+    // Print a unified diff from `filename`, or from the document as it was
+    // `steps` undo steps ago, to the current document. Lines are matched by
+    // hash with a Myers diff (see diffLines). Return false if the file
+    // cannot be read or there are not enough undo steps.
+    bool diffWithFile(const char *filename);
+    bool diffHistory(size_t steps);
+
+    // Makes the document match `filename` again, or the file it was last
+    // loaded from or saved to when `filename` is empty. Only the lines that
+    // differ are replaced, as one undo step, so unchanged lines keep their
+    // buffers and the step holds just the changed hunks. Returns false if
+    // the file cannot be read.
+    bool reloadFromFile(const char *filename);
+
+    // Gathers the lines into buffers of about WRITE_BATCH_BYTES, so the
+    // stream sees a few large writes instead of a flush per line.
+    void printText() const;
+
+    // Writes the document to `fd` with writev straight from the line
+    // buffers; runs of lines still borrowed from one mapping go out as a
+    // single buffer. std::cout is flushed first. Returns false if the
+    // write failed.
+    bool writeText(int fd) const;
+
+    // Prints `count` lines from `first` with one write and makes them the
+    // current page. Costs O(log n + count) however long the document is.
+    void printRange(size_t first, size_t count);
+    void printNextPage();
+    void printPreviousPage();
+
+    // Positions within a line are columns, counted in characters of UTF-8
+    // text (see Line); each edit resolves its columns in O(log n).
+    void insertText(size_t lineIndex, size_t pos, const char *text);
+
+    // Returns every match in document order, positioned by byte; a line's
+    // columnOf() gives the column. Large documents are split into
+    // contiguous line ranges searched on options.threads workers.
+    std::vector<SearchMatch> findText(const char *substring, const SearchOptions &options) const;
+
+    void searchText(const char *substring) const;
+    void searchText(const char *substring, const SearchOptions &options) const;
+
+    // Finds every occurrence of every pattern in a single pass over the
+    // document; the result holds one list per pattern, in document order.
+    std::vector<std::vector<SearchMatch>> findPatterns(const std::vector<std::string> &patterns,
+                                                       const SearchOptions &options) const;
+    void searchPatterns(const std::vector<std::string> &patterns, const SearchOptions &options) const;
+
+    // Replaces every non-overlapping match, leftmost first, and records the
+    // whole replacement as one undo step. Only lines with a match are
+    // touched, each rebuilt once; matches are found and the new text is
+    // built on options.threads workers. Returns the number of replacements.
+    size_t replaceAll(const char *pattern, const char *replacement, const SearchOptions &options);
+
+    // Applies a batch of edits as one change with one undo step. Edits are
+    // sorted by position (inserts at the same position keep their order and
+    // go before a range starting there) and each touched line is rewritten
+    // once. A batch with an edit out of bounds or two overlapping ranges is
+    // rejected as a whole; returns false in that case.
+    bool applyEdits(std::vector<TextEdit> edits);
+    void deleteText(size_t lineIndex, size_t pos, size_t len);
+    // Byte offsets address the document as saveToFile writes it; offset
+    // getDocumentLength() - 1 is the end of the last line. Both conversions
+    // are O(log n) and return false for positions outside the document or
+    // offsets inside a multi-byte character.
+    bool offsetToPosition(size_t offset, size_t &lineIndex, size_t &pos) const;
+    bool positionToOffset(size_t lineIndex, size_t pos, size_t &offset) const;
+
+    // Offset-based edits. Ranges may span lines: deleting across a newline
+    // joins the lines, and copied text keeps the newlines. Offsets must not
+    // split a character.
+    void insertTextAt(size_t offset, const char *text);
+    void deleteTextAt(size_t offset, size_t len);
+    void copyTextAt(size_t offset, size_t len);
+    void cutTextAt(size_t offset, size_t len);
+    // The text copyTextAt would put on the clipboard.
+    bool textAt(size_t offset, size_t len, std::string &text) const;
+    void pasteTextAt(size_t offset);
+
+    // Return false when there is no step to undo or redo.
+    bool undo();
+    bool redo();
+    void cutText(size_t lineIndex, size_t pos, size_t len);
+    void pasteText(size_t lineIndex, size_t pos);
+    void copyText(size_t lineIndex, size_t pos, size_t len);
+    void insertWithReplace(size_t lineIndex, size_t pos, const char *text);
+    void encryptText(int shift, CaesarLib& caesarLib);
+    void decryptText(int shift, CaesarLib& caesarLib);
+    void encryptFile(const char* inputFileName, const char* outputFileName, int shift, CaesarLib& caesarLib);
+    void decryptFile(const char* inputFileName, const char* outputFileName, int shift, CaesarLib& caesarLib);
+
+    // Ranks the 26 Caesar keys the current document may be encrypted with
+    // by comparing its letter counts to the letter model. Blocks of about
+    // KEY_SAMPLE_BLOCK_BYTES are counted on the worker threads; with
+    // `sample` set, large documents stop being counted as soon as the best
+    // key is clear.
+    KeyRecoveryResult recoverKey(bool sample) const;
+    // The same for a file, streamed from disk instead of loaded.
+    bool recoverFileKey(const char *filename, bool sample, KeyRecoveryResult &result) const;
+    // Expects the letter frequencies of a plaintext file from now on instead
+    // of English ones.
+    bool trainLetterModel(const char *filename);
+
+    void resetLetterModel() {
+        letterModel = LetterModel();
+    }
+
+    static void printKeyRecovery(const KeyRecoveryResult &result);
+    static void printThroughput(const ChunkPipeline &pipeline);
+    void printMemoryStats() const;
+
+    // Approximate memory held by the resident part of the undo and redo
+    // stacks.
+    size_t getHistoryBytes() const {
+        return residentHistoryBytes;
+    }
+
+    // Compressed bytes in the spill file for records currently spilled, and
+    // their size before compression.
+    size_t getSpilledHistoryBytes() const {
+        return spilledBytes;
+    }
+
+    size_t getSpilledHistoryRawBytes() const {
+        return spilledRawBytes;
+    }
+
+    // Size of the spill file, including records already dropped that a
+    // compaction has not reclaimed yet.
+    size_t getSpillFileBytes() const {
+        return historySpill.getSize();
+    }
+
+    void printHistoryStats() const;
+    void printJournalStats() const;
+
+    // Per-operation calls, latency and allocations (when built with
+    // TEXT_EDITOR_INSTRUMENTATION) plus history memory, as text or JSON.
+    void printOperationStats(bool json) const;
+
+    typedef enum {
+        append_text = 1,
+        start_new_line,
+        save_to_file,
+        load_from_file,
+        print_current_text,
+        insert_text_by_index,
+        search_text,
+        delete_text,
+        undo_action,
+        redo_action,
+        cut_text,
+        paste_text,
+        copy_text,
+        insert_with_replace,
+        encrypt_text,
+        decrypt_text,
+        encrypt_file,
+        decrypt_file,
+        search_text_with_options,
+        print_memory_stats,
+        print_operation_stats,
+        search_multiple_patterns,
+        replace_all,
+        apply_edits,
+        new_document,
+        copy_document,
+        switch_document,
+        close_document,
+        recover_key,
+        load_in_background,
+        print_load_progress,
+        print_range,
+        print_next_page,
+        print_previous_page,
+        diff_with_file,
+        diff_with_history,
+        reload_from_file,
+        toggle_interning,
+        print_intern_stats,
+        exit_program = 0
+    } Command;
+
+    void printHelpInfo();
+};
+
+#endif //TEXT_EDITOR_TEXTSTORAGE_H
@@ -0,0 +1,293 @@
+#include "Utf8.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_X86 1
+#endif
+
+namespace {
+
+typedef Utf8Scan (*ScanKernel)(const unsigned char *, size_t, std::vector<size_t> *, size_t);
+typedef size_t (*CountKernel)(const unsigned char *, size_t);
+typedef size_t (*AdvanceKernel)(const unsigned char *, size_t, size_t);
+
+struct Kernels {
+    ScanKernel scan;
+    CountKernel count;
+    AdvanceKernel advance;
+};
+
+bool isStart(unsigned char c) {
+    return (c & 0xC0) != 0x80;
+}
+
+// Length of the well-formed sequence at `text`, 0 if it is not one:
+// overlong forms, surrogates and code points past U+10FFFF are rejected.
+size_t sequenceLength(const unsigned char *text, size_t len) {
+    unsigned char lead = text[0];
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    size_t n;
+    if (lead < 0x80) {
+        return 1;
+    } else if (lead >= 0xC2 && lead <= 0xDF) {
+        n = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        n = 3;
+        low = lead == 0xE0 ? 0xA0 : low;
+        high = lead == 0xED ? 0x9F : high;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        n = 4;
+        low = lead == 0xF0 ? 0x90 : low;
+        high = lead == 0xF4 ? 0x8F : high;
+    } else {
+        return 0;
+    }
+    if (n > len || text[1] < low || text[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < n; ++i) {
+        if (isStart(text[i])) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+Utf8Scan scalarScan(const unsigned char *text, size_t len, std::vector<size_t> *samples, size_t stride) {
+    Utf8Scan scan = {0, true, true};
+    size_t i = 0;
+    while (i < len) {
+        size_t n = sequenceLength(text + i, len - i);
+        if (n == 0) {
+            scan.ascii = false;
+            scan.valid = false;
+            return scan;
+        }
+        if (samples && scan.chars % stride == 0) {
+            samples->push_back(i);
+        }
+        scan.ascii = scan.ascii && n == 1;
+        scan.chars++;
+        i += n;
+    }
+    return scan;
+}
+
+size_t scalarCount(const unsigned char *text, size_t len) {
+    size_t chars = 0;
+    for (size_t i = 0; i < len; ++i) {
+        chars += isStart(text[i]);
+    }
+    return chars;
+}
+
+size_t scalarAdvance(const unsigned char *text, size_t len, size_t count) {
+    for (size_t i = 0; i < len; ++i) {
+        if (isStart(text[i]) && count-- == 0) {
+            return i;
+        }
+    }
+    return len;
+}
+
+#ifdef UTF8_X86
+unsigned selectBit(uint32_t mask, size_t rank) {
+    while (rank--) {
+        mask &= mask - 1;
+    }
+    return __builtin_ctz(mask);
+}
+
+// Lookup validation after Keiser and Lemire: each byte is classified
+// together with the one before it by three nibble tables, and an error bit
+// survives the AND only for an invalid pair. Third and fourth bytes of
+// longer sequences must be continuations exactly where a lead two or three
+// bytes back demands one.
+const uint8_t TOO_SHORT = 1 << 0;
+const uint8_t TOO_LONG = 1 << 1;
+const uint8_t OVERLONG_3 = 1 << 2;
+const uint8_t TOO_LARGE = 1 << 3;
+const uint8_t SURROGATE = 1 << 4;
+const uint8_t OVERLONG_2 = 1 << 5;
+const uint8_t TOO_LARGE_1000 = 1 << 6;
+const uint8_t OVERLONG_4 = 1 << 6;
+const uint8_t TWO_CONTS = 1 << 7;
+const uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+const uint8_t FIRST_HIGH[16] = {
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4};
+const uint8_t FIRST_LOW[16] = {
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000};
+const uint8_t SECOND_HIGH[16] = {
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT};
+// A lead in the last three bytes of a block needs the next block.
+const uint8_t LAST_COMPLETE[32] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1};
+
+__attribute__((target("avx2")))
+__m256i loadTable(const uint8_t *table) {
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(table)));
+}
+
+// The block shifted by N bytes, continued from the end of `prior`.
+template <int N>
+__attribute__((target("avx2")))
+__m256i previous(__m256i input, __m256i prior) {
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prior, input, 0x21), 16 - N);
+}
+
+__attribute__((target("avx2")))
+__m256i blockErrors(__m256i input, __m256i prior) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i prev1 = previous<1>(input, prior);
+    __m256i firstHigh = _mm256_shuffle_epi8(loadTable(FIRST_HIGH), _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i firstLow = _mm256_shuffle_epi8(loadTable(FIRST_LOW), _mm256_and_si256(prev1, nibble));
+    __m256i secondHigh = _mm256_shuffle_epi8(loadTable(SECOND_HIGH),
+                                             _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(firstHigh, firstLow), secondHigh);
+    __m256i third = _mm256_subs_epu8(previous<2>(input, prior), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(previous<3>(input, prior), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    __m256i continued = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(continued, special);
+}
+
+// Bit i is set if byte i starts a code point.
+__attribute__((target("avx2")))
+uint32_t startMask(__m256i input) {
+    return _mm256_movemask_epi8(_mm256_cmpgt_epi8(input, _mm256_set1_epi8(-65)));
+}
+
+__attribute__((target("avx2")))
+Utf8Scan avx2Scan(const unsigned char *text, size_t len, std::vector<size_t> *samples, size_t stride) {
+    Utf8Scan scan = {0, true, true};
+    const __m256i lastComplete = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(LAST_COMPLETE));
+    __m256i prior = _mm256_setzero_si256();
+    __m256i errors = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    size_t nextSample = 0;
+    // The tail is padded with NULs, which are ASCII and start no code point
+    // that is counted.
+    alignas(32) unsigned char tail[32];
+    for (size_t i = 0; i < len; i += 32) {
+        const unsigned char *block = text + i;
+        size_t n = std::min<size_t>(32, len - i);
+        if (n < 32) {
+            std::memset(tail, 0, sizeof(tail));
+            std::memcpy(tail, block, n);
+            block = tail;
+        }
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+        uint32_t starts = startMask(input);
+        if (n < 32) {
+            starts &= (1u << n) - 1;
+        }
+        size_t count = __builtin_popcount(starts);
+        while (samples && nextSample < scan.chars + count) {
+            samples->push_back(i + selectBit(starts, nextSample - scan.chars));
+            nextSample += stride;
+        }
+        scan.chars += count;
+        if (_mm256_movemask_epi8(input) == 0) {
+            errors = _mm256_or_si256(errors, incomplete);
+            incomplete = _mm256_setzero_si256();
+        } else {
+            scan.ascii = false;
+            errors = _mm256_or_si256(errors, blockErrors(input, prior));
+            incomplete = _mm256_subs_epu8(input, lastComplete);
+        }
+        prior = input;
+    }
+    errors = _mm256_or_si256(errors, incomplete);
+    scan.valid = _mm256_testz_si256(errors, errors);
+    if (!scan.valid) {
+        scan.ascii = false;
+        if (samples) {
+            samples->clear();
+        }
+    }
+    return scan;
+}
+
+__attribute__((target("avx2")))
+size_t avx2Count(const unsigned char *text, size_t len) {
+    size_t chars = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        chars += __builtin_popcount(startMask(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i))));
+    }
+    return chars + scalarCount(text + i, len - i);
+}
+
+__attribute__((target("avx2")))
+size_t avx2Advance(const unsigned char *text, size_t len, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        uint32_t starts = startMask(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i)));
+        size_t here = __builtin_popcount(starts);
+        if (count < here) {
+            return i + selectBit(starts, count);
+        }
+        count -= here;
+    }
+    return i + scalarAdvance(text + i, len - i, count);
+}
+#endif
+
+Kernels selectKernels() {
+#ifdef UTF8_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {avx2Scan, avx2Count, avx2Advance};
+    }
+#endif
+    return {scalarScan, scalarCount, scalarAdvance};
+}
+
+const Kernels &kernels() {
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+}
+
+Utf8Scan scanUtf8(const char *text, size_t len, std::vector<size_t> *samples, size_t stride) {
+    return kernels().scan(reinterpret_cast<const unsigned char *>(text), len, samples, stride);
+}
+
+size_t countUtf8(const char *text, size_t len) {
+    return kernels().count(reinterpret_cast<const unsigned char *>(text), len);
+}
+
+size_t advanceUtf8(const char *text, size_t len, size_t count) {
+    return kernels().advance(reinterpret_cast<const unsigned char *>(text), len, count);
+}
@@ -0,0 +1,35 @@
+#ifndef TEXT_EDITOR_UTF8_H
+#define TEXT_EDITOR_UTF8_H
+
+#include <cstddef>
+#include <vector>
+
+// Long multi-byte lines sample the byte offset of every UTF8_INDEX_STRIDE-th
+// code point; shorter ones are counted on each lookup.
+#define UTF8_INDEX_STRIDE 128
+#define UTF8_INDEX_MIN_BYTES 1024
+
+struct Utf8Scan {
+    size_t chars;
+    bool ascii;
+    bool valid;
+};
+
+// Validates `text` as UTF-8 and counts its code points, 32 bytes at a time
+// where AVX2 is available. When `samples` is given it receives the byte
+// offset of code points 0, stride, 2 * stride, ... of valid text.
+Utf8Scan scanUtf8(const char *text, size_t len, std::vector<size_t> *samples = nullptr,
+                  size_t stride = UTF8_INDEX_STRIDE);
+
+// Code points starting in [text, text + len) of valid UTF-8.
+size_t countUtf8(const char *text, size_t len);
+
+// Byte offset of code point `count` of valid UTF-8, or len if the text has
+// no more than `count` code points.
+size_t advanceUtf8(const char *text, size_t len, size_t count);
+
+inline bool isUtf8Continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+#endif //TEXT_EDITOR_UTF8_H
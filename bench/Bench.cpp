@@ -0,0 +1,174 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+
+namespace {
+
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int ch) override {
+        return ch;
+    }
+
+    std::streamsize xsputn(const char *, std::streamsize count) override {
+        return count;
+    }
+};
+
+// Nearest-rank percentile of an ascending sample set.
+double percentile(const std::vector<double> &sorted, double fraction) {
+    size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+    rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+    return sorted[rank - 1];
+}
+
+std::string escapeJson(const std::string &text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+}
+
+bool BenchRunner::parseOptions(int argc, char *argv[], BenchOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--filter") == 0 && hasValue) {
+            options.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--samples") == 0 && hasValue) {
+            options.samples = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            options.warmup = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--scale") == 0 && hasValue) {
+            options.scale = std::strtod(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--json") == 0 && hasValue) {
+            options.jsonPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--list") == 0) {
+            options.list = true;
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            std::cerr << "Usage: " << argv[0]
+                      << " [--filter TEXT] [--samples N] [--warmup N] [--scale X] [--json PATH] [--list]"
+                      << std::endl;
+            return false;
+        }
+    }
+    if (options.scale <= 0) {
+        std::cerr << "Scale must be positive" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+BenchResult BenchRunner::runCase(const BenchCase &benchCase) const {
+    NullBuffer null;
+    std::streambuf *saved = std::cout.rdbuf(&null);
+    std::vector<double> perItem;
+    BenchState last(options.scale);
+    for (size_t i = 0; i < options.warmup + options.samples; ++i) {
+        BenchState state(options.scale);
+        benchCase.body(state);
+        if (i >= options.warmup) {
+            perItem.push_back(state.getElapsedNs() / std::max<size_t>(state.getItems(), 1));
+            last = state;
+        }
+    }
+    std::cout.rdbuf(saved);
+
+    std::vector<double> sorted(perItem);
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (double ns : sorted) {
+        total += ns;
+    }
+    BenchResult result;
+    result.name = benchCase.name;
+    result.samples = sorted.size();
+    result.items = last.getItems();
+    result.bytes = last.getBytes();
+    result.counters = last.getCounters();
+    result.minNs = sorted.front();
+    result.p50Ns = percentile(sorted, 0.50);
+    result.p90Ns = percentile(sorted, 0.90);
+    result.p99Ns = percentile(sorted, 0.99);
+    result.maxNs = sorted.back();
+    result.meanNs = total / sorted.size();
+    double sampleNs = result.p50Ns * std::max<size_t>(result.items, 1);
+    result.megabytesPerSecond = result.bytes && sampleNs > 0 ? result.bytes / (sampleNs / 1e9) / (1024.0 * 1024.0) : 0;
+    return result;
+}
+
+std::vector<BenchResult> BenchRunner::run(const BenchRegistry &registry) const {
+    std::vector<BenchResult> results;
+    for (const BenchCase &benchCase : registry.getCases()) {
+        if (benchCase.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        if (options.list) {
+            std::cout << benchCase.name << "\n";
+            continue;
+        }
+        results.push_back(runCase(benchCase));
+        std::cerr << "done: " << benchCase.name << std::endl;
+    }
+    return results;
+}
+
+void BenchRunner::printTable(const std::vector<BenchResult> &results) {
+    std::printf("%-34s %8s %12s %12s %12s %12s %10s\n", "benchmark", "items", "min ns", "p50 ns", "p90 ns",
+                "p99 ns", "MB/s");
+    for (const BenchResult &result : results) {
+        std::printf("%-34s %8zu %12.1f %12.1f %12.1f %12.1f ", result.name.c_str(), result.items, result.minNs,
+                    result.p50Ns, result.p90Ns, result.p99Ns);
+        if (result.megabytesPerSecond > 0) {
+            std::printf("%10.1f", result.megabytesPerSecond);
+        } else {
+            std::printf("%10s", "-");
+        }
+        for (const std::pair<std::string, double> &counter : result.counters) {
+            std::printf("  %s=%g", counter.first.c_str(), counter.second);
+        }
+        std::printf("\n");
+    }
+    std::fflush(stdout);
+}
+
+bool BenchRunner::writeJson(const std::vector<BenchResult> &results) const {
+    if (options.jsonPath.empty()) {
+        return true;
+    }
+    std::ofstream out(options.jsonPath);
+    if (!out) {
+        std::cerr << "Error opening " << options.jsonPath << " for writing" << std::endl;
+        return false;
+    }
+    out << "{\n  \"timestamp\": " << std::time(nullptr) << ",\n  \"scale\": " << options.scale
+        << ",\n  \"warmup\": " << options.warmup << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &result = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << escapeJson(result.name) << "\", \"samples\": "
+            << result.samples << ", \"items\": " << result.items << ", \"bytes\": " << result.bytes
+            << ", \"ns_per_item\": {\"min\": " << result.minNs << ", \"p50\": " << result.p50Ns
+            << ", \"p90\": " << result.p90Ns << ", \"p99\": " << result.p99Ns << ", \"max\": " << result.maxNs
+            << ", \"mean\": " << result.meanNs << "}, \"mb_per_s\": " << result.megabytesPerSecond
+            << ", \"counters\": {";
+        for (size_t c = 0; c < result.counters.size(); ++c) {
+            out << (c ? ", " : "") << "\"" << escapeJson(result.counters[c].first) << "\": " << result.counters[c].second;
+        }
+        out << "}}";
+    }
+    out << "\n  ]\n}\n";
+    return static_cast<bool>(out);
+}
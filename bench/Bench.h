@@ -0,0 +1,138 @@
+#ifndef TEXT_EDITOR_BENCH_H
+#define TEXT_EDITOR_BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Handed to a benchmark body once per sample. Work outside measure() is
+// setup or teardown and is not timed; a body may call measure() several
+// times and the timed sections add up.
+class BenchState {
+private:
+    double scale;
+    double elapsedNs;
+    size_t items;
+    size_t bytes;
+    std::vector<std::pair<std::string, double>> counters;
+
+public:
+    explicit BenchState(double sizeScale) : scale(sizeScale), elapsedNs(0), items(1), bytes(0) {}
+
+    // Scales a nominal problem size by --scale, never below 1.
+    size_t scaled(size_t nominal) const {
+        double value = nominal * scale;
+        return value < 1 ? 1 : static_cast<size_t>(value);
+    }
+
+    template <typename Body>
+    void measure(Body &&body) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        body();
+        elapsedNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Operations and bytes processed per sample; times are reported per item
+    // and throughput from the byte count.
+    void setItems(size_t count) {
+        items = count;
+    }
+
+    void setBytes(size_t count) {
+        bytes = count;
+    }
+
+    // Extra per-sample figure reported next to the timings, e.g. allocations
+    // per edit; the value from the last sample is kept.
+    void setCounter(const std::string &name, double value) {
+        counters.emplace_back(name, value);
+    }
+
+    double getElapsedNs() const {
+        return elapsedNs;
+    }
+
+    size_t getItems() const {
+        return items;
+    }
+
+    size_t getBytes() const {
+        return bytes;
+    }
+
+    const std::vector<std::pair<std::string, double>> &getCounters() const {
+        return counters;
+    }
+};
+
+struct BenchCase {
+    std::string name;
+    std::function<void(BenchState &)> body;
+};
+
+struct BenchResult {
+    std::string name;
+    size_t samples;
+    size_t items;
+    size_t bytes;
+    double minNs;
+    double p50Ns;
+    double p90Ns;
+    double p99Ns;
+    double maxNs;
+    double meanNs;
+    double megabytesPerSecond;
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+class BenchRegistry {
+private:
+    std::vector<BenchCase> cases;
+
+public:
+    void add(const std::string &name, std::function<void(BenchState &)> body) {
+        cases.push_back({name, std::move(body)});
+    }
+
+    const std::vector<BenchCase> &getCases() const {
+        return cases;
+    }
+};
+
+struct BenchOptions {
+    std::string filter;
+    std::string jsonPath;
+    size_t samples;
+    size_t warmup;
+    double scale;
+    bool list;
+
+    BenchOptions() : samples(15), warmup(2), scale(1.0), list(false) {}
+};
+
+// Runs every case whose name contains the filter: `warmup` discarded
+// samples, then `samples` timed ones. Anything the code under test prints to
+// std::cout is discarded while a case runs.
+class BenchRunner {
+private:
+    BenchOptions options;
+
+    BenchResult runCase(const BenchCase &benchCase) const;
+
+public:
+    explicit BenchRunner(const BenchOptions &benchOptions) : options(benchOptions) {}
+
+    // Parses --filter, --samples, --warmup, --scale, --json and --list.
+    // Returns false and reports the problem on an unknown option.
+    static bool parseOptions(int argc, char *argv[], BenchOptions &options);
+
+    std::vector<BenchResult> run(const BenchRegistry &registry) const;
+
+    static void printTable(const std::vector<BenchResult> &results);
+    bool writeJson(const std::vector<BenchResult> &results) const;
+};
+
+#endif //TEXT_EDITOR_BENCH_H
@@ -0,0 +1,16 @@
+#ifndef TEXT_EDITOR_BENCH_CASES_H
+#define TEXT_EDITOR_BENCH_CASES_H
+
+#include "Bench.h"
+
+class CaesarLib;
+
+void registerLineBenchmarks(BenchRegistry &registry);
+void registerStorageBenchmarks(BenchRegistry &registry);
+void registerSearchBenchmarks(BenchRegistry &registry);
+void registerCipherBenchmarks(BenchRegistry &registry);
+
+// Loaded from CAESAR_LIB_PATH on first use and shared by every case.
+CaesarLib &benchCaesarLib();
+
+#endif //TEXT_EDITOR_BENCH_CASES_H
@@ -0,0 +1,121 @@
+#include "Bench.h"
+#include "Cases.h"
+#include "Generators.h"
+#include "../CaesarLib.h"
+#include "../KeyRecovery.h"
+#include "../TextStorage.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct CipherInput {
+    std::string text;
+    std::vector<std::string> lines;
+    std::unique_ptr<TempFile> file;
+    std::unique_ptr<TempFile> encrypted;
+
+    void prepare(BenchState &state) {
+        if (text.empty()) {
+            text = makeLogDocument(state.scaled(200000));
+            lines = splitLines(text);
+            file.reset(new TempFile(text));
+            std::string cipher = text;
+            benchCaesarLib().encryptBuffer(&cipher[0], cipher.size(), 3);
+            encrypted.reset(new TempFile(cipher));
+        }
+    }
+};
+
+void benchKeyRecovery(BenchState &state, CipherInput &input, bool sample) {
+    input.prepare(state);
+    TextStorage storage;
+    KeyRecoveryResult result;
+    state.measure([&]() {
+        storage.recoverFileKey(input.encrypted->getPath(), sample, result);
+    });
+    state.setBytes(result.bytesScanned);
+    state.setCounter("scanned_fraction", static_cast<double>(result.bytesScanned) / result.bytesTotal);
+    state.setCounter("key", result.ranking[0].key);
+}
+
+}
+
+CaesarLib &benchCaesarLib() {
+    static CaesarLib caesarLib(CAESAR_LIB_PATH);
+    return caesarLib;
+}
+
+void registerCipherBenchmarks(BenchRegistry &registry) {
+    std::shared_ptr<CipherInput> input = std::make_shared<CipherInput>();
+
+    registry.add("cipher_encrypt_buffer", [input](BenchState &state) {
+        input->prepare(state);
+        std::string buffer = input->text;
+        state.measure([&]() {
+            benchCaesarLib().encryptBuffer(&buffer[0], buffer.size(), 3);
+        });
+        state.setBytes(buffer.size());
+    });
+
+    registry.add("cipher_encrypt_text_lines", [input](BenchState &state) {
+        input->prepare(state);
+        std::vector<std::string> &lines = input->lines;
+        state.measure([&]() {
+            for (std::string &line : lines) {
+                delete[] benchCaesarLib().encryptText(&line[0], 3);
+            }
+        });
+        state.setItems(lines.size());
+        state.setBytes(input->text.size());
+    });
+
+    registry.add("storage_encrypt_text", [input](BenchState &state) {
+        input->prepare(state);
+        TextStorage storage;
+        storage.loadFromFile(input->file->getPath());
+        state.measure([&]() {
+            storage.encryptText(3, benchCaesarLib());
+        });
+        state.setBytes(input->text.size());
+    });
+
+    registry.add("letter_histogram", [input](BenchState &state) {
+        input->prepare(state);
+        LetterHistogram histogram;
+        state.measure([&]() {
+            histogram.add(input->text.data(), input->text.size());
+        });
+        state.setBytes(input->text.size());
+    });
+
+    registry.add("key_recovery_file_full", [input](BenchState &state) {
+        benchKeyRecovery(state, *input, false);
+    });
+
+    registry.add("key_recovery_file_sample", [input](BenchState &state) {
+        benchKeyRecovery(state, *input, true);
+    });
+
+    registry.add("storage_recover_key", [input](BenchState &state) {
+        input->prepare(state);
+        TextStorage storage;
+        storage.loadFromFile(input->encrypted->getPath());
+        state.measure([&]() {
+            storage.recoverKey(false);
+        });
+        state.setBytes(input->text.size());
+    });
+
+    registry.add("storage_encrypt_file", [input](BenchState &state) {
+        input->prepare(state);
+        TextStorage storage;
+        TempFile output;
+        state.measure([&]() {
+            storage.encryptFile(input->file->getPath(), output.getPath(), 3, benchCaesarLib());
+        });
+        state.setBytes(input->text.size());
+    });
+}
@@ -0,0 +1,123 @@
+#include "Generators.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <unistd.h>
+
+namespace {
+
+const char *identifiers[] = {"index", "length", "buffer", "result", "count", "line", "text", "storage",
+                             "capacity", "value", "node", "offset", "size", "data", "pos", "clipboard"};
+const char *keywords[] = {"if", "for", "while", "return", "size_t", "const", "auto", "void", "char"};
+const char *operators[] = {" = ", " + ", " - ", " < ", " == ", " != ", " += ", "->", "."};
+const char *levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+const char *words[] = {"request", "user", "session", "timeout", "connect", "alpha", "beta", "gamma",
+                       "delta", "handler", "cache", "miss", "retry", "upstream", "latency", "queue"};
+
+template <size_t N>
+const char *pick(std::mt19937 &rng, const char *(&pool)[N]) {
+    return pool[rng() % N];
+}
+
+}
+
+std::string makeSourceDocument(size_t lineCount, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string document;
+    size_t depth = 0;
+    for (size_t i = 0; i < lineCount; ++i) {
+        unsigned kind = rng() % 8;
+        if (kind == 0 && depth > 0) {
+            --depth;
+            document.append(depth * 4, ' ');
+            document += "}\n";
+            continue;
+        }
+        if (kind == 1) {
+            document += '\n';
+            continue;
+        }
+        document.append(depth * 4, ' ');
+        document += pick(rng, keywords);
+        document += ' ';
+        size_t terms = 1 + rng() % 4;
+        for (size_t t = 0; t < terms; ++t) {
+            if (t) {
+                document += pick(rng, operators);
+            }
+            document += pick(rng, identifiers);
+        }
+        if (kind == 2 && depth < 6) {
+            document += " {\n";
+            ++depth;
+        } else {
+            document += ";\n";
+        }
+    }
+    return document;
+}
+
+std::string makeLogDocument(size_t lineCount, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string document;
+    char stamp[64];
+    for (size_t i = 0; i < lineCount; ++i) {
+        std::snprintf(stamp, sizeof(stamp), "2024-07-10T%02zu:%02zu:%02zu.%03u ", (i / 3600000) % 24,
+                      (i / 60000) % 60, (i / 1000) % 60, static_cast<unsigned>(i % 1000));
+        document += stamp;
+        document += pick(rng, levels);
+        document += " [worker-";
+        document += std::to_string(rng() % 16);
+        document += "]";
+        size_t wordCount = 6 + rng() % 14;
+        for (size_t w = 0; w < wordCount; ++w) {
+            document += ' ';
+            document += pick(rng, words);
+        }
+        document += " id=";
+        document += std::to_string(rng());
+        document += '\n';
+    }
+    return document;
+}
+
+std::vector<std::string> splitLines(const std::string &document) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (start < document.size()) {
+        size_t end = document.find('\n', start);
+        if (end == std::string::npos) {
+            end = document.size();
+        }
+        lines.push_back(document.substr(start, end - start));
+        start = end + 1;
+    }
+    return lines;
+}
+
+TempFile::TempFile(const std::string &content) {
+    const char *dir = std::getenv("TMPDIR");
+    std::string pattern = std::string(dir && *dir ? dir : "/tmp") + "/text_editor_bench_XXXXXX";
+    int fd = mkstemp(&pattern[0]);
+    if (fd < 0) {
+        std::cerr << "Error creating temp file " << pattern << std::endl;
+        std::exit(1);
+    }
+    path = pattern;
+    size_t written = 0;
+    while (written < content.size()) {
+        ssize_t chunk = write(fd, content.data() + written, content.size() - written);
+        if (chunk <= 0) {
+            std::cerr << "Error writing temp file " << path << std::endl;
+            std::exit(1);
+        }
+        written += chunk;
+    }
+    close(fd);
+}
+
+TempFile::~TempFile() {
+    std::remove(path.c_str());
+}
@@ -0,0 +1,33 @@
+#ifndef TEXT_EDITOR_BENCH_GENERATORS_H
+#define TEXT_EDITOR_BENCH_GENERATORS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Deterministic synthetic documents, newline-terminated. Source documents
+// have short indented lines of identifiers and punctuation; log documents
+// have long timestamped lines drawn from a small vocabulary.
+std::string makeSourceDocument(size_t lineCount, unsigned seed = 42);
+std::string makeLogDocument(size_t lineCount, unsigned seed = 42);
+
+std::vector<std::string> splitLines(const std::string &document);
+
+// A file under the temp directory that is removed on destruction.
+class TempFile {
+private:
+    std::string path;
+
+public:
+    explicit TempFile(const std::string &content = std::string());
+    ~TempFile();
+
+    TempFile(const TempFile &) = delete;
+    TempFile &operator=(const TempFile &) = delete;
+
+    const char *getPath() const {
+        return path.c_str();
+    }
+};
+
+#endif //TEXT_EDITOR_BENCH_GENERATORS_H
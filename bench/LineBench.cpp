@@ -0,0 +1,134 @@
+#include "Bench.h"
+#include "Cases.h"
+#include "../Line.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t EDITS_PER_SAMPLE = 1000;
+
+Line makeLine(size_t length) {
+    Line line;
+    std::string text(length, 'x');
+    line.replaceText(0, 0, text.data(), text.size());
+    return line;
+}
+
+// `count` characters cycling through Cyrillic, Latin and a few wider ones.
+std::string makeUtf8(size_t count) {
+    const char *pieces[] = {"п", "р", "и", "a", " ", "ї", "€", "😀"};
+    std::string text;
+    for (size_t i = 0; i < count; ++i) {
+        text += pieces[(i * 7) % 8];
+    }
+    return text;
+}
+
+}
+
+void registerLineBenchmarks(BenchRegistry &registry) {
+    registry.add("line_append_text", [](BenchState &state) {
+        Line line;
+        const ArenaStats &stats = LineArena::defaultArena().getStats();
+        size_t before = stats.blockAllocations + stats.largeAllocations;
+        state.measure([&]() {
+            for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+                line.appendText("appended");
+            }
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+        state.setCounter("allocs_per_edit",
+                         static_cast<double>(stats.blockAllocations + stats.largeAllocations - before) /
+                         EDITS_PER_SAMPLE);
+    });
+
+    registry.add("line_insert_text_middle", [](BenchState &state) {
+        Line line = makeLine(2000);
+        state.measure([&]() {
+            for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+                line.insertText(line.getTextLength() / 2, "abc");
+            }
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+
+    registry.add("line_delete_text_middle", [](BenchState &state) {
+        Line line = makeLine(EDITS_PER_SAMPLE * 3 + 2000);
+        state.measure([&]() {
+            for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+                line.deleteText(line.getTextLength() / 2, 3);
+            }
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+
+    registry.add("line_insert_with_replace", [](BenchState &state) {
+        Line line = makeLine(4000);
+        state.measure([&]() {
+            for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+                line.insertWithReplace((i * 37) % 4000, "replaced");
+            }
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+
+    registry.add("line_copy_owned", [](BenchState &state) {
+        Line line = makeLine(200);
+        std::vector<Line> copies(EDITS_PER_SAMPLE);
+        state.measure([&]() {
+            for (Line &copy : copies) {
+                copy = line;
+            }
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+
+    registry.add("utf8_scan_ascii", [](BenchState &state) {
+        std::string text(state.scaled(1 << 20), 'x');
+        volatile size_t chars = 0;
+        state.measure([&]() {
+            chars = scanUtf8(text.data(), text.size()).chars;
+        });
+        state.setBytes(text.size());
+    });
+
+    registry.add("utf8_scan_multibyte", [](BenchState &state) {
+        std::string text = makeUtf8(state.scaled(1 << 19));
+        volatile size_t chars = 0;
+        state.measure([&]() {
+            chars = scanUtf8(text.data(), text.size()).chars;
+        });
+        state.setBytes(text.size());
+    });
+
+    registry.add("line_column_lookup_multibyte", [](BenchState &state) {
+        size_t count = state.scaled(1 << 16);
+        std::string text = makeUtf8(count);
+        Line line;
+        line.replaceText(0, 0, text.data(), text.size());
+        volatile size_t sink = 0;
+        state.measure([&]() {
+            for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+                size_t column = (i * 7919) % count;
+                sink = line.columnOf(line.byteOffsetOf(column));
+            }
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+
+    registry.add("line_insert_column_multibyte", [](BenchState &state) {
+        size_t count = state.scaled(1 << 16);
+        std::string text = makeUtf8(count);
+        Line line;
+        line.replaceText(0, 0, text.data(), text.size());
+        state.measure([&]() {
+            for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+                size_t pos = line.byteOffsetOf((i * 7919) % count);
+                line.replaceText(pos, 0, "ї", 2);
+            }
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+}
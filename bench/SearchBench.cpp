@@ -0,0 +1,184 @@
+#include "Bench.h"
+#include "Cases.h"
+#include "Generators.h"
+#include "../MultiSearch.h"
+#include "../TextSearch.h"
+#include "../TextStorage.h"
+
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Corpus {
+    std::string text;
+    std::vector<std::string> lines;
+    std::unique_ptr<TempFile> file;
+    std::unique_ptr<TextStorage> storage;
+
+    void prepare(BenchState &state) {
+        if (!text.empty()) {
+            return;
+        }
+        text = makeLogDocument(state.scaled(200000));
+        lines = splitLines(text);
+        file.reset(new TempFile(text));
+        storage.reset(new TextStorage());
+        storage->loadFromFile(file->getPath());
+    }
+};
+
+// The loop TextStorage::searchText ran before TextSearch, kept as a baseline.
+size_t strstrLoop(const std::vector<std::string> &lines, const char *pattern) {
+    size_t found = 0;
+    for (const std::string &line : lines) {
+        const char *pos = std::strstr(line.c_str(), pattern);
+        while (pos) {
+            found++;
+            pos = std::strstr(pos + 1, pattern);
+        }
+    }
+    return found;
+}
+
+size_t engineLines(const std::vector<std::string> &lines, const TextSearch &search) {
+    std::vector<size_t> positions;
+    size_t found = 0;
+    for (const std::string &line : lines) {
+        positions.clear();
+        search.findAll(line.data(), line.size(), positions);
+        found += positions.size();
+    }
+    return found;
+}
+
+// A few words that occur in the log corpus plus random keywords that
+// mostly do not.
+std::vector<std::string> makeKeywords(size_t count) {
+    std::vector<std::string> keywords = {"timeout", "session", "ERROR", "upstream latency"};
+    std::mt19937 rng(13);
+    while (keywords.size() < count) {
+        std::string keyword(5 + rng() % 6, ' ');
+        for (char &c : keyword) {
+            c = static_cast<char>('a' + rng() % 26);
+        }
+        keywords.push_back(keyword);
+    }
+    keywords.resize(count);
+    return keywords;
+}
+
+volatile size_t sink;
+
+}
+
+void registerSearchBenchmarks(BenchRegistry &registry) {
+    std::shared_ptr<Corpus> corpus = std::make_shared<Corpus>();
+    const char *pattern = "upstream latency";
+
+    registry.add("search_strstr_lines", [corpus, pattern](BenchState &state) {
+        corpus->prepare(state);
+        state.measure([&]() {
+            sink = strstrLoop(corpus->lines, pattern);
+        });
+        state.setBytes(corpus->text.size());
+    });
+
+    registry.add("search_engine_lines", [corpus, pattern](BenchState &state) {
+        corpus->prepare(state);
+        TextSearch search(pattern, std::strlen(pattern), SearchOptions());
+        state.measure([&]() {
+            sink = engineLines(corpus->lines, search);
+        });
+        state.setBytes(corpus->text.size());
+    });
+
+    registry.add("search_engine_block", [corpus, pattern](BenchState &state) {
+        corpus->prepare(state);
+        TextSearch search(pattern, std::strlen(pattern), SearchOptions());
+        std::vector<size_t> positions;
+        state.measure([&]() {
+            search.findAll(corpus->text.data(), corpus->text.size(), positions);
+        });
+        sink = positions.size();
+        state.setBytes(corpus->text.size());
+    });
+
+    registry.add("search_engine_block_ignore_case", [corpus](BenchState &state) {
+        corpus->prepare(state);
+        SearchOptions options;
+        options.ignoreCase = true;
+        TextSearch search("ERROR", 5, options);
+        std::vector<size_t> positions;
+        state.measure([&]() {
+            search.findAll(corpus->text.data(), corpus->text.size(), positions);
+        });
+        sink = positions.size();
+        state.setBytes(corpus->text.size());
+    });
+
+    for (size_t count : {8, 256}) {
+        registry.add("search_multi_block_" + std::to_string(count), [corpus, count](BenchState &state) {
+            corpus->prepare(state);
+            MultiSearch search(makeKeywords(count), SearchOptions());
+            std::vector<PatternMatch> matches;
+            state.measure([&]() {
+                search.findAll(corpus->text.data(), corpus->text.size(), matches);
+            });
+            sink = matches.size();
+            state.setBytes(corpus->text.size());
+            state.setCounter("states", search.getStateCount());
+        });
+    }
+
+    registry.add("storage_find_text_each_16", [corpus](BenchState &state) {
+        corpus->prepare(state);
+        std::vector<std::string> keywords = makeKeywords(16);
+        state.measure([&]() {
+            for (const std::string &keyword : keywords) {
+                sink = corpus->storage->findText(keyword.c_str(), SearchOptions()).size();
+            }
+        });
+        state.setBytes(corpus->text.size() * keywords.size());
+    });
+
+    registry.add("storage_find_patterns_256", [corpus](BenchState &state) {
+        corpus->prepare(state);
+        std::vector<std::string> keywords = makeKeywords(256);
+        state.measure([&]() {
+            sink = corpus->storage->findPatterns(keywords, SearchOptions()).size();
+        });
+        state.setBytes(corpus->text.size());
+    });
+
+    registry.add("storage_find_text", [corpus, pattern](BenchState &state) {
+        corpus->prepare(state);
+        state.measure([&]() {
+            sink = corpus->storage->findText(pattern, SearchOptions()).size();
+        });
+        state.setBytes(corpus->text.size());
+    });
+
+    registry.add("storage_find_text_whole_word", [corpus](BenchState &state) {
+        corpus->prepare(state);
+        SearchOptions options;
+        options.wholeWord = true;
+        state.measure([&]() {
+            sink = corpus->storage->findText("miss", options).size();
+        });
+        state.setBytes(corpus->text.size());
+    });
+
+    registry.add("storage_search_text_all_threads", [corpus, pattern](BenchState &state) {
+        corpus->prepare(state);
+        SearchOptions options;
+        options.threads = 0;
+        state.measure([&]() {
+            corpus->storage->searchText(pattern, options);
+        });
+        state.setBytes(corpus->text.size());
+    });
+}
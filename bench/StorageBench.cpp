@@ -0,0 +1,430 @@
+#include "Bench.h"
+#include "Cases.h"
+#include "Generators.h"
+#include "../Compression.h"
+#include "../TextStorage.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const size_t EDITS_PER_SAMPLE = 1000;
+
+volatile size_t sink;
+
+// Documents are generated once per run and shared by the samples.
+struct SharedDocument {
+    std::string text;
+    std::unique_ptr<TempFile> file;
+
+    const char *path(BenchState &state, bool source) {
+        if (!file) {
+            size_t lineCount = state.scaled(200000);
+            text = source ? makeSourceDocument(lineCount) : makeLogDocument(lineCount);
+            file.reset(new TempFile(text));
+        }
+        return file->getPath();
+    }
+};
+
+double allocationsSince(const ArenaStats &before, const ArenaStats &after) {
+    return static_cast<double>(after.blockAllocations + after.largeAllocations - before.blockAllocations -
+                               before.largeAllocations);
+}
+
+void editEveryNthLine(TextStorage &storage, size_t edits) {
+    size_t stride = storage.getLineCount() / edits + 1;
+    for (size_t i = 0; i < edits; ++i) {
+        storage.insertText((i * stride) % storage.getLineCount(), 0, "edit ");
+    }
+}
+
+// Lines borrowed from `text`, which must outlive them, with `edits` of them
+// prefixed the way editEveryNthLine does it.
+Rope<Line> borrowLines(const std::string &text, size_t edits) {
+    Rope<Line> lines;
+    for (size_t start = 0; start < text.size();) {
+        size_t end = std::min(text.find('\n', start), text.size());
+        lines.push_back(Line::borrow(text.data() + start, end - start));
+        start = end + 1;
+    }
+    size_t stride = edits ? lines.size() / edits + 1 : 0;
+    for (size_t i = 0; i < edits; ++i) {
+        lines.update((i * stride) % lines.size(), [](Line &line) {
+            line.insertText(0, "edit ");
+        });
+    }
+    return lines;
+}
+
+}
+
+void registerStorageBenchmarks(BenchRegistry &registry) {
+    registry.add("storage_add_new_line", [](BenchState &state) {
+        size_t count = state.scaled(100000);
+        TextStorage storage;
+        state.measure([&]() {
+            for (size_t i = 0; i < count; ++i) {
+                storage.addNewLine();
+            }
+        });
+        state.setItems(count);
+        state.setCounter("arena_bytes_per_line", static_cast<double>(storage.getArenaStats().bytesReserved) / count);
+    });
+
+    registry.add("storage_type_lines", [](BenchState &state) {
+        size_t count = state.scaled(20000);
+        TextStorage storage;
+        state.measure([&]() {
+            for (size_t i = 0; i < count; ++i) {
+                for (size_t word = 0; word < 6; ++word) {
+                    storage.appendText(i, "token ");
+                }
+                storage.addNewLine();
+            }
+        });
+        state.setItems(count * 7);
+        state.setCounter("allocs_per_edit", allocationsSince(ArenaStats(), storage.getArenaStats()) / (count * 7));
+        state.setCounter("arena_bytes_per_line", static_cast<double>(storage.getArenaStats().bytesReserved) / count);
+    });
+
+    std::shared_ptr<SharedDocument> log = std::make_shared<SharedDocument>();
+    std::shared_ptr<SharedDocument> source = std::make_shared<SharedDocument>();
+
+    registry.add("storage_insert_text", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        ArenaStats before = storage.getArenaStats();
+        state.measure([&]() {
+            editEveryNthLine(storage, EDITS_PER_SAMPLE);
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+        state.setCounter("allocs_per_edit", allocationsSince(before, storage.getArenaStats()) / EDITS_PER_SAMPLE);
+    });
+
+    // Same edits with the document journaled: grouped as configured by
+    // default, then synced on every edit.
+    for (size_t groupEdits : {size_t(JOURNAL_GROUP_EDITS), size_t(0)}) {
+        std::string name = groupEdits ? "storage_insert_text_journal" : "storage_insert_text_journal_sync";
+        registry.add(name, [log, groupEdits](BenchState &state) {
+            TextStorage storage;
+            storage.setJournaling(true);
+            storage.setJournalGroup(groupEdits, JOURNAL_GROUP_INTERVAL_MS);
+            storage.loadFromFile(log->path(state, false));
+            state.measure([&]() {
+                editEveryNthLine(storage, EDITS_PER_SAMPLE);
+            });
+            state.setItems(EDITS_PER_SAMPLE);
+            state.setCounter("syncs_per_edit", static_cast<double>(storage.getJournal().getSyncs()) /
+                                               storage.getJournal().getRecords());
+            state.setCounter("journal_bytes_per_edit", static_cast<double>(storage.getJournal().getBytes()) /
+                                                       storage.getJournal().getRecords());
+        });
+    }
+
+    registry.add("storage_copy_document", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        storage.replaceAll(" ", "  ", SearchOptions());
+        size_t reserved = storage.getArenaStats().bytesReserved;
+        state.measure([&]() {
+            storage.newDocument(true);
+            storage.closeDocument();
+        });
+        state.setItems(storage.getLineCount());
+        state.setCounter("arena_bytes_per_copy", static_cast<double>(storage.getArenaStats().bytesReserved -
+                                                                     reserved));
+    });
+
+    registry.add("storage_apply_edits", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        size_t stride = storage.getLineCount() / EDITS_PER_SAMPLE + 1;
+        std::vector<TextEdit> edits;
+        for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+            edits.push_back({(i * stride) % storage.getLineCount(), 0, 0, "edit "});
+        }
+        state.measure([&]() {
+            storage.applyEdits(edits);
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+
+    registry.add("storage_undo", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        editEveryNthLine(storage, EDITS_PER_SAMPLE);
+        state.measure([&]() {
+            for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+                storage.undo();
+            }
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+
+    registry.add("storage_undo_spilled", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        storage.setHistoryBudget(0);
+        editEveryNthLine(storage, EDITS_PER_SAMPLE);
+        state.measure([&]() {
+            for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+                storage.undo();
+            }
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+
+    registry.add("storage_spill_load_record", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        storage.loadFromFile(log->path(state, false));
+        state.measure([&]() {
+            storage.setHistoryBudget(0);
+        });
+        storage.setHistoryBudget(DEFAULT_HISTORY_BUDGET);
+        state.setBytes(storage.getSpilledHistoryRawBytes());
+        state.setCounter("compression_ratio", static_cast<double>(storage.getSpilledHistoryRawBytes()) /
+                                              storage.getSpilledHistoryBytes());
+    });
+
+    registry.add("compress_lz_log", [log](BenchState &state) {
+        log->path(state, false);
+        std::string packed;
+        state.measure([&]() {
+            compressLz(log->text.data(), log->text.size(), packed);
+        });
+        state.setBytes(log->text.size());
+        state.setCounter("compression_ratio", static_cast<double>(log->text.size()) / packed.size());
+    });
+
+    registry.add("decompress_lz_log", [log](BenchState &state) {
+        log->path(state, false);
+        std::string packed;
+        compressLz(log->text.data(), log->text.size(), packed);
+        std::string restored(log->text.size(), '\0');
+        state.measure([&]() {
+            sink = decompressLz(packed.data(), packed.size(), &restored[0], restored.size());
+        });
+        state.setBytes(log->text.size());
+    });
+
+    registry.add("storage_redo", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        editEveryNthLine(storage, EDITS_PER_SAMPLE);
+        for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+            storage.undo();
+        }
+        state.measure([&]() {
+            for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+                storage.redo();
+            }
+        });
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+
+    registry.add("storage_undo_load", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        state.measure([&]() {
+            storage.undo();
+            storage.redo();
+        });
+        state.setItems(2);
+    });
+
+    registry.add("storage_offset_round_trip", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        size_t length = storage.getDocumentLength();
+        size_t checksum = 0;
+        state.measure([&]() {
+            for (size_t i = 0; i < EDITS_PER_SAMPLE; ++i) {
+                size_t lineIndex, pos, offset;
+                storage.offsetToPosition((i * 7919 * 7907) % length, lineIndex, pos);
+                storage.positionToOffset(lineIndex, pos, offset);
+                checksum += offset;
+            }
+        });
+        sink = checksum;
+        state.setItems(EDITS_PER_SAMPLE);
+    });
+
+    registry.add("storage_load_log", [log](BenchState &state) {
+        const char *path = log->path(state, false);
+        TextStorage storage;
+        state.measure([&]() {
+            storage.loadFromFile(path);
+        });
+        state.setBytes(log->text.size());
+    });
+
+    registry.add("storage_load_async_first_line", [log](BenchState &state) {
+        const char *path = log->path(state, false);
+        TextStorage storage;
+        size_t length = 0;
+        state.measure([&]() {
+            storage.loadFromFileAsync(path);
+            std::string line;
+            storage.textAt(0, 80, line);
+            length = line.size();
+        });
+        storage.waitForLoad();
+        sink = length;
+    });
+
+    registry.add("storage_load_async", [log](BenchState &state) {
+        const char *path = log->path(state, false);
+        TextStorage storage;
+        state.measure([&]() {
+            storage.loadFromFileAsync(path);
+            storage.waitForLoad();
+        });
+        state.setBytes(log->text.size());
+    });
+
+    registry.add("storage_load_source", [source](BenchState &state) {
+        const char *path = source->path(state, true);
+        TextStorage storage;
+        state.measure([&]() {
+            storage.loadFromFile(path);
+        });
+        state.setBytes(source->text.size());
+    });
+
+    registry.add("storage_print_range", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        size_t middle = storage.getLineCount() / 2;
+        state.measure([&]() {
+            storage.printRange(middle, PRINT_PAGE_LINES);
+            storage.printNextPage();
+            storage.printPreviousPage();
+        });
+        state.setItems(3 * PRINT_PAGE_LINES);
+    });
+
+    registry.add("storage_print_text", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        storage.insertText(0, 0, "edit ");
+        state.measure([&]() {
+            storage.printText();
+        });
+        state.setBytes(storage.getDocumentLength());
+    });
+
+    registry.add("storage_write_text", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        storage.insertText(0, 0, "edit ");
+        int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        state.measure([&]() {
+            storage.writeText(fd);
+        });
+        close(fd);
+        state.setBytes(storage.getDocumentLength());
+    });
+
+    registry.add("diff_lines_scattered", [log](BenchState &state) {
+        log->path(state, false);
+        Rope<Line> before = borrowLines(log->text, 0);
+        Rope<Line> after = borrowLines(log->text, 100);
+        size_t changes = 0;
+        state.measure([&]() {
+            changes = diffLines(before, after).size();
+        });
+        state.setBytes(log->text.size());
+        state.setCounter("changes", changes);
+    });
+
+    registry.add("storage_reload_scattered", [log](BenchState &state) {
+        const char *original = log->path(state, false);
+        std::vector<std::string> lines = splitLines(log->text);
+        std::string edited;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            edited += i % (lines.size() / 100 + 1) == 0 ? "edit " + lines[i] : lines[i];
+            edited += '\n';
+        }
+        TempFile editedFile(edited);
+        TextStorage storage;
+        storage.loadFromFile(original);
+        state.measure([&]() {
+            storage.reloadFromFile(editedFile.getPath());
+            storage.reloadFromFile(original);
+        });
+        state.setItems(2);
+    });
+
+    registry.add("storage_replace_all", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        size_t replaced = 0;
+        state.measure([&]() {
+            replaced = storage.replaceAll("session", "connection", SearchOptions());
+        });
+        state.setBytes(log->text.size());
+        state.setCounter("replaced", replaced);
+    });
+
+    registry.add("storage_replace_all_undo", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        storage.replaceAll("session", "connection", SearchOptions());
+        state.measure([&]() {
+            storage.undo();
+            storage.redo();
+        });
+    });
+
+    registry.add("storage_replace_all_interned", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        storage.setInterning(true);
+        size_t replaced = 0;
+        state.measure([&]() {
+            replaced = storage.replaceAll("session", "connection", SearchOptions());
+            storage.undo();
+        });
+        state.setBytes(log->text.size());
+        state.setCounter("replaced", replaced);
+    });
+
+    registry.add("storage_save_mapped", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        TempFile output;
+        state.measure([&]() {
+            storage.saveToFile(output.getPath());
+        });
+        state.setBytes(log->text.size());
+    });
+
+    registry.add("storage_save_one_edit", [log](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(log->path(state, false));
+        storage.insertText(storage.getLineCount() / 2, 0, "edit ");
+        TempFile output;
+        state.measure([&]() {
+            storage.saveToFile(output.getPath());
+        });
+        state.setBytes(log->text.size() + 5);
+    });
+
+    registry.add("storage_save_edited", [source](BenchState &state) {
+        TextStorage storage;
+        storage.loadFromFile(source->path(state, true));
+        editEveryNthLine(storage, storage.getLineCount());
+        TempFile output;
+        state.measure([&]() {
+            storage.saveToFile(output.getPath());
+        });
+        state.setBytes(source->text.size() + storage.getLineCount() * 5);
+    });
+}
@@ -0,0 +1,27 @@
+#include "Bench.h"
+#include "Cases.h"
+
+#include <vector>
+
+// Benchmark driver for the editor core. Run with --list to see the cases,
+// --filter to pick some of them and --json to keep the results for
+// comparison between releases.
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!BenchRunner::parseOptions(argc, argv, options)) {
+        return 1;
+    }
+    BenchRegistry registry;
+    registerLineBenchmarks(registry);
+    registerStorageBenchmarks(registry);
+    registerSearchBenchmarks(registry);
+    registerCipherBenchmarks(registry);
+
+    BenchRunner runner(options);
+    std::vector<BenchResult> results = runner.run(registry);
+    if (options.list) {
+        return 0;
+    }
+    BenchRunner::printTable(results);
+    return runner.writeJson(results) ? 0 : 1;
+}
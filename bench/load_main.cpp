@@ -0,0 +1,203 @@
+#include "Generators.h"
+#include "../Daemon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct LoadOptions {
+    std::string socketPath;
+    std::string filePath;
+    size_t clients;
+    size_t requests;
+    unsigned writePercent;
+    unsigned searchPercent;
+    size_t lines;
+
+    LoadOptions() : clients(4), requests(20000), writePercent(10), searchPercent(1), lines(100000) {}
+};
+
+struct ClientResult {
+    std::vector<double> readNs;
+    std::vector<double> writeNs;
+    size_t errors;
+    bool failed;
+
+    ClientResult() : errors(0), failed(false) {}
+};
+
+bool parseOptions(int argc, char *argv[], LoadOptions &options) {
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--socket") == 0 && hasValue) {
+            options.socketPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--file") == 0 && hasValue) {
+            options.filePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--clients") == 0 && hasValue) {
+            options.clients = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--requests") == 0 && hasValue) {
+            options.requests = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--writes") == 0 && hasValue) {
+            options.writePercent = std::min(100ul, std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--searches") == 0 && hasValue) {
+            options.searchPercent = std::min(100ul, std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--lines") == 0 && hasValue) {
+            options.lines = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            std::cerr << "Usage: " << argv[0]
+                      << " [--socket PATH] [--file PATH] [--clients N] [--requests N] [--writes PERCENT]"
+                      << " [--searches PERCENT] [--lines N]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads are whole-document searches (--searches percent of them), single
+// lines and short range copies; writes insert a word and delete it again so
+// the document keeps its size.
+void runClient(const LoadOptions &options, const std::string &filePath, unsigned seed, ClientResult &result) {
+    DaemonClient client;
+    bool ok;
+    std::string payload;
+    if (!client.connect(options.socketPath.c_str()) || !client.request("open " + filePath, ok, payload) || !ok) {
+        std::cerr << "Could not open " << filePath << ": " << payload << std::endl;
+        result.failed = true;
+        return;
+    }
+    if (!client.request("info", ok, payload) || !ok) {
+        result.failed = true;
+        return;
+    }
+    size_t lineCount = std::max(1ul, std::strtoul(payload.c_str(), nullptr, 10));
+    std::mt19937 random(seed);
+    std::string request;
+    bool inserted = false;
+    size_t insertedLine = 0;
+    for (size_t i = 0; i < options.requests; ++i) {
+        bool write = random() % 100 < options.writePercent;
+        size_t line = random() % lineCount;
+        if (write) {
+            if (inserted) {
+                request = "delete " + std::to_string(insertedLine) + " 0 5";
+            } else {
+                insertedLine = line;
+                request = "insert " + std::to_string(line) + " 0 load ";
+            }
+            inserted = !inserted;
+        } else {
+            unsigned kind = random() % 100;
+            if (kind < options.searchPercent) {
+                request = "search-options w ERROR";
+            } else if (kind % 4 == 0) {
+                request = "copy " + std::to_string(line) + " 0 1";
+            } else {
+                request = "line " + std::to_string(line);
+            }
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!client.request(request, ok, payload)) {
+            std::cerr << "Connection lost" << std::endl;
+            result.failed = true;
+            return;
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        (write ? result.writeNs : result.readNs).push_back(ns);
+        result.errors += !ok;
+    }
+    if (inserted) {
+        client.request("delete " + std::to_string(insertedLine) + " 0 5", ok, payload);
+    }
+    client.request("quit", ok, payload);
+}
+
+double percentile(const std::vector<double> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+
+void printLatencies(const char *name, std::vector<double> &ns) {
+    std::sort(ns.begin(), ns.end());
+    std::cout << std::left << std::setw(8) << name << std::right << std::setw(10) << ns.size() << std::fixed
+              << std::setprecision(1) << std::setw(12) << percentile(ns, 0.5) / 1000 << std::setw(12)
+              << percentile(ns, 0.9) / 1000 << std::setw(12) << percentile(ns, 0.99) / 1000 << std::setw(12)
+              << percentile(ns, 0.999) / 1000 << std::setw(12) << (ns.empty() ? 0 : ns.back() / 1000) << "\n";
+}
+
+}
+
+// Load generator for the daemon mode: --clients connections each send
+// --requests requests against one document, --writes percent of them
+// edits and the rest reads, and the request rate and latency percentiles are reported. Without
+// --socket a daemon is started in this process; without --file a generated
+// log document of --lines lines is served.
+int main(int argc, char *argv[]) {
+    LoadOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+    std::unique_ptr<TempFile> document;
+    std::string filePath = options.filePath;
+    if (filePath.empty()) {
+        document.reset(new TempFile(makeLogDocument(options.lines)));
+        filePath = document->getPath();
+    }
+    std::unique_ptr<Daemon> daemon;
+    std::thread server;
+    if (options.socketPath.empty()) {
+        options.socketPath = "/tmp/text_editor_load." + std::to_string(getpid()) + ".sock";
+        daemon.reset(new Daemon(0, false, DEFAULT_HISTORY_BUDGET));
+        if (!daemon->listen(options.socketPath.c_str())) {
+            return 1;
+        }
+        server = std::thread(&Daemon::run, daemon.get());
+    }
+
+    std::vector<ClientResult> results(options.clients);
+    std::vector<std::thread> clients;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t c = 0; c < options.clients; ++c) {
+        clients.emplace_back(runClient, std::cref(options), std::cref(filePath), static_cast<unsigned>(c + 1),
+                             std::ref(results[c]));
+    }
+    for (std::thread &client : clients) {
+        client.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (daemon) {
+        daemon->stop();
+        server.join();
+    }
+
+    std::vector<double> reads;
+    std::vector<double> writes;
+    size_t errors = 0;
+    bool failed = false;
+    for (ClientResult &result : results) {
+        reads.insert(reads.end(), result.readNs.begin(), result.readNs.end());
+        writes.insert(writes.end(), result.writeNs.begin(), result.writeNs.end());
+        errors += result.errors;
+        failed = failed || result.failed;
+    }
+    size_t total = reads.size() + writes.size();
+    std::cout << total << " requests from " << options.clients << " clients in " << seconds << " s: "
+              << total / seconds << " requests/s, " << errors << " errors\n";
+    std::cout << "kind      requests     p50 us      p90 us      p99 us    p99.9 us      max us\n";
+    printLatencies("read", reads);
+    printLatencies("write", writes);
+    return failed ? 1 : 0;
+}
@@ -1,544 +1,80 @@
 #include <iostream>
-#include <fstream>
+#include <csignal>
 #include <cstring>
-#include <stack>
-#include <cctype>
-#include <dlfcn.h>
-#define INITIAL_CAPACITY 100
+#include <cstdlib>
+#include <string>
+#include "BatchScript.h"
+#include "CaesarLib.h"
+#include "Daemon.h"
+#include "TextStorage.h"
 
-typedef char* (*EncryptFunc)(char*, int);
-typedef char* (*DecryptFunc)(char*, int);
+namespace {
 
+Daemon* runningDaemon = nullptr;
 
-class CaesarLib {
-private:
-    void* handle;
-    EncryptFunc encrypt;
-    DecryptFunc decrypt;
-
-public:
-    CaesarLib(const char* libPath) {
-        try {
-            handle = dlopen(libPath, RTLD_LAZY);
-            if (!handle) {
-                throw std::runtime_error(dlerror());
-            }
-
-            encrypt = (EncryptFunc)dlsym(handle, "encrypt");
-            decrypt = (DecryptFunc)dlsym(handle, "decrypt");
-
-            char* error;
-            if ((error = dlerror()) != NULL) {
-                throw std::runtime_error(error);
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Error loading library or symbols: " << e.what() << std::endl;
-            std::cerr << "Path attempted: " << libPath << std::endl;
-            exit(1);
-        }
-    }
-
-    ~CaesarLib() {
-        if (handle) {
-            dlclose(handle);
-        }
-    }
-
-    char* encryptText(char* text, int shift) {
-        return encrypt(text, shift);
-    }
-
-    char* decryptText(char* text, int shift) {
-        return decrypt(text, shift);
-    }
-};
-
-class Line {
-private:
-    char *text;
-    size_t length;
-    size_t capacity;
-
-public:
-    Line() {
-        capacity = INITIAL_CAPACITY;
-        length = 0;
-        text = new char[capacity];
-        text[0] = '\0';
-    }
-
-    Line(const Line &other) {
-        capacity = other.capacity;
-        length = other.length;
-        text = new char[capacity];
-        std::strcpy(text, other.text);
-    }
-
-    Line &operator=(const Line &other) {
-        if (this != &other) {
-            delete[] text;
-            capacity = other.capacity;
-            length = other.length;
-            text = new char[capacity];
-            std::strcpy(text, other.text);
-        }
-        return *this;
-    }
-
-    ~Line() {
-        delete[] text;
-    }
-
-    void appendText(const char *str) {
-        size_t newLength = length + std::strlen(str);
-        if (newLength >= capacity) {
-            capacity = newLength + 1;
-            char *newText = new char[capacity];
-            std::strcpy(newText, text);
-            delete[] text;
-            text = newText;
-        }
-        std::strcat(text, str);
-        length = newLength;
-    }
-
-    void insertText(size_t pos, const char *str) {
-        if (pos > length) {
-            std::cerr << "Position out of bounds\n";
-            return;
-        }
-        size_t newLength = length + std::strlen(str);
-        if (newLength >= capacity) {
-            capacity = newLength + 1;
-            char *newText = new char[capacity];
-            std::strncpy(newText, text, pos);
-            newText[pos] = '\0';
-            std::strcat(newText, str);
-            std::strcat(newText, text + pos);
-            delete[] text;
-            text = newText;
-        } else {
-            std::memmove(text + pos + std::strlen(str), text + pos, length - pos + 1);
-            std::memcpy(text + pos, str, std::strlen(str));
-        }
-        length = newLength;
-    }
+void stopDaemon(int) {
+    runningDaemon->stop();
+}
 
-    void deleteText(size_t pos, size_t len) {
-        if (pos >= length || pos + len > length) {
-            std::cerr << "Position and length out of bounds\n";
-            return;
-        }
-        std::memmove(text + pos, text + pos + len, length - pos - len + 1);
-        length -= len;
-    }
+int serve(const TextStorage& settings, const char* socketPath) {
+    Daemon daemon(settings.getWorkerThreads(), settings.isJournaling(), settings.getHistoryBudget());
+    if (!daemon.listen(socketPath)) {
+        return 1;
+    }
+    runningDaemon = &daemon;
+    struct sigaction action = {};
+    action.sa_handler = stopDaemon;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    std::cout << "Serving on " << socketPath << std::endl;
+    daemon.run();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    runningDaemon = nullptr;
+    return 0;
+}
 
-    void insertWithReplace(size_t pos, const char *str) {
-        if (pos > length) {
-            std::cerr << "Position out of bounds\n";
-            return;
-        }
-        size_t strLength = std::strlen(str);
-        size_t newLength = pos + strLength;
+}
 
-        if (newLength >= capacity) {
-            capacity = newLength + 1;
-            char *newText = new char[capacity];
-            std::strncpy(newText, text, pos);
-            newText[pos] = '\0';
-            std::strcat(newText, str);
-            if (pos + strLength < length) {
-                std::strcat(newText, text + pos + strLength);
-            }
-            delete[] text;
-            text = newText;
+int main(int argc, char* argv[]) {
+    TextStorage storage;
+    int command;
+    char buffer[INITIAL_CAPACITY];
+    const char* batchScript = nullptr;
+    const char* socketPath = nullptr;
+    storage.setJournaling(true);
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            storage.setWorkerThreads(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--history-budget") == 0 && i + 1 < argc) {
+            storage.setHistoryBudget(std::strtoull(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--no-journal") == 0) {
+            storage.setJournaling(false);
+        } else if (std::strcmp(argv[i], "--intern") == 0) {
+            storage.setInterning(true);
+        } else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchScript = argv[++i];
+        } else if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
         } else {
-            std::strncpy(text + pos, str, strLength);
-            if (newLength < length) {
-                std::memmove(text + newLength, text + pos + strLength, length - pos - strLength + 1);
-            } else {
-                text[newLength] = '\0';
-            }
-        }
-
-        length = newLength;
-    }
-
-    const char* getText() const {
-        return text;
-    }
-
-    size_t getTextLength() const {
-        return length;
-    }
-};
-
-
-
-
-class TextStorage {
-private:
-    Line *lines;
-    size_t count;
-    size_t capacity;
-    char *clipboard;
-    std::stack<Line *> undoStack;
-    std::stack<Line *> redoStack;
-
-    void saveState() {
-        Line *currentState = new Line[count];
-        for (size_t i = 0; i < count; ++i) {
-            currentState[i].appendText(lines[i].getText());
-        }
-        undoStack.push(currentState);
-        while (!redoStack.empty()) {
-            delete[] redoStack.top();
-            redoStack.pop();
-        }
-    }
-
-    void deleteLines() {
-        delete[] lines;
-    }
-
-public:
-    TextStorage() {
-        capacity = INITIAL_CAPACITY;
-        count = 1;
-        lines = new Line[capacity];
-        clipboard = nullptr;
-    }
-
-    ~TextStorage() {
-        deleteLines();
-        if (clipboard) delete[] clipboard;
-        while (!undoStack.empty()) {
-            delete[] undoStack.top();
-            undoStack.pop();
-        }
-        while (!redoStack.empty()) {
-            delete[] redoStack.top();
-            redoStack.pop();
-        }
-    }
-
-    size_t getLineCount() const {
-        return count;
-    }
-
-    void appendText(size_t lineIndex, const char *text) {
-        if (lineIndex >= count) {
-            std::cerr << "Line index out of bounds\n";
-            return;
-        }
-        saveState();
-        lines[lineIndex].appendText(text);
-    }
-
-    void addNewLine() {
-        if (count >= capacity) {
-            capacity *= 2;
-            Line *newLines = new Line[capacity];
-            for (size_t i = 0; i < count; ++i) {
-                newLines[i] = lines[i];
-            }
-            delete[] lines;
-            lines = newLines;
-        }
-
-        lines[count++] = Line();
-    }
-
-    void saveToFile(const char *filename) const {
-        std::ofstream outFile(filename);
-        if (!outFile) {
-            std::cerr << "Error opening file for writing\n";
-            return;
-        }
-        for (size_t i = 0; i < count; ++i) {
-            outFile << lines[i].getText() << "\n";
-        }
-        outFile.close();
-        std::cout << "Text has been saved successfully\n";
-    }
-
-    void loadFromFile(const char *filename) {
-        std::ifstream inFile(filename);
-        if (!inFile) {
-            std::cerr << "Error opening file for reading\n";
-            return;
-        }
-        saveState();
-        deleteLines();
-        capacity = INITIAL_CAPACITY;
-        count = 0;
-        lines = new Line[capacity];
-        char buffer[INITIAL_CAPACITY];
-        while (inFile.getline(buffer, INITIAL_CAPACITY)) {
-            if (count >= capacity) {
-                capacity *= 2;
-                Line *newLines = new Line[capacity];
-                for (size_t i = 0; i < count; ++i) {
-                    newLines[i].appendText(lines[i].getText());
-                }
-                delete[] lines;
-                lines = newLines;
-            }
-            appendText(count++, buffer);
-        }
-        inFile.close();
-        std::cout << "Text has been loaded successfully\n";
-    }
-
-    void printText() const {
-        for (size_t i = 0; i < count; ++i) {
-            std::cout << lines[i].getText() << std::endl;
-        }
-    }
-
-    void insertText(size_t lineIndex, size_t pos, const char *text) {
-        if (lineIndex >= count) {
-            std::cerr << "Line index out of bounds\n";
-            return;
-        }
-        saveState();
-        lines[lineIndex].insertText(pos, text);
-    }
-
-    void searchText(const char *substring) const {
-        bool found = false;
-        for (size_t i = 0; i < count; ++i) {
-            const char *pos = std::strstr(lines[i].getText(), substring);
-            while (pos) {
-                std::cout << "Text is present in this position: " << i << " " << pos - lines[i].getText() << std::endl;
-                found = true;
-                pos = std::strstr(pos + 1, substring);
-            }
-        }
-        if (!found) {
-            std::cout << "Substring not found\n";
-        }
-    }
-
-    void deleteText(size_t lineIndex, size_t pos, size_t len) {
-        if (lineIndex >= count) {
-            std::cerr << "Line index out of bounds\n";
-            return;
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
         }
-        saveState();
-        lines[lineIndex].deleteText(pos, len);
     }
-
-    void undo() {
-        if (undoStack.empty()) {
-            std::cerr << "No more undo steps available\n";
-            return;
-        }
-        redoStack.push(lines);
-        lines = undoStack.top();
-        undoStack.pop();
-    }
-
-    void redo() {
-        if (redoStack.empty()) {
-            std::cerr << "No more redo steps available\n";
-            return;
-        }
-        undoStack.push(lines);
-        lines = redoStack.top();
-        redoStack.pop();
-    }
-
-    void cutText(size_t lineIndex, size_t pos, size_t len) {
-        if (lineIndex >= count) {
-            std::cerr << "Line index out of bounds\n";
-            return;
-        }
-
-        if (pos + len > lines[lineIndex].getTextLength()) {
-            std::cerr << "Position and length out of bounds\n";
-            return;
-        }
-        copyText(lineIndex, pos, len);
-        saveState();
-        lines[lineIndex].deleteText(pos, len);
-    }
-
-    void pasteText(size_t lineIndex, size_t pos) {
-        if (lineIndex >= count) {
-            std::cerr << "Line index out of bounds\n";
-            return;
-        }
-        if (!clipboard) {
-            std::cerr << "Clipboard is empty\n";
-            return;
-        }
-        saveState();
-        lines[lineIndex].insertText(pos, clipboard);
-    }
-
-    void copyText(size_t lineIndex, size_t pos, size_t len) {
-        if (lineIndex >= count) {
-            std::cerr << "Line index out of bounds\n";
-            return;
-        }
-        const char *lineText = lines[lineIndex].getText();
-        if (pos + len > std::strlen(lineText)) {
-            std::cerr << "Position and length out of bounds\n";
-            return;
-        }
-        if (clipboard) {
-            delete[] clipboard;
-        }
-        clipboard = new char[len + 1];
-        std::strncpy(clipboard, lineText + pos, len);
-        clipboard[len] = '\0';
-    }
-
-    void insertWithReplace(size_t lineIndex, size_t pos, const char *text) {
-        if (lineIndex >= count) {
-            std::cerr << "Line index out of bounds\n";
-            return;
-        }
-        saveState();
-        lines[lineIndex].insertWithReplace(pos, text);
-    }
-    void encryptText(int shift, CaesarLib& caesarLib) {
-        for (size_t i = 0; i < count; ++i) {
-            const char* currentText = lines[i].getText();
-            char* textCopy = new char[strlen(currentText) + 1];
-            strcpy(textCopy, currentText);
-
-            char* encrypted = caesarLib.encryptText(textCopy, shift);
-            lines[i].insertWithReplace(0, encrypted);
-
-            delete[] encrypted;
-            delete[] textCopy;
-        }
+    if (socketPath) {
+        return serve(storage, socketPath);
     }
-
-    void decryptText(int shift, CaesarLib& caesarLib) {
-        for (size_t i = 0; i < count; ++i) {
-            const char* currentText = lines[i].getText();
-            char* textCopy = new char[strlen(currentText) + 1];
-            strcpy(textCopy, currentText);
-
-            char* decrypted = caesarLib.decryptText(textCopy, shift);
-            lines[i].insertWithReplace(0, decrypted);
-
-            delete[] decrypted;
-            delete[] textCopy;
-        }
+    if (batchScript) {
+        return runBatch(storage, batchScript) == 0 ? 0 : 1;
     }
-    void encryptFile(const char* inputFileName, const char* outputFileName, int shift, CaesarLib& caesarLib) {
-        std::ifstream inputFile(inputFileName);
-        if (!inputFile) {
-            std::cerr << "Error opening input file: " << inputFileName << std::endl;
-            return;
-        }
-
-        std::ofstream outputFile(outputFileName);
-        if (!outputFile) {
-            std::cerr << "Error opening output file: " << outputFileName << std::endl;
-            inputFile.close();
-            return;
-        }
-
-        std::string line;
-        while (std::getline(inputFile, line)) {
-            char* encrypted = caesarLib.encryptText(const_cast<char*>(line.c_str()), shift);
-            outputFile << encrypted << std::endl;
-            delete[] encrypted;
-        }
-
-        inputFile.close();
-        outputFile.close();
-        std::cout << "Encryption completed successfully.\n";
-    }
-
-    void decryptFile(const char* inputFileName, const char* outputFileName, int shift, CaesarLib& caesarLib) {
-        std::ifstream inputFile(inputFileName);
-        if (!inputFile) {
-            std::cerr << "Error opening input file: " << inputFileName << std::endl;
-            return;
-        }
-
-        std::ofstream outputFile(outputFileName);
-        if (!outputFile) {
-            std::cerr << "Error opening output file: " << outputFileName << std::endl;
-            inputFile.close();
-            return;
-        }
-
-        std::string line;
-        while (std::getline(inputFile, line)) {
-            char* decrypted = caesarLib.decryptText(const_cast<char*>(line.c_str()), shift);
-            outputFile << decrypted << std::endl;
-            delete[] decrypted;
-        }
-
-        inputFile.close();
-        outputFile.close();
-        std::cout << "Decryption completed successfully.\n";
-    }
-
-    typedef enum {
-        append_text = 1,
-        start_new_line,
-        save_to_file,
-        load_from_file,
-        print_current_text,
-        insert_text_by_index,
-        search_text,
-        delete_text,
-        undo_action,
-        redo_action,
-        cut_text,
-        paste_text,
-        copy_text,
-        insert_with_replace,
-        encrypt_text,
-        decrypt_text,
-        encrypt_file,
-        decrypt_file,
-        exit_program = 0
-    } Command;
-
-    void printHelpInfo() {
-        std::cout << "> Choose the command:\n";
-        std::cout << "1. Append text symbols to the end\n";
-        std::cout << "2. Start a new line\n";
-        std::cout << "3. Save text to file\n";
-        std::cout << "4. Load text from file\n";
-        std::cout << "5. Print the current text to console\n";
-        std::cout << "6. Insert text by line and symbol index\n";
-        std::cout << "7. Search text\n";
-        std::cout << "8. Delete text\n";
-        std::cout << "9. Undo\n";
-        std::cout << "10. Redo\n";
-        std::cout << "11. Cut text\n";
-        std::cout << "12. Paste text\n";
-        std::cout << "13. Copy text\n";
-        std::cout << "14. Insert text by line and symbol index with replacement\n";
-        std::cout << "15. Encryt text\n";
-        std::cout << "16. Decryt text\n";
-        std::cout << "17. Encryt file\n";
-        std::cout << "18. Decryt file\n";
-        std::cout << "0. Exit\n";
-    }
-};
-
-int main() {
-    TextStorage storage;
-    int command;
-    char buffer[INITIAL_CAPACITY];
-    CaesarLib caesarLib("/Users/arturnanivskij/Documents/text_editor/CaesarCipher.so");
+    CaesarLib caesarLib(CAESAR_LIB_PATH);
 
     while (true) {
         storage.printHelpInfo();
         std::cout << "> ";
         std::cin >> command;
         std::cin.ignore();
+        storage.pollLoad();
 
         switch (command) {
             case TextStorage::append_text:
@@ -668,6 +204,156 @@ int main() {
                 storage.decryptFile(buffer, outputFileName.c_str(), shift, caesarLib);
                 break;
             }
+            case TextStorage::search_text_with_options: {
+                std::cout << "Enter text to search: ";
+                std::string substring;
+                std::getline(std::cin, substring);
+                std::cout << "Enter options (i - ignore case, w - whole word): ";
+                std::cin.getline(buffer, sizeof(buffer));
+                SearchOptions options;
+                options.ignoreCase = std::strchr(buffer, 'i') != nullptr;
+                options.wholeWord = std::strchr(buffer, 'w') != nullptr;
+                options.threads = storage.getWorkerThreads();
+                storage.searchText(substring.c_str(), options);
+                break;
+            }
+            case TextStorage::search_multiple_patterns: {
+                std::cout << "Enter patterns separated by '|': ";
+                std::string list;
+                std::getline(std::cin, list);
+                std::cout << "Enter options (i - ignore case, w - whole word): ";
+                std::cin.getline(buffer, sizeof(buffer));
+                SearchOptions options;
+                options.ignoreCase = std::strchr(buffer, 'i') != nullptr;
+                options.wholeWord = std::strchr(buffer, 'w') != nullptr;
+                options.threads = storage.getWorkerThreads();
+                storage.searchPatterns(splitPatterns(list), options);
+                break;
+            }
+            case TextStorage::replace_all: {
+                std::cout << "Enter text to replace: ";
+                std::string pattern;
+                std::getline(std::cin, pattern);
+                std::cout << "Enter replacement text: ";
+                std::string replacement;
+                std::getline(std::cin, replacement);
+                std::cout << "Enter options (i - ignore case, w - whole word): ";
+                std::cin.getline(buffer, sizeof(buffer));
+                SearchOptions options;
+                options.ignoreCase = std::strchr(buffer, 'i') != nullptr;
+                options.wholeWord = std::strchr(buffer, 'w') != nullptr;
+                options.threads = storage.getWorkerThreads();
+                size_t replaced = storage.replaceAll(pattern.c_str(), replacement.c_str(), options);
+                std::cout << "Replaced " << replaced << " matches\n";
+                break;
+            }
+            case TextStorage::apply_edits: {
+                std::cout << "Enter edits as 'line position length text', one per line; an empty line applies them:\n";
+                std::vector<TextEdit> edits;
+                std::string entry;
+                std::string text;
+                while (std::getline(std::cin, entry) && !entry.empty()) {
+                    ScriptLine fields(entry.data(), entry.data() + entry.size());
+                    TextEdit edit;
+                    if (!fields.index(edit.line) || !fields.index(edit.pos) || !fields.index(edit.len)) {
+                        std::cerr << "Invalid edit: " << entry << "\n";
+                        continue;
+                    }
+                    edit.text = fields.text(text);
+                    edits.push_back(std::move(edit));
+                }
+                if (storage.applyEdits(std::move(edits))) {
+                    std::cout << "Edits applied\n";
+                }
+                break;
+            }
+            case TextStorage::new_document:
+            case TextStorage::copy_document: {
+                size_t index = storage.newDocument(command == TextStorage::copy_document);
+                std::cout << "Switched to document " << index << "\n";
+                break;
+            }
+            case TextStorage::switch_document: {
+                size_t index;
+                storage.listDocuments();
+                std::cout << "Choose the document: ";
+                std::cin >> index;
+                std::cin.ignore();
+                storage.switchDocument(index);
+                break;
+            }
+            case TextStorage::close_document:
+                if (storage.closeDocument()) {
+                    std::cout << "Switched to document " << storage.getCurrentDocument() << "\n";
+                }
+                break;
+            case TextStorage::recover_key: {
+                std::cout << "Enter the file name (empty for the current text): ";
+                std::cin.getline(buffer, sizeof(buffer));
+                KeyRecoveryResult result;
+                if (buffer[0] == '\0') {
+                    result = storage.recoverKey(true);
+                } else if (!storage.recoverFileKey(buffer, true, result)) {
+                    break;
+                }
+                TextStorage::printKeyRecovery(result);
+                break;
+            }
+            case TextStorage::load_in_background:
+                std::cout << "Enter the file name for loading: ";
+                std::cin.getline(buffer, sizeof(buffer));
+                storage.loadFromFileAsync(buffer);
+                break;
+            case TextStorage::print_load_progress:
+                storage.printLoadProgress();
+                break;
+            case TextStorage::print_range: {
+                size_t lineIndex, count;
+                std::cout << "Choose first line and number of lines: ";
+                std::cin >> lineIndex >> count;
+                std::cin.ignore();
+                storage.printRange(lineIndex, count);
+                break;
+            }
+            case TextStorage::print_next_page:
+                storage.printNextPage();
+                break;
+            case TextStorage::print_previous_page:
+                storage.printPreviousPage();
+                break;
+            case TextStorage::diff_with_file:
+                std::cout << "Enter the file name to compare with: ";
+                std::cin.getline(buffer, sizeof(buffer));
+                storage.diffWithFile(buffer);
+                break;
+            case TextStorage::diff_with_history: {
+                size_t steps;
+                std::cout << "Choose the number of undo steps to look back: ";
+                std::cin >> steps;
+                std::cin.ignore();
+                storage.diffHistory(steps);
+                break;
+            }
+            case TextStorage::reload_from_file:
+                std::cout << "Enter the file name (empty for the current file): ";
+                std::cin.getline(buffer, sizeof(buffer));
+                storage.reloadFromFile(buffer);
+                break;
+            case TextStorage::toggle_interning:
+                storage.setInterning(!storage.isInterning());
+                std::cout << "Line interning is " << (storage.isInterning() ? "on" : "off") << "\n";
+                break;
+            case TextStorage::print_intern_stats:
+                storage.printInternStats();
+                break;
+            case TextStorage::print_memory_stats:
+                storage.printMemoryStats();
+                break;
+            case TextStorage::print_operation_stats:
+                std::cout << "Enter the format (text or json): ";
+                std::cin.getline(buffer, sizeof(buffer));
+                storage.printOperationStats(std::strcmp(buffer, "json") == 0);
+                break;
             case TextStorage::exit_program:
                 std::cout << "Exiting the program.\n";
                 return 0;
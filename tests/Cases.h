@@ -0,0 +1,17 @@
+#ifndef TEXT_EDITOR_TEST_CASES_H
+#define TEXT_EDITOR_TEST_CASES_H
+
+#include "Test.h"
+
+void registerRopeTests(TestRegistry &registry);
+void registerUtf8Tests(TestRegistry &registry);
+void registerDiffTests(TestRegistry &registry);
+void registerHistoryTests(TestRegistry &registry);
+void registerEditTests(TestRegistry &registry);
+void registerInternTests(TestRegistry &registry);
+void registerJournalTests(TestRegistry &registry);
+void registerDaemonTests(TestRegistry &registry);
+void registerLoadTests(TestRegistry &registry);
+void registerSearchTests(TestRegistry &registry);
+
+#endif //TEXT_EDITOR_TEST_CASES_H
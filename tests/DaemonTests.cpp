@@ -0,0 +1,143 @@
+#include "Cases.h"
+#include "Scripts.h"
+#include "Daemon.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A daemon serving on a socket next to `file`, stopped and joined when the
+// scope ends.
+class TestDaemon {
+private:
+    std::string socketPath;
+    Daemon daemon;
+    std::thread server;
+    bool listening;
+
+public:
+    explicit TestDaemon(const TestFile &file)
+            : socketPath(file.getPath() + std::string(".sock")), daemon(2, false, 0),
+              listening(daemon.listen(socketPath.c_str())) {
+        if (listening) {
+            server = std::thread(&Daemon::run, &daemon);
+        }
+    }
+
+    ~TestDaemon() {
+        daemon.stop();
+        if (server.joinable()) {
+            server.join();
+        }
+    }
+
+    bool connect(DaemonClient &client) const {
+        return listening && client.connect(socketPath.c_str());
+    }
+};
+
+// The payload of an OK response; anything else fails the check.
+std::string ask(DaemonClient &client, const std::string &line) {
+    bool ok = false;
+    std::string payload;
+    CHECK(client.request(line, ok, payload) && ok);
+    return payload;
+}
+
+// Sessions opening one file share its resident copy. Closing drops only the
+// session's hold on it: the copy, edits included, stays loaded while any
+// other session holds it and is loaded afresh once the last one closed it.
+void daemonSessionsShareDocuments() {
+    TestFile file("first\nsecond\n");
+    char resolved[PATH_MAX];
+    if (!CHECK(realpath(file.getPath(), resolved))) {
+        return;
+    }
+    std::string open = "open " + std::string(file.getPath());
+    TestDaemon daemon(file);
+    DaemonClient first, second, third;
+    if (!CHECK(daemon.connect(first) && daemon.connect(second) && daemon.connect(third))) {
+        return;
+    }
+    ask(first, open);
+    ask(second, open);
+    ask(first, "insert 0 0 X");
+    CHECK(ask(second, "line 0") == "Xfirst");
+    ask(first, "close");
+    CHECK(ask(second, "documents") == std::string(resolved) + "\n");
+    ask(third, open);
+    CHECK(ask(third, "line 0") == "Xfirst");
+    ask(second, "close");
+    CHECK(ask(third, "line 0") == "Xfirst");
+    ask(third, "close");
+    CHECK(ask(first, "documents").empty());
+    ask(first, open);
+    CHECK(ask(first, "line 0") == "first");
+}
+
+// Writers on several connections prepend their letter to one document
+// while readers print it. Edits are exclusive, so no edit is lost and every
+// print shows whole edits: some letters in front of the untouched text.
+void daemonLocksEditsAgainstReads() {
+    const size_t sessions = 4, requests = 100;
+    TestFile file(makeDocument(200));
+    TextStorage loaded;
+    if (!CHECK(loaded.loadFromFile(file.getPath()))) {
+        return;
+    }
+    const std::string document = documentText(loaded) + "\n";
+    std::string open = "open " + std::string(file.getPath());
+    TestDaemon daemon(file);
+    std::vector<std::thread> threads;
+    std::vector<char> passed(2 * sessions, false);
+    for (size_t s = 0; s < 2 * sessions; ++s) {
+        threads.emplace_back([&, s]() {
+            DaemonClient client;
+            bool ok = false;
+            std::string payload;
+            if (!daemon.connect(client) || !client.request(open, ok, payload) || !ok) {
+                return;
+            }
+            bool writer = s < sessions;
+            std::string edit = "insert-at 0 " + std::string(1, static_cast<char>('a' + s));
+            for (size_t i = 0; i < requests; ++i) {
+                if (!client.request(writer ? edit : "print", ok, payload) || !ok) {
+                    return;
+                }
+                size_t prefix = payload.size() - std::min(payload.size(), document.size());
+                if (!writer && (payload.compare(prefix, std::string::npos, document) != 0 ||
+                                payload.find_first_not_of("abcd") != prefix)) {
+                    return;
+                }
+            }
+            passed[s] = true;
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (size_t s = 0; s < 2 * sessions; ++s) {
+        CHECK(passed[s]);
+    }
+    DaemonClient client;
+    if (!CHECK(daemon.connect(client))) {
+        return;
+    }
+    ask(client, open);
+    std::string expected = std::to_string(loaded.getLineCount()) + " " +
+                           std::to_string(loaded.getDocumentLength() + sessions * requests) + " " +
+                           std::to_string(loaded.getEditCount() + sessions * requests) + "\n";
+    CHECK(ask(client, "info") == expected);
+}
+
+}
+
+void registerDaemonTests(TestRegistry &registry) {
+    registry.add("daemon_sessions_share_documents", daemonSessionsShareDocuments);
+    registry.add("daemon_locks_edits_against_reads", daemonLocksEditsAgainstReads);
+}
@@ -0,0 +1,144 @@
+#include "Cases.h"
+#include "LineDiff.h"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+Rope<Line> makeLines(const std::vector<std::string> &texts) {
+    Rope<Line> lines;
+    for (const std::string &text : texts) {
+        Line line;
+        line.replaceText(0, 0, text.data(), text.size());
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+size_t commonSubsequence(const std::vector<std::string> &a, const std::vector<std::string> &b) {
+    std::vector<std::vector<size_t>> length(a.size() + 1, std::vector<size_t>(b.size() + 1));
+    for (size_t i = 1; i <= a.size(); ++i) {
+        for (size_t j = 1; j <= b.size(); ++j) {
+            length[i][j] = a[i - 1] == b[j - 1] ? length[i - 1][j - 1] + 1
+                                                : std::max(length[i - 1][j], length[i][j - 1]);
+        }
+    }
+    return length[a.size()][b.size()];
+}
+
+// Applies the changes to `a`, checking that they are ordered, non-empty and
+// positioned consistently on both sides, and counts the lines they remove.
+bool rebuild(const std::vector<std::string> &a, const std::vector<std::string> &b,
+             const std::vector<DiffChange> &changes, std::vector<std::string> &out, size_t &removed) {
+    size_t next = 0;
+    removed = 0;
+    for (const DiffChange &change : changes) {
+        if (!CHECK(change.oldFirst >= next) || !CHECK(change.oldCount || change.newCount) ||
+            !CHECK(change.oldFirst + change.oldCount <= a.size()) ||
+            !CHECK(change.newFirst + change.newCount <= b.size())) {
+            return false;
+        }
+        out.insert(out.end(), a.begin() + next, a.begin() + change.oldFirst);
+        if (!CHECK(out.size() == change.newFirst)) {
+            return false;
+        }
+        out.insert(out.end(), b.begin() + change.newFirst, b.begin() + change.newFirst + change.newCount);
+        next = change.oldFirst + change.oldCount;
+        removed += change.oldCount;
+    }
+    out.insert(out.end(), a.begin() + next, a.end());
+    return true;
+}
+
+// Small documents over tiny alphabets are full of repeated lines, the hard
+// case for pairing them up; the diff must rebuild the new side and keep a
+// longest common subsequence.
+void diffIsMinimal() {
+    std::mt19937 rng(1);
+    for (int round = 0; round < 5000; ++round) {
+        int alphabet = 1 + rng() % 6;
+        std::vector<std::string> a, b;
+        for (size_t n = rng() % 40; n > 0; --n) {
+            a.push_back(std::string(1, 'a' + rng() % alphabet) + (rng() % 3 == 0 ? std::string(20, 'z') : ""));
+        }
+        if (rng() % 2) {
+            b = a;
+            for (int edits = rng() % 5; edits > 0; --edits) {
+                size_t at = rng() % (b.size() + 1);
+                if (rng() % 2 && at < b.size()) {
+                    b.erase(b.begin() + at);
+                } else {
+                    b.insert(b.begin() + at, std::string(1, 'a' + rng() % alphabet));
+                }
+            }
+        } else {
+            for (size_t n = rng() % 40; n > 0; --n) {
+                b.push_back(std::string(1, 'a' + rng() % alphabet));
+            }
+        }
+        std::vector<DiffChange> changes = diffLines(makeLines(a), makeLines(b));
+        std::vector<std::string> rebuilt;
+        size_t removed;
+        if (!rebuild(a, b, changes, rebuilt, removed) || !CHECK(rebuilt == b) ||
+            !CHECK(a.size() - removed == commonSubsequence(a, b))) {
+            return;
+        }
+    }
+}
+
+// Large documents hit the search's cost limit or go through unique-line
+// anchoring; the result need not be minimal but must still be a valid edit.
+void diffRebuildsLargeDocuments() {
+    std::mt19937 rng(2);
+    for (int round = 0; round < 12; ++round) {
+        int alphabet = round % 3 == 0 ? 4 : round % 3 == 1 ? 300 : 100000;
+        std::vector<std::string> a, b;
+        for (size_t n = 2000 + rng() % 6000; n > 0; --n) {
+            a.push_back(std::to_string(rng() % alphabet));
+        }
+        if (round % 2) {
+            b = a;
+            std::shuffle(b.begin(), b.end(), rng);
+            b.resize(std::min<size_t>(b.size(), 2000 + rng() % 6000));
+        } else {
+            for (size_t n = 2000 + rng() % 6000; n > 0; --n) {
+                b.push_back(std::to_string(rng() % alphabet));
+            }
+        }
+        std::vector<DiffChange> changes = diffLines(makeLines(a), makeLines(b));
+        std::vector<std::string> rebuilt;
+        size_t removed;
+        if (!rebuild(a, b, changes, rebuilt, removed) || !CHECK(rebuilt == b)) {
+            return;
+        }
+    }
+}
+
+// Hunks merge changes closer than twice the context and carry GNU diff's
+// headers.
+void unifiedDiffHunks() {
+    std::vector<std::string> a = {"one", "two", "three", "four", "five", "six", "seven", "eight", "nine", "ten",
+                                  "eleven", "twelve"};
+    std::vector<std::string> b = a;
+    b[2] = "THREE";
+    b.push_back("thirteen");
+    Rope<Line> oldLines = makeLines(a), newLines = makeLines(b);
+    std::ostringstream out;
+    writeUnifiedDiff(oldLines, newLines, diffLines(oldLines, newLines), "old", "new", out);
+    CHECK(out.str() == "--- old\n+++ new\n"
+                       "@@ -1,6 +1,6 @@\n one\n two\n-three\n+THREE\n four\n five\n six\n"
+                       "@@ -10,3 +10,4 @@\n ten\n eleven\n twelve\n+thirteen\n");
+    CHECK(diffLines(oldLines, oldLines).empty());
+}
+
+}
+
+void registerDiffTests(TestRegistry &registry) {
+    registry.add("diff_is_minimal", diffIsMinimal);
+    registry.add("diff_rebuilds_large_documents", diffRebuildsLargeDocuments);
+    registry.add("diff_unified_hunks", unifiedDiffHunks);
+}
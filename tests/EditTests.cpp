@@ -0,0 +1,155 @@
+#include "Cases.h"
+#include "Scripts.h"
+#include "TextStorage.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// Every offset of the document maps to the line and column found by
+// walking the lines, and back; offsets inside a character map to nothing.
+// A line may hold newlines of its own (insertTextAt keeps them), so lines
+// are walked rather than split from the saved text.
+bool offsetsMatchLines(const TextStorage &storage) {
+    size_t offset = 0;
+    for (size_t lineIndex = 0; lineIndex < storage.getLineCount(); ++lineIndex) {
+        const Line &line = storage.getLine(lineIndex);
+        std::string text(line.getText(), line.getTextLength());
+        size_t column = 0;
+        for (size_t i = 0; i <= text.size(); ++i, ++offset) {
+            bool boundary = i == text.size() || (text[i] & 0xC0) != 0x80;
+            size_t foundLine, pos, back;
+            if (!CHECK(storage.offsetToPosition(offset, foundLine, pos) == boundary)) {
+                return false;
+            }
+            if (boundary && (!CHECK(foundLine == lineIndex && pos == column) ||
+                             !CHECK(storage.positionToOffset(lineIndex, column, back) && back == offset))) {
+                return false;
+            }
+            column += boundary;
+        }
+    }
+    size_t lineIndex, pos;
+    return CHECK(offset == storage.getDocumentLength()) && CHECK(!storage.offsetToPosition(offset, lineIndex, pos));
+}
+
+// The offset index is rebuilt by undo and redo along with the lines.
+void offsetsFollowHistory() {
+    TestFile file(makeDocument(12));
+    TextStorage storage;
+    if (!CHECK(storage.loadFromFile(file.getPath()))) {
+        return;
+    }
+    runScript(storage, 11, SCRIPT_EDITS);
+    if (!offsetsMatchLines(storage)) {
+        return;
+    }
+    size_t steps = 0;
+    while (storage.undo()) {
+        ++steps;
+        if (!offsetsMatchLines(storage)) {
+            return;
+        }
+    }
+    while (storage.redo()) {
+        --steps;
+        if (!offsetsMatchLines(storage)) {
+            return;
+        }
+    }
+    CHECK(steps == 0);
+}
+
+// Replaces leftmost first, without scanning the replacement again.
+std::string replaceInText(const std::string &text, const std::string &pattern, const std::string &replacement) {
+    std::string result;
+    size_t copied = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, copied)) {
+        result.append(text, copied, pos - copied).append(replacement);
+        copied = pos + pattern.size();
+    }
+    return result.append(text, copied, std::string::npos);
+}
+
+// A replacement over a loaded file, on several workers, is one undo step.
+// Case folding and whole words pick their matches like findText.
+void replaceAllMatchesModel() {
+    std::string document = makeDocument(3000);
+    TestFile file(document);
+    TextStorage storage;
+    if (!CHECK(storage.loadFromFile(file.getPath()))) {
+        return;
+    }
+    std::string before = documentText(storage);
+    size_t edits = storage.getEditCount();
+    SearchOptions options;
+    options.threads = 4;
+    CHECK(storage.replaceAll("ab", "[ab]", options) == 2000);
+    CHECK(storage.getEditCount() == edits + 1);
+    std::string after = documentText(storage);
+    CHECK(after == replaceInText(before, "ab", "[ab]"));
+    CHECK(storage.replaceAll("no such text", "x", options) == 0);
+    CHECK(storage.getEditCount() == edits + 1);
+    CHECK(storage.undo() && documentText(storage) == before);
+    CHECK(storage.redo() && documentText(storage) == after);
+
+    TextStorage small;
+    small.insertText(0, 0, "aaaa Aa aaa");
+    SearchOptions ignoreCase;
+    ignoreCase.ignoreCase = true;
+    CHECK(small.replaceAll("aa", "b", ignoreCase) == 4);
+    CHECK(documentText(small) == "bb b ba");
+    small.insertText(0, 0, "aa aaa aa_ aa ");
+    SearchOptions wholeWord;
+    wholeWord.wholeWord = true;
+    CHECK(small.replaceAll("aa", "x", wholeWord) == 2);
+    CHECK(documentText(small) == "x aaa aa_ x bb b ba");
+}
+
+// Edits given out of order land at their positions in the original text,
+// columns counting characters. Inserts at one position keep their order
+// ahead of a range starting there. A batch with an overlap or an edit
+// out of bounds changes nothing.
+void batchedEditsApplyInOrder() {
+    TextStorage storage;
+    storage.insertText(0, 0, "0123456789");
+    storage.addNewLine();
+    storage.insertText(1, 0, "a\u0457b\u20acc");
+    storage.addNewLine();
+    storage.insertText(2, 0, "xyz");
+    std::string before = documentText(storage);
+    size_t edits = storage.getEditCount();
+    CHECK(storage.applyEdits({{1, 1, 1, "I"},
+                              {0, 8, 2, ""},
+                              {0, 2, 0, "<"},
+                              {2, 3, 0, "!"},
+                              {0, 2, 3, "R"},
+                              {0, 5, 1, "F"},
+                              {0, 2, 0, ">"}}));
+    std::string after = documentText(storage);
+    CHECK(after == "01<>RF67\naIb\u20acc\nxyz!");
+    CHECK(storage.getEditCount() == edits + 1);
+    CHECK(storage.undo() && documentText(storage) == before);
+    CHECK(storage.redo() && documentText(storage) == after);
+
+    const std::vector<std::vector<TextEdit>> rejected = {
+            {{0, 1, 3, "a"}, {0, 3, 1, "b"}},
+            {{0, 2, 0, "x"}, {0, 1, 3, ""}},
+            {{3, 0, 0, "x"}},
+            {{2, 4, 1, ""}},
+            {{1, 0, 0, "x"}, {0, 8, 1, ""}},
+    };
+    for (const std::vector<TextEdit> &batch : rejected) {
+        CHECK(!storage.applyEdits(batch));
+        CHECK(storage.getEditCount() == edits + 1 && documentText(storage) == after);
+    }
+}
+
+}
+
+void registerEditTests(TestRegistry &registry) {
+    registry.add("offsets_follow_history", offsetsFollowHistory);
+    registry.add("replace_all_matches_model", replaceAllMatchesModel);
+    registry.add("batched_edits_apply_in_order", batchedEditsApplyInOrder);
+}
@@ -0,0 +1,54 @@
+#include "Cases.h"
+#include "Scripts.h"
+#include "TextStorage.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// Random scripts over a loaded file, whose lines start out borrowed from
+// the mapping, undone to the empty document and redone step by step.
+void undoRedoRoundTrip() {
+    TestFile file(makeDocument(40));
+    for (unsigned seed = 1; seed <= 6; ++seed) {
+        TextStorage storage;
+        std::vector<std::string> states = {documentText(storage)};
+        if (!CHECK(storage.loadFromFile(file.getPath()))) {
+            return;
+        }
+        std::vector<std::string> edited = runScript(storage, seed, SCRIPT_EDITS);
+        states.insert(states.end(), edited.begin(), edited.end());
+        if (!walkHistory(storage, states, 0)) {
+            return;
+        }
+    }
+}
+
+// With no memory budget every record is spilled as soon as it is made and
+// paged back in by undo and redo. The history limit drops the oldest
+// records while newer ones stay spilled, which compacts the spill file.
+void spillPageIn() {
+    TestFile file(makeDocument(200));
+    TextStorage storage;
+    storage.setHistoryBudget(0);
+    storage.setHistoryLimit(80);
+    if (!CHECK(storage.loadFromFile(file.getPath()))) {
+        return;
+    }
+    std::vector<std::string> states = runScript(storage, 3, SCRIPT_EDITS * 2);
+    if (!CHECK(states.size() > 81)) {
+        return;
+    }
+    CHECK(storage.getHistoryBytes() == 0);
+    CHECK(storage.getSpilledHistoryBytes() > 0);
+    CHECK(storage.getSpillFileBytes() <= 2 * storage.getSpilledHistoryBytes());
+    walkHistory(storage, states, states.size() - 81);
+}
+
+}
+
+void registerHistoryTests(TestRegistry &registry) {
+    registry.add("undo_redo_round_trip", undoRedoRoundTrip);
+    registry.add("spill_page_in", spillPageIn);
+}
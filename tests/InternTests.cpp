@@ -0,0 +1,60 @@
+#include "Cases.h"
+#include "Scripts.h"
+#include "TextStorage.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::string internStats(const TextStorage &storage) {
+    std::ostringstream captured;
+    std::streambuf *saved = std::cout.rdbuf(captured.rdbuf());
+    storage.printInternStats();
+    std::cout.rdbuf(saved);
+    return captured.str();
+}
+
+std::string textOf(const Line &line) {
+    return std::string(line.getText(), line.getTextLength());
+}
+
+// Turning interning on makes repeated arena lines share one buffer. An edit
+// copies the line it changes; its undo restores the text, not the sharing,
+// which bulk edits bring back. The stats count unique lines by content, not
+// by buffer.
+void internedLinesShareBuffers() {
+    static const char *const texts[] = {"a line repeated all over", "another repeated line", "a line of its own"};
+    TextStorage storage;
+    for (size_t i = 0; i < 30; ++i) {
+        if (i) {
+            storage.addNewLine();
+        }
+        storage.appendText(i, texts[i == 29 ? 2 : i % 2]);
+    }
+    storage.setInterning(true);
+    CHECK(storage.getLine(2).getText() == storage.getLine(0).getText());
+    CHECK(storage.getLine(1).getText() != storage.getLine(0).getText());
+    CHECK(internStats(storage).find("Unique lines: 3 of 30 (10%), 30 arena lines in 3 buffers") != std::string::npos);
+
+    storage.insertText(2, 0, "edited ");
+    CHECK(textOf(storage.getLine(0)) == texts[0] && textOf(storage.getLine(2)) == std::string("edited ") + texts[0]);
+    CHECK(storage.undo() && textOf(storage.getLine(2)) == texts[0]);
+    CHECK(internStats(storage).find("Unique lines: 3 of 30 (10%), 30 arena lines in 4 buffers") != std::string::npos);
+
+    CHECK(storage.applyEdits({{0, 0, 1, "A"}, {2, 0, 1, "A"}}));
+    CHECK(storage.getLine(2).getText() == storage.getLine(0).getText());
+
+    // An empty file loads as a document without lines.
+    TestFile file("");
+    TextStorage empty;
+    CHECK(empty.loadFromFile(file.getPath()) && empty.getLineCount() == 0);
+    CHECK(internStats(empty).find("Unique lines: 0 of 0 (0%)") != std::string::npos);
+}
+
+}
+
+void registerInternTests(TestRegistry &registry) {
+    registry.add("interned_lines_share_buffers", internedLinesShareBuffers);
+}
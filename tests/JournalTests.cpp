@@ -0,0 +1,63 @@
+#include "Cases.h"
+#include "Scripts.h"
+#include "TextStorage.h"
+
+#include <algorithm>
+#include <csignal>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// A child process edits a journaled document and is killed; loading the
+// document again replays the journal. With every edit synced nothing may be
+// lost; with grouped syncs the result must be one of the script's states.
+void journalReplayAfterKill() {
+    TestFile file(makeDocument(60));
+    for (int grouped = 0; grouped < 2; ++grouped) {
+        TextStorage expected;
+        expected.loadFromFile(file.getPath());
+        std::vector<std::string> states = runScript(expected, 5, SCRIPT_EDITS);
+        pid_t child = fork();
+        if (child == 0) {
+            TextStorage storage;
+            storage.setJournalGroup(grouped ? 16 : 0, grouped ? 1000 : 0);
+            storage.setJournaling(true);
+            storage.loadFromFile(file.getPath());
+            runScript(storage, 5, SCRIPT_EDITS);
+            kill(getpid(), SIGKILL);
+        }
+        int status = 0;
+        if (!CHECK(child > 0) || !CHECK(waitpid(child, &status, 0) == child) ||
+            !CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL)) {
+            return;
+        }
+        TextStorage recovered;
+        recovered.setJournaling(true);
+        if (!CHECK(recovered.loadFromFile(file.getPath()))) {
+            return;
+        }
+        std::string text = documentText(recovered);
+        if (grouped) {
+            CHECK(std::find(states.begin(), states.end(), text) != states.end());
+            continue;
+        }
+        if (!CHECK(text == states.back())) {
+            return;
+        }
+        // Replayed edits are undoable like the ones they came from.
+        for (size_t k = states.size() - 1; k + 5 > states.size(); --k) {
+            if (!CHECK(recovered.undo()) || !CHECK(documentText(recovered) == states[k - 1])) {
+                return;
+            }
+        }
+    }
+}
+
+}
+
+void registerJournalTests(TestRegistry &registry) {
+    registry.add("journal_replay_after_kill", journalReplayAfterKill);
+}
@@ -0,0 +1,125 @@
+#include "Cases.h"
+#include "Scripts.h"
+#include "TextStorage.h"
+
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+std::string lineText(const TextStorage &storage, size_t lineIndex) {
+    const Line &line = storage.getLine(lineIndex);
+    return std::string(line.getText(), line.getTextLength());
+}
+
+// Another program truncates a loaded file. Reading the lines borrowed from
+// past its new end must not raise SIGBUS: they read as NUL bytes, the text
+// before the cut is kept, and saving refuses until the lost text is gone.
+void truncatedFileReads() {
+    std::string document = makeDocument(4000);
+    TestFile file(document);
+    std::string copyPath = file.getPath() + std::string(".copy");
+    TextStorage storage;
+    storage.setJournaling(true);
+    if (!CHECK(storage.loadFromFile(file.getPath()))) {
+        return;
+    }
+    size_t lastLine = storage.getLineCount() - 1;
+    size_t lastLength = storage.getLine(lastLine).getTextLength();
+    if (!CHECK(truncate(file.getPath(), 100) == 0)) {
+        return;
+    }
+    CHECK(storage.findText("line 3999", SearchOptions()).empty());
+    CHECK(storage.checkMappings());
+    CHECK(lineText(storage, 0) == "line 0 plain");
+    CHECK(lineText(storage, lastLine) == std::string(lastLength, '\0'));
+    std::string text;
+    size_t lastOffset = storage.getDocumentLength() - 1 - lastLength;
+    CHECK(storage.textAt(lastOffset, lastLength, text) && text == std::string(lastLength, '\0'));
+    CHECK(!storage.saveToFile(copyPath.c_str()));
+
+    // Edits and their undo, journaled, read the lost lines too.
+    storage.insertText(lastLine, 0, "x");
+    storage.deleteTextAt(0, storage.getDocumentLength() - 1);
+    CHECK(storage.undo() && storage.undo());
+    CHECK(lineText(storage, lastLine) == std::string(lastLength, '\0'));
+
+    // Once the document no longer holds lost text it saves again.
+    if (!CHECK(storage.loadFromFile(file.getPath()))) {
+        return;
+    }
+    CHECK(documentText(storage) == document.substr(0, 100));
+    CHECK(storage.saveToFile(copyPath.c_str()));
+    unlink((copyPath + ".journal").c_str());
+    unlink(copyPath.c_str());
+}
+
+// The lines of a document, as a model to edit.
+std::vector<std::string> linesOf(const TextStorage &storage) {
+    std::vector<std::string> result;
+    for (size_t i = 0; i < storage.getLineCount(); ++i) {
+        result.push_back(lineText(storage, i));
+    }
+    return result;
+}
+
+std::string joinLines(const std::vector<std::string> &lines) {
+    std::string text;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        text += (i ? "\n" : "") + lines[i];
+    }
+    return text;
+}
+
+// Edits made while the rest of a file loads in the background apply to the
+// lines loaded so far; a line added at the end stays in front of the lines
+// still to come. The edits and the load undo and redo like any others.
+void editsDuringBackgroundLoad() {
+    TestFile file(makeDocument(100000));
+    TextStorage reference;
+    if (!CHECK(reference.loadFromFile(file.getPath()))) {
+        return;
+    }
+    TextStorage storage;
+    if (!CHECK(storage.loadFromFileAsync(file.getPath())) || !CHECK(storage.isLoading())) {
+        return;
+    }
+    size_t available = storage.getLineCount();
+    if (!CHECK(available > 2 && available < reference.getLineCount())) {
+        return;
+    }
+    CHECK(storage.findText("line 99999 ", SearchOptions()).empty());
+    storage.insertText(0, 0, "X");
+    storage.deleteText(1, 0, 2);
+    storage.addNewLine();
+    storage.appendText(available, "tail");
+
+    std::vector<std::string> expected = linesOf(reference);
+    expected[0] = "X" + expected[0];
+    expected[1].erase(0, 2);
+    expected.insert(expected.begin() + available, "tail");
+    while (storage.isLoading()) {
+        storage.pollLoad();
+    }
+    std::string edited = joinLines(expected);
+    CHECK(documentText(storage) == edited);
+    CHECK(storage.findText("line 99999 ", SearchOptions()).size() == 1);
+
+    for (int step = 0; step < 4; ++step) {
+        CHECK(storage.undo());
+    }
+    CHECK(documentText(storage) == documentText(reference));
+    CHECK(storage.undo() && documentText(storage).empty());
+    for (int step = 0; step < 5; ++step) {
+        CHECK(storage.redo());
+    }
+    CHECK(documentText(storage) == edited);
+}
+
+}
+
+void registerLoadTests(TestRegistry &registry) {
+    registry.add("truncated_file_reads", truncatedFileReads);
+    registry.add("edits_during_background_load", editsDuringBackgroundLoad);
+}
@@ -0,0 +1,113 @@
+#include "Cases.h"
+#include "Line.h"
+#include "Rope.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+Line makeLine(const std::string &text) {
+    Line line;
+    line.replaceText(0, 0, text.data(), text.size());
+    return line;
+}
+
+std::string textOf(const Line &line) {
+    return std::string(line.getText(), line.getTextLength());
+}
+
+// Compares every element, the iterators and the prefix sums with a model.
+bool matches(const Rope<Line> &rope, const std::vector<std::string> &model) {
+    if (!CHECK(rope.size() == model.size())) {
+        return false;
+    }
+    size_t weight = 0;
+    size_t i = 0;
+    for (const Line &line : rope) {
+        if (!CHECK(textOf(line) == model[i]) || !CHECK(textOf(rope[i]) == model[i]) ||
+            !CHECK(rope.weightBefore(i) == weight)) {
+            return false;
+        }
+        // The end of the line, just before its newline; indexAtWeight
+        // leaves the offset within the line it finds.
+        size_t offset = weight + model[i].size();
+        if (!CHECK(rope.indexAtWeight(offset) == i) || !CHECK(offset == model[i].size())) {
+            return false;
+        }
+        weight += model[i].size() + 1;
+        i++;
+    }
+    size_t past = weight;
+    return CHECK(rope.weight() == weight) && CHECK(rope.indexAtWeight(past) == rope.size());
+}
+
+void ropeMatchesModel() {
+    std::mt19937 rng(11);
+    for (int round = 0; round < 20; ++round) {
+        Rope<Line> rope;
+        std::vector<std::string> model;
+        for (int op = 0; op < 3000; ++op) {
+            std::string text(rng() % 40, static_cast<char>('a' + rng() % 26));
+            int kind = rng() % 8;
+            if (kind < 3 || model.empty()) {
+                size_t index = rng() % (model.size() + 1);
+                rope.insert(index, makeLine(text));
+                model.insert(model.begin() + index, text);
+            } else if (kind < 5) {
+                size_t index = rng() % model.size();
+                if (!CHECK(textOf(rope.take(index)) == model[index])) {
+                    return;
+                }
+                model.erase(model.begin() + index);
+            } else if (kind == 5) {
+                size_t index = rng() % model.size();
+                rope.update(index, [&text](Line &line) {
+                    line.replaceText(0, line.getTextLength(), text.data(), text.size());
+                });
+                model[index] = text;
+            } else if (kind == 6) {
+                Rope<Line> tail;
+                std::vector<std::string> tailModel(rng() % 200, text);
+                for (const std::string &line : tailModel) {
+                    tail.push_back(makeLine(line));
+                }
+                rope.append(std::move(tail));
+                model.insert(model.end(), tailModel.begin(), tailModel.end());
+                CHECK(tail.empty());
+            } else {
+                size_t index = rng() % (model.size() + 1);
+                Rope<Line>::const_iterator it = rope.iteratorAt(index);
+                if (index == model.size() ? !CHECK(it == rope.end()) : !CHECK(textOf(*it) == model[index])) {
+                    return;
+                }
+            }
+            if (op % 500 == 0 && !matches(rope, model)) {
+                return;
+            }
+        }
+        // A copy shares line buffers, which the first edit through either
+        // side must copy.
+        Rope<Line> copy = rope;
+        if (!model.empty()) {
+            copy.update(0, [](Line &line) {
+                line.replaceText(0, 0, "copy", 4);
+            });
+        }
+        if (!matches(rope, model)) {
+            return;
+        }
+        rope.clear();
+        model.clear();
+        if (!matches(rope, model)) {
+            return;
+        }
+    }
+}
+
+}
+
+void registerRopeTests(TestRegistry &registry) {
+    registry.add("rope_matches_model", ropeMatchesModel);
+}
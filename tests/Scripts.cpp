@@ -0,0 +1,156 @@
+#include "Scripts.h"
+#include "Test.h"
+#include "TextStorage.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
+
+std::string encodeUtf8(char32_t codePoint) {
+    std::string bytes;
+    if (codePoint < 0x80) {
+        bytes += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        bytes += static_cast<char>(0xC0 | codePoint >> 6);
+        bytes += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        bytes += static_cast<char>(0xE0 | codePoint >> 12);
+        bytes += static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+        bytes += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        bytes += static_cast<char>(0xF0 | codePoint >> 18);
+        bytes += static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+        bytes += static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+        bytes += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    return bytes;
+}
+
+std::string documentText(const TextStorage &storage) {
+    std::string text;
+    for (size_t i = 0; i < storage.getLineCount(); ++i) {
+        const Line &line = storage.getLine(i);
+        if (i) {
+            text += '\n';
+        }
+        text.append(line.getText(), line.getTextLength());
+    }
+    return text;
+}
+
+std::string makeTempDirectory() {
+    const char *directory = std::getenv("TMPDIR");
+    std::string path = std::string(directory && *directory ? directory : "/tmp") + "/text_editor_test_XXXXXX";
+    return mkdtemp(&path[0]) ? path : std::string();
+}
+
+std::string makeDocument(size_t lineCount) {
+    std::string document;
+    for (size_t i = 0; i < lineCount; ++i) {
+        document += "line " + std::to_string(i) + (i % 3 ? " ab ї€" : " plain") + "\n";
+    }
+    return document;
+}
+
+TestFile::TestFile(const std::string &content)
+        : directory(makeTempDirectory()), path(directory + "/document.txt") {
+    std::ofstream(path, std::ios::binary) << content;
+}
+
+TestFile::~TestFile() {
+    unlink((path + ".journal").c_str());
+    unlink(path.c_str());
+    rmdir(directory.c_str());
+}
+
+namespace {
+
+std::string randomText(std::mt19937 &rng) {
+    static const char *const pieces[] = {"a", "b", "ab", " ", "word", "ї", "€", "\U0001F600"};
+    std::string text;
+    for (size_t n = rng() % 6; n > 0; --n) {
+        text += pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+    }
+    return text;
+}
+
+}
+
+void randomEdit(TextStorage &storage, std::mt19937 &rng) {
+    size_t lineIndex = rng() % storage.getLineCount();
+    size_t chars = storage.getLine(lineIndex).getCharCount();
+    size_t pos = rng() % (chars + 1);
+    size_t len = pos < chars ? 1 + rng() % std::min<size_t>(chars - pos, 8) : 0;
+    size_t offset = rng() % storage.getDocumentLength();
+    std::string text = randomText(rng);
+    switch (rng() % 12) {
+        case 0:
+        case 1:
+            storage.insertText(lineIndex, pos, text.c_str());
+            break;
+        case 2:
+            storage.deleteText(lineIndex, pos, len);
+            break;
+        case 3:
+            storage.insertWithReplace(lineIndex, pos, text.c_str());
+            break;
+        case 4:
+            storage.addNewLine();
+            break;
+        case 5:
+            storage.appendText(lineIndex, text.c_str());
+            break;
+        case 6:
+            storage.cutText(lineIndex, pos, len);
+            break;
+        case 7:
+            storage.pasteText(lineIndex, pos);
+            break;
+        case 8:
+            storage.replaceAll("ab", "ba!", SearchOptions());
+            break;
+        case 9:
+            storage.applyEdits({{lineIndex, pos, len, text}, {0, 0, 0, "<"}});
+            break;
+        case 10:
+            storage.insertTextAt(offset, (text + "\n" + text).c_str());
+            break;
+        default:
+            storage.deleteTextAt(offset, std::min<size_t>(1 + rng() % 20, storage.getDocumentLength() - 1 - offset));
+            break;
+    }
+}
+
+std::vector<std::string> runScript(TextStorage &storage, unsigned seed, size_t edits) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> states = {documentText(storage)};
+    for (size_t i = 0; i < edits; ++i) {
+        size_t before = storage.getEditCount();
+        randomEdit(storage, rng);
+        if (storage.getEditCount() != before) {
+            states.push_back(documentText(storage));
+        } else if (!CHECK(documentText(storage) == states.back())) {
+            break;
+        }
+    }
+    return states;
+}
+
+bool walkHistory(TextStorage &storage, const std::vector<std::string> &states, size_t first) {
+    for (size_t k = states.size() - 1; k > first; --k) {
+        if (!CHECK(storage.undo()) || !CHECK(documentText(storage) == states[k - 1])) {
+            return false;
+        }
+    }
+    if (!CHECK(!storage.undo())) {
+        return false;
+    }
+    for (size_t k = first + 1; k < states.size(); ++k) {
+        if (!CHECK(storage.redo()) || !CHECK(documentText(storage) == states[k]) || !CHECK(storage.undo()) ||
+            !CHECK(documentText(storage) == states[k - 1]) || !CHECK(storage.redo())) {
+            return false;
+        }
+    }
+    return CHECK(!storage.redo());
+}
@@ -0,0 +1,57 @@
+#ifndef TEXT_EDITOR_TEST_SCRIPTS_H
+#define TEXT_EDITOR_TEST_SCRIPTS_H
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+class TextStorage;
+
+#define SCRIPT_EDITS 300
+
+// UTF-8 encoding of `codePoint`.
+std::string encodeUtf8(char32_t codePoint);
+
+// The document as it would be saved, without the final newline.
+std::string documentText(const TextStorage &storage);
+
+// Path of a new empty directory under the temp directory.
+std::string makeTempDirectory();
+
+// `lineCount` newline-terminated lines, some with multi-byte characters.
+std::string makeDocument(size_t lineCount);
+
+// A document in a fresh temp directory, removed with the directory and
+// any journal left next to it.
+class TestFile {
+private:
+    std::string directory;
+    std::string path;
+
+public:
+    explicit TestFile(const std::string &content);
+    ~TestFile();
+
+    TestFile(const TestFile &) = delete;
+    TestFile &operator=(const TestFile &) = delete;
+
+    const char *getPath() const {
+        return path.c_str();
+    }
+};
+
+// One edit of a random script. Positions are drawn within the line or the
+// document, but edits may still be rejected (an empty clipboard, a range
+// splitting a character); a rejected edit must leave the text alone.
+void randomEdit(TextStorage &storage, std::mt19937 &rng);
+
+// Runs a random script, returning the text before it and after every
+// accepted edit.
+std::vector<std::string> runScript(TextStorage &storage, unsigned seed, size_t edits);
+
+// Undoes back to states[first] and redoes to the end, checking every state
+// on the way and that undo(redo(x)) == x at each step.
+bool walkHistory(TextStorage &storage, const std::vector<std::string> &states, size_t first);
+
+#endif //TEXT_EDITOR_TEST_SCRIPTS_H
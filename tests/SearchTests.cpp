@@ -0,0 +1,70 @@
+#include "Cases.h"
+#include "TextSearch.h"
+
+#include <cctype>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool isWordByte(unsigned char c) {
+    return std::isalnum(c) || c == '_';
+}
+
+std::vector<size_t> naiveFind(const std::string &text, const std::string &pattern, const SearchOptions &options) {
+    std::vector<size_t> positions;
+    for (size_t pos = 0; pos + pattern.size() <= text.size(); ++pos) {
+        bool match = true;
+        for (size_t i = 0; i < pattern.size() && match; ++i) {
+            unsigned char a = text[pos + i], b = pattern[i];
+            match = options.ignoreCase ? std::tolower(a) == std::tolower(b) : a == b;
+        }
+        if (match && options.wholeWord) {
+            match = (pos == 0 || !isWordByte(text[pos - 1])) &&
+                    (pos + pattern.size() == text.size() || !isWordByte(text[pos + pattern.size()]));
+        }
+        if (match) {
+            positions.push_back(pos);
+        }
+    }
+    return positions;
+}
+
+// Texts over small alphabets, so that the filtered bytes often match,
+// searched at every length around the vector widths.
+void searchMatchesNaive() {
+    static const char alphabet[] = "aAbBzZqQ_ 1\n\xd0\xbf";
+    std::mt19937 rng(6);
+    for (int round = 0; round < 20000; ++round) {
+        size_t symbols = 2 + rng() % (sizeof(alphabet) - 3);
+        std::string text(rng() % (round % 10 == 0 ? 600 : 140), ' ');
+        for (char &c : text) {
+            c = alphabet[rng() % symbols];
+        }
+        std::string pattern;
+        if (!text.empty() && rng() % 3) {
+            size_t at = rng() % text.size();
+            pattern = text.substr(at, 1 + rng() % std::min<size_t>(text.size() - at, 12));
+        } else {
+            for (size_t n = 1 + rng() % 5; n > 0; --n) {
+                pattern += alphabet[rng() % symbols];
+            }
+        }
+        SearchOptions options;
+        options.ignoreCase = rng() % 2;
+        options.wholeWord = rng() % 4 == 0;
+        TextSearch search(pattern.data(), pattern.size(), options);
+        std::vector<size_t> positions;
+        search.findAll(text.data(), text.size(), positions);
+        if (!CHECK(positions == naiveFind(text, pattern, options))) {
+            return;
+        }
+    }
+}
+
+}
+
+void registerSearchTests(TestRegistry &registry) {
+    registry.add("search_matches_naive", searchMatchesNaive);
+}
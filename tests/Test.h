@@ -0,0 +1,60 @@
+#ifndef TEXT_EDITOR_TEST_H
+#define TEXT_EDITOR_TEST_H
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct TestCase {
+    std::string name;
+    std::function<void()> body;
+};
+
+class TestRegistry {
+private:
+    std::vector<TestCase> cases;
+
+public:
+    void add(const std::string &name, std::function<void()> body) {
+        cases.push_back({name, std::move(body)});
+    }
+
+    const std::vector<TestCase> &getCases() const {
+        return cases;
+    }
+};
+
+// Counts the failed checks of the running test and reports each one to the
+// stream the runner set, which stays visible while the editor's own output
+// is silenced.
+class TestContext {
+private:
+    static inline std::ostream *report = nullptr;
+    static inline size_t failures = 0;
+
+public:
+    static void start(std::ostream &out) {
+        report = &out;
+        failures = 0;
+    }
+
+    static bool check(bool passed, const char *file, int line, const char *condition) {
+        if (!passed) {
+            failures++;
+            *report << "  " << file << ":" << line << ": check failed: " << condition << "\n";
+        }
+        return passed;
+    }
+
+    static size_t getFailures() {
+        return failures;
+    }
+};
+
+// Evaluates to the condition, so a test can stop at the first failure of a
+// loop with `if (!CHECK(...)) return;`.
+#define CHECK(condition) TestContext::check(static_cast<bool>(condition), __FILE__, __LINE__, #condition)
+
+#endif //TEXT_EDITOR_TEST_H
@@ -0,0 +1,83 @@
+#include "Cases.h"
+#include "Scripts.h"
+#include "TextStorage.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string textOf(const Line &line) {
+    return std::string(line.getText(), line.getTextLength());
+}
+
+// Columns count code points. Edits through the storage keep each line's
+// cached character index in step with a model of the text as code points.
+void lineColumnsFollowUtf8() {
+    static const char32_t pieces[] = {U'a', U'b', U' ', U'П', U'ї', U'€', U'\U0001F600', U'é'};
+    std::mt19937 rng(7);
+    for (int round = 0; round < 10; ++round) {
+        TextStorage storage;
+        std::vector<std::u32string> model(1);
+        for (int op = 0; op < 1500; ++op) {
+            size_t lineIndex = rng() % model.size();
+            std::u32string &line = model[lineIndex];
+            std::u32string piece;
+            for (size_t n = rng() % (op % 7 == 0 ? 600 : 8); n > 0; --n) {
+                piece += pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+            }
+            std::string bytes;
+            for (char32_t c : piece) {
+                bytes += encodeUtf8(c);
+            }
+            int kind = rng() % 8;
+            size_t column = rng() % (line.size() + 1);
+            if (kind < 4) {
+                storage.insertText(lineIndex, column, bytes.c_str());
+                line.insert(column, piece);
+            } else if (kind < 6 && column < line.size()) {
+                size_t count = 1 + rng() % std::min<size_t>(line.size() - column, 50);
+                storage.deleteText(lineIndex, column, count);
+                line.erase(column, count);
+            } else if (kind == 6) {
+                storage.insertWithReplace(lineIndex, column, bytes.c_str());
+                line.replace(column, std::min(piece.size(), line.size() - column), piece);
+            } else if (model.size() < 30) {
+                storage.addNewLine();
+                model.emplace_back();
+            }
+            for (size_t i = 0; i < model.size(); ++i) {
+                const Line &stored = storage.getLine(i);
+                std::string expected;
+                for (char32_t c : model[i]) {
+                    expected += encodeUtf8(c);
+                }
+                if (!CHECK(textOf(stored) == expected) || !CHECK(stored.getCharCount() == model[i].size())) {
+                    return;
+                }
+                size_t probe = rng() % (model[i].size() + 1);
+                size_t byte = 0;
+                for (size_t c = 0; c < probe; ++c) {
+                    byte += encodeUtf8(model[i][c]).size();
+                }
+                if (!CHECK(stored.byteOffsetOf(probe) == byte) || !CHECK(stored.columnOf(byte) == probe)) {
+                    return;
+                }
+                size_t offset, back, backColumn;
+                if (!CHECK(storage.positionToOffset(i, probe, offset)) ||
+                    !CHECK(storage.offsetToPosition(offset, back, backColumn)) || !CHECK(back == i) ||
+                    !CHECK(backColumn == probe)) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+}
+
+void registerUtf8Tests(TestRegistry &registry) {
+    registry.add("line_columns_follow_utf8", lineColumnsFollowUtf8);
+}
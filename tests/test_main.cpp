@@ -0,0 +1,61 @@
+#include "Cases.h"
+#include "Test.h"
+
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace {
+
+class NullBuf : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return traits_type::not_eof(c);
+    }
+};
+
+}
+
+// Runs the tests whose names contain any of the arguments, or all of them.
+// The editor's messages are silenced while a test runs; failed checks are
+// reported on stderr.
+int main(int argc, char *argv[]) {
+    TestRegistry registry;
+    registerRopeTests(registry);
+    registerUtf8Tests(registry);
+    registerDiffTests(registry);
+    registerHistoryTests(registry);
+    registerEditTests(registry);
+    registerInternTests(registry);
+    registerJournalTests(registry);
+    registerDaemonTests(registry);
+    registerLoadTests(registry);
+    registerSearchTests(registry);
+
+    std::ostream report(std::cerr.rdbuf());
+    NullBuf silent;
+    std::streambuf *savedOut = std::cout.rdbuf();
+    std::streambuf *savedErr = std::cerr.rdbuf();
+    size_t run = 0, failed = 0;
+    for (const TestCase &test : registry.getCases()) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc && !selected; ++i) {
+            selected = test.name.find(argv[i]) != std::string::npos;
+        }
+        if (!selected) {
+            continue;
+        }
+        TestContext::start(report);
+        std::cout.rdbuf(&silent);
+        std::cerr.rdbuf(&silent);
+        test.body();
+        std::cout.rdbuf(savedOut);
+        std::cerr.rdbuf(savedErr);
+        run++;
+        failed += TestContext::getFailures() != 0;
+        report << (TestContext::getFailures() ? "FAIL " : "ok   ") << test.name << "\n";
+    }
+    report << run - failed << " of " << run << " tests passed\n";
+    return run == 0 || failed ? 1 : 0;
+}